@@ -0,0 +1,75 @@
+#version 120
+#define MAX_LIGHTS 2
+
+varying vec3 vNormal, vVertex;
+varying vec3 vLightPos[MAX_LIGHTS];
+
+uniform sampler2D diffuseMap;
+uniform sampler2D sceneDepthMap;
+uniform vec4 sceneViewport;
+uniform float softness;	// zero disables fading
+
+#include "lightGrid.glsl"
+#include "shadowMap.glsl"
+
+
+// fades the billboard out where it gets close to the scene's geometry behind it
+float softFactor()
+{
+	if( softness <= 0.0 )
+		return 1.0;
+	vec2 screenCoord = ( gl_FragCoord.xy - sceneViewport.xy ) / sceneViewport.zw;
+	float sceneDepth = texture2D( sceneDepthMap, screenCoord ).r * 2.0 - 1.0;
+	float sceneDistance = gl_ProjectionMatrix[3][2] / ( sceneDepth + gl_ProjectionMatrix[2][2] );
+	return clamp( ( sceneDistance + vVertex.z ) / softness, 0.0, 1.0 );
+}
+
+
+void main()
+{
+	vec3 finalColor = gl_FrontMaterial.emission.rgb;
+	vec3 normal = normalize( vNormal );
+	vec3 viewDir = normalize( -vVertex );
+
+	vec4 colorFromMap = texture2D( diffuseMap, gl_TexCoord[0].st ) * gl_Color;
+
+	float sunShadow = shadowFactor( vVertex );
+	for( int i=0; i<MAX_LIGHTS; ++i )
+	{
+		finalColor += gl_LightSource[i].ambient.rgb * gl_FrontMaterial.ambient.rgb * colorFromMap.rgb;
+
+		vec3 lightDir = normalize( vLightPos[i] );
+		float lambert = max( 0.0, dot( normal, lightDir ) );
+
+		float d = length( vLightPos[i] );
+		float attenuation = 1.0 / (
+			gl_LightSource[i].constantAttenuation +
+			gl_LightSource[i].linearAttenuation * d +
+			gl_LightSource[i].quadraticAttenuation * d*d );
+		if( i == 0 )
+			attenuation *= sunShadow;	// the sun is the first light
+
+		finalColor +=
+			gl_LightSource[i].diffuse.rgb *
+			gl_FrontMaterial.diffuse.rgb *
+			lambert * attenuation * colorFromMap.rgb;
+
+		vec3 R = reflect( -lightDir, normal );
+		float specular = pow( max(dot(R, viewDir), 0.0), gl_FrontMaterial.shininess );
+
+		finalColor +=
+			gl_LightSource[i].specular.rgb *
+			gl_FrontMaterial.specular.rgb *
+			specular * attenuation;
+	}
+
+	vec3 gridDiffuse = vec3( 0.0 );
+	vec3 gridSpecular = vec3( 0.0 );
+	gridLights( vVertex, normal, viewDir, gl_FrontMaterial.shininess, gridDiffuse, gridSpecular );
+	finalColor += gridDiffuse * gl_FrontMaterial.diffuse.rgb * colorFromMap.rgb;
+	finalColor += gridSpecular * gl_FrontMaterial.specular.rgb;
+
+	float fogFactor = clamp( -(length( vVertex )-gl_Fog.start) * gl_Fog.scale, 0.0, 1.0 );
+	vec3 finalFragment = mix( gl_Fog.color.rgb, finalColor, fogFactor );
+	gl_FragColor = vec4( finalFragment, colorFromMap.a * gl_FrontMaterial.diffuse.a * softFactor() );
+}
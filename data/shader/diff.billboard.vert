@@ -0,0 +1,34 @@
+#version 120
+#define MAX_LIGHTS 2
+
+attribute vec4 particlePosition;	// xyz: center, w: size
+attribute vec2 particleParams;	// x: texture rotation in quarter turns, y: remaining life
+
+varying vec3 vNormal, vVertex;
+varying vec3 vLightPos[MAX_LIGHTS];
+
+
+void main()
+{
+	// gl_Vertex.xy is the billboard corner, gl_Vertex.z the corner's index
+	vec3 right = vec3( gl_ModelViewMatrix[0][0], gl_ModelViewMatrix[1][0], gl_ModelViewMatrix[2][0] );
+	vec3 up = vec3( gl_ModelViewMatrix[0][1], gl_ModelViewMatrix[1][1], gl_ModelViewMatrix[2][1] );
+	vec3 dir = vec3( gl_ModelViewMatrix[0][2], gl_ModelViewMatrix[1][2], gl_ModelViewMatrix[2][2] );
+	vec3 offset = ( right * gl_Vertex.x + up * gl_Vertex.y ) * particlePosition.w;
+	vec4 position = vec4( particlePosition.xyz + offset, 1.0 );
+
+	vec4 vertex = gl_ModelViewMatrix * position;
+	vVertex = vec3( vertex );
+	gl_ClipVertex = vertex;
+	gl_Position = gl_ModelViewProjectionMatrix * position;
+	float corner = mod( particleParams.x + gl_Vertex.z, 4.0 );
+	vec2 texCoord = vec2( step( 0.5, corner ) - step( 2.5, corner ), step( 1.5, corner ) );
+	gl_TexCoord[0] = gl_TextureMatrix[0] * vec4( texCoord, 0.0, 1.0 );
+	vNormal = gl_NormalMatrix * normalize( offset + dir );
+	gl_FrontColor = gl_Color;
+
+	for( int i=0; i<MAX_LIGHTS; ++i )
+	{
+		vLightPos[i] = gl_LightSource[i].position.xyz - gl_LightSource[i].position.w * vVertex;
+	}
+}
@@ -7,6 +7,9 @@ varying vec3 vLightPos[MAX_LIGHTS];
 uniform sampler2D diffuseMap;
 uniform sampler2D blobMap;
 
+#include "lightGrid.glsl"
+#include "shadowMap.glsl"
+
 
 void main()
 {
@@ -16,6 +19,7 @@ void main()
 
 	vec4 colorFromMap = texture2D( diffuseMap, gl_TexCoord[0].st ) * gl_Color;
 
+	float sunShadow = shadowFactor( vVertex );
 	for( int i=0; i<MAX_LIGHTS; ++i )
 	{
 		finalColor += gl_LightSource[i].ambient.rgb * gl_FrontMaterial.ambient.rgb * colorFromMap.rgb;
@@ -28,6 +32,8 @@ void main()
 			gl_LightSource[i].constantAttenuation +
 			gl_LightSource[i].linearAttenuation * d +
 			gl_LightSource[i].quadraticAttenuation * d*d );
+		if( i == 0 )
+			attenuation *= sunShadow;	// the sun is the first light
 
 		finalColor +=
 			gl_LightSource[i].diffuse.rgb *
@@ -43,6 +49,12 @@ void main()
 			specular * attenuation;
 	}
 
+	vec3 gridDiffuse = vec3( 0.0 );
+	vec3 gridSpecular = vec3( 0.0 );
+	gridLights( vVertex, normal, viewDir, gl_FrontMaterial.shininess, gridDiffuse, gridSpecular );
+	finalColor += gridDiffuse * gl_FrontMaterial.diffuse.rgb * colorFromMap.rgb;
+	finalColor += gridSpecular * gl_FrontMaterial.specular.rgb;
+
 	float fogFactor = clamp( -(length( vVertex )-gl_Fog.start) * gl_Fog.scale, 0.0, 1.0 );
 	vec3 finalFragment = mix( gl_Fog.color.rgb, finalColor, fogFactor );
 	gl_FragColor = vec4( finalFragment, colorFromMap.a * gl_FrontMaterial.diffuse.a * texture2D( blobMap, gl_TexCoord[1].st ).r );
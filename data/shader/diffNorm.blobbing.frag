@@ -8,6 +8,9 @@ uniform sampler2D diffuseMap;
 uniform sampler2D normalMap;
 uniform sampler2D blobMap;
 
+#include "lightGrid.glsl"
+#include "shadowMap.glsl"
+
 
 void main()
 {
@@ -28,6 +31,7 @@ void main()
 	vec3 normalFromMap = normalize( texture2D( normalMap, gl_TexCoord[0].st ).rgb * 2.0 - 1.0 );
 	normal = normalize( TBN * normalFromMap );	// transform the normal to eye space
 
+	float sunShadow = shadowFactor( vVertex );
 	for( int i=0; i<MAX_LIGHTS; ++i )
 	{
 		finalColor += gl_LightSource[i].ambient.rgb * gl_FrontMaterial.ambient.rgb * colorFromMap.rgb;
@@ -40,6 +44,8 @@ void main()
 			gl_LightSource[i].constantAttenuation +
 			gl_LightSource[i].linearAttenuation * d +
 			gl_LightSource[i].quadraticAttenuation * d*d );
+		if( i == 0 )
+			attenuation *= sunShadow;	// the sun is the first light
 
 		finalColor +=
 			gl_LightSource[i].diffuse.rgb *
@@ -55,6 +61,12 @@ void main()
 			specular * attenuation;
 	}
 
+	vec3 gridDiffuse = vec3( 0.0 );
+	vec3 gridSpecular = vec3( 0.0 );
+	gridLights( vVertex, normal, viewDir, gl_FrontMaterial.shininess + 1, gridDiffuse, gridSpecular );
+	finalColor += gridDiffuse * gl_FrontMaterial.diffuse.rgb * colorFromMap.rgb;
+	finalColor += gridSpecular * gl_FrontMaterial.specular.rgb;
+
 	float fogFactor = clamp( -(length( vVertex )-gl_Fog.start) * gl_Fog.scale, 0.0, 1.0 );
 	vec3 finalFragment = mix( gl_Fog.color.rgb, finalColor, fogFactor );
 	gl_FragColor = vec4( finalFragment, colorFromMap.a * gl_FrontMaterial.diffuse.a * texture2D( blobMap, gl_TexCoord[1].st ).r );
@@ -0,0 +1,29 @@
+#version 120
+
+varying vec3 vVertex;
+
+uniform sampler2D directMap;
+uniform sampler2D sceneDepthMap;
+uniform vec4 sceneViewport;
+uniform float softness;	// zero disables fading
+
+
+// fades the billboard out where it gets close to the scene's geometry behind it
+float softFactor()
+{
+	if( softness <= 0.0 )
+		return 1.0;
+	vec2 screenCoord = ( gl_FragCoord.xy - sceneViewport.xy ) / sceneViewport.zw;
+	float sceneDepth = texture2D( sceneDepthMap, screenCoord ).r * 2.0 - 1.0;
+	float sceneDistance = gl_ProjectionMatrix[3][2] / ( sceneDepth + gl_ProjectionMatrix[2][2] );
+	return clamp( ( sceneDistance + vVertex.z ) / softness, 0.0, 1.0 );
+}
+
+
+void main()
+{
+	vec3 viewDir = normalize( -vVertex );
+	vec4 finalColor = texture2D( directMap, gl_TexCoord[0].st ) * gl_Color;
+	finalColor.a *= softFactor();
+	gl_FragColor = finalColor;
+}
@@ -0,0 +1,52 @@
+// point lights of the fragment's screen tile, see LightGrid
+#define LIGHT_GRID_LAYERS 2
+
+uniform bool lightGridEnabled;
+uniform sampler2D lightGridLightMap;	// per light: view space position and radius, color, attenuation
+uniform sampler2D lightGridTileMap;	// per tile: up to four light indices + 1 per layer, 0 ends the list
+uniform vec4 lightGridViewport;	// x, y, width, height the grid was built for
+uniform vec4 lightGridSize;	// tiles x, tiles y, tile size, light map width
+
+
+// adds one light's diffuse and specular intensity - returns false if the index ends the tile's list
+bool gridLight( float index, vec3 vertex, vec3 normal, vec3 viewDir, float shininess, inout vec3 diffuse, inout vec3 specular )
+{
+	if( index < 0.5 )
+		return false;
+	float u = ( floor( index * 255.0 + 0.5 ) - 0.5 ) / lightGridSize.w;
+	vec4 positionRadius = texture2D( lightGridLightMap, vec2( u, 0.5/3.0 ) );
+	vec3 color = texture2D( lightGridLightMap, vec2( u, 1.5/3.0 ) ).rgb;
+	vec3 factors = texture2D( lightGridLightMap, vec2( u, 2.5/3.0 ) ).xyz;
+
+	vec3 lightPos = positionRadius.xyz - vertex;
+	float d = length( lightPos );
+	if( d >= positionRadius.w )
+		return true;
+	vec3 lightDir = lightPos / d;
+
+	float window = 1.0 - pow( d / positionRadius.w, 4.0 );
+	float attenuation = window * window / ( factors.x + factors.y * d + factors.z * d*d );
+
+	diffuse += color * max( 0.0, dot( normal, lightDir ) ) * attenuation;
+	vec3 R = reflect( -lightDir, normal );
+	specular += color * pow( max( dot( R, viewDir ), 0.0 ), shininess ) * attenuation;
+	return true;
+}
+
+
+// accumulates the diffuse and specular light of all grid lights reaching this fragment
+void gridLights( vec3 vertex, vec3 normal, vec3 viewDir, float shininess, inout vec3 diffuse, inout vec3 specular )
+{
+	if( !lightGridEnabled )
+		return;
+	vec2 tile = floor( ( gl_FragCoord.xy - lightGridViewport.xy ) / lightGridSize.z );
+	for( int layer = 0; layer < LIGHT_GRID_LAYERS; ++layer )
+	{
+		vec2 coord = ( tile + vec2( 0.5, 0.5 + float(layer) * lightGridSize.y ) ) / vec2( lightGridSize.x, lightGridSize.y * float(LIGHT_GRID_LAYERS) );
+		vec4 indices = texture2D( lightGridTileMap, coord );
+		if( !gridLight( indices.x, vertex, normal, viewDir, shininess, diffuse, specular ) ) return;
+		if( !gridLight( indices.y, vertex, normal, viewDir, shininess, diffuse, specular ) ) return;
+		if( !gridLight( indices.z, vertex, normal, viewDir, shininess, diffuse, specular ) ) return;
+		if( !gridLight( indices.w, vertex, normal, viewDir, shininess, diffuse, specular ) ) return;
+	}
+}
@@ -0,0 +1,92 @@
+#version 120
+#define MAX_EMITS 8
+
+attribute vec4 inPosition;	// xyz: position, w: size
+attribute vec2 inParams;	// x: texture rotation in quarter turns, y: remaining life
+attribute vec3 inVelocity;
+attribute float inIndex;
+
+// captured by transform feedback
+varying vec4 outPosition;
+varying vec2 outParams;
+varying vec3 outVelocity;
+
+uniform float delta;
+uniform float time;
+uniform float capacity;
+uniform float size;
+uniform vec2 life;	// min, max
+uniform float dragFactor;
+uniform vec3 gravity;
+uniform float waterHeight;
+uniform float buoyancy;
+
+uniform bool terrainEnabled;
+uniform sampler2D heightMap;
+uniform vec3 terrainOffset;
+uniform vec3 terrainSize;
+uniform vec2 heightMapSize;
+
+uniform int emitCount;
+uniform vec4 emitSource[MAX_EMITS];	// xyz: source, w: first particle index
+uniform vec4 emitVelocity[MAX_EMITS];	// xyz: velocity offset, w: number of particles
+uniform vec2 emitSpeed[MAX_EMITS];	// min, max
+
+
+float random( float seed )
+{
+	return fract( sin( dot( vec2( inIndex, seed ), vec2( 12.9898, 78.233 ) ) ) * 43758.5453 );
+}
+
+
+void main()
+{
+	vec3 position = inPosition.xyz;
+	vec3 velocity = inVelocity;
+	float rotation = inParams.x;
+	float remaining = inParams.y;
+
+	bool emitted = false;
+	for( int i=0; i<MAX_EMITS; ++i )
+	{
+		if( i >= emitCount )
+			break;
+		float offset = mod( inIndex - emitSource[i].w + capacity, capacity );
+		if( offset < emitVelocity[i].w )
+		{
+			// uniformly distributed direction
+			float z = random( time ) * 2.0 - 1.0;
+			float a = random( time + 1.0 ) * 6.2831853;
+			float r = sqrt( 1.0 - z*z );
+			vec3 direction = vec3( r * cos( a ), r * sin( a ), z );
+			position = emitSource[i].xyz;
+			velocity = direction * mix( emitSpeed[i].x, emitSpeed[i].y, random( time + 2.0 ) ) + emitVelocity[i].xyz;
+			remaining = mix( life.x, life.y, random( time + 3.0 ) );
+			rotation = floor( random( time + 4.0 ) * 4.0 );
+			emitted = true;
+		}
+	}
+
+	if( !emitted && remaining > 0.0 )
+	{
+		position += velocity * delta;
+		velocity = velocity * dragFactor + gravity * delta;
+		remaining -= delta;
+
+		if( position.y - waterHeight < -size * 0.5 )
+			velocity -= gravity * buoyancy * delta;
+
+		if( terrainEnabled )
+		{
+			vec2 mapCoord = ( position.xz - terrainOffset.xz ) / terrainSize.xz + 0.5 / heightMapSize;
+			float ground = texture2D( heightMap, mapCoord ).r * terrainSize.y + terrainOffset.y;
+			if( position.y - ground < -size * 0.5 )
+				remaining = 0.0;
+		}
+	}
+
+	outPosition = vec4( position, remaining > 0.0 ? size : 0.0 );	// dead particles collapse to a point when drawn
+	outParams = vec2( rotation, remaining );
+	outVelocity = velocity;
+	gl_Position = vec4( 0.0, 0.0, 0.0, 1.0 );
+}
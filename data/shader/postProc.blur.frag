@@ -0,0 +1,14 @@
+uniform sampler2D sourceMap;
+uniform vec2 direction;	// one texel along the blurred axis
+
+void main()
+{
+	// nine tap gaussian - bilinear filtering merges pairs of taps
+	vec2 uv = gl_TexCoord[0].st;
+	vec3 c = texture2D( sourceMap, uv ).rgb * 0.2270270270;
+	c += texture2D( sourceMap, uv + direction * 1.3846153846 ).rgb * 0.3162162162;
+	c += texture2D( sourceMap, uv - direction * 1.3846153846 ).rgb * 0.3162162162;
+	c += texture2D( sourceMap, uv + direction * 3.2307692308 ).rgb * 0.0702702703;
+	c += texture2D( sourceMap, uv - direction * 3.2307692308 ).rgb * 0.0702702703;
+	gl_FragColor = vec4( c, 1.0 );
+}
@@ -0,0 +1,16 @@
+uniform sampler2D sourceMap;
+uniform float threshold;
+uniform vec2 texelSize;	// of the source, scaled to the resolution step
+
+void main()
+{
+	// four bilinear taps average the source texels merged into this one
+	vec2 uv = gl_TexCoord[0].st;
+	vec2 offset = texelSize * 0.5;
+	vec3 c = 0.25 * (
+		texture2D( sourceMap, uv + vec2( -offset.x, -offset.y ) ).rgb +
+		texture2D( sourceMap, uv + vec2( offset.x, -offset.y ) ).rgb +
+		texture2D( sourceMap, uv + vec2( -offset.x, offset.y ) ).rgb +
+		texture2D( sourceMap, uv + vec2( offset.x, offset.y ) ).rgb );
+	gl_FragColor = vec4( max( c - vec3( threshold ), vec3( 0.0 ) ), 1.0 );
+}
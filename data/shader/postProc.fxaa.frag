@@ -0,0 +1,37 @@
+uniform sampler2D sourceMap;	// luma in alpha
+uniform vec2 texelSize;
+
+#define FXAA_REDUCE_MIN ( 1.0 / 128.0 )
+#define FXAA_REDUCE_MUL ( 1.0 / 8.0 )
+#define FXAA_SPAN_MAX 8.0
+
+void main()
+{
+	vec2 uv = gl_TexCoord[0].st;
+	float lumaNW = texture2D( sourceMap, uv + vec2( -1.0, -1.0 ) * texelSize ).a;
+	float lumaNE = texture2D( sourceMap, uv + vec2( 1.0, -1.0 ) * texelSize ).a;
+	float lumaSW = texture2D( sourceMap, uv + vec2( -1.0, 1.0 ) * texelSize ).a;
+	float lumaSE = texture2D( sourceMap, uv + vec2( 1.0, 1.0 ) * texelSize ).a;
+	vec4 center = texture2D( sourceMap, uv );
+	float lumaMin = min( center.a, min( min( lumaNW, lumaNE ), min( lumaSW, lumaSE ) ) );
+	float lumaMax = max( center.a, max( max( lumaNW, lumaNE ), max( lumaSW, lumaSE ) ) );
+
+	// blur along the edge - perpendicular to the luma gradient
+	vec2 dir = vec2( -( ( lumaNW + lumaNE ) - ( lumaSW + lumaSE ) ), ( lumaNW + lumaSW ) - ( lumaNE + lumaSE ) );
+	float dirReduce = max( ( lumaNW + lumaNE + lumaSW + lumaSE ) * 0.25 * FXAA_REDUCE_MUL, FXAA_REDUCE_MIN );
+	float rcpDirMin = 1.0 / ( min( abs( dir.x ), abs( dir.y ) ) + dirReduce );
+	dir = clamp( dir * rcpDirMin, vec2( -FXAA_SPAN_MAX ), vec2( FXAA_SPAN_MAX ) ) * texelSize;
+
+	vec3 rgbA = 0.5 * (
+		texture2D( sourceMap, uv + dir * ( 1.0/3.0 - 0.5 ) ).rgb +
+		texture2D( sourceMap, uv + dir * ( 2.0/3.0 - 0.5 ) ).rgb );
+	vec3 rgbB = rgbA * 0.5 + 0.25 * (
+		texture2D( sourceMap, uv - dir * 0.5 ).rgb +
+		texture2D( sourceMap, uv + dir * 0.5 ).rgb );
+	float lumaB = dot( rgbB, vec3( 0.299, 0.587, 0.114 ) );
+	// the wider blur crossed another edge if it left the local luma range
+	if( lumaB < lumaMin || lumaB > lumaMax )
+		gl_FragColor = vec4( rgbA, 1.0 );
+	else
+		gl_FragColor = vec4( rgbB, 1.0 );
+}
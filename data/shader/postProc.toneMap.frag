@@ -0,0 +1,22 @@
+uniform sampler2D sceneMap;
+uniform sampler2D bloomMap;
+uniform bool bloomEnabled;
+uniform float bloomStrength;
+uniform float exposure;
+
+// colors up to here keep their look, brighter ones are compressed towards white
+const float knee = 0.8;
+
+void main()
+{
+	vec2 uv = gl_TexCoord[0].st;
+	vec3 c = texture2D( sceneMap, uv ).rgb * exposure;
+	if( bloomEnabled )
+		c += texture2D( bloomMap, uv ).rgb * bloomStrength;
+
+	vec3 over = max( c - vec3( knee ), vec3( 0.0 ) );
+	c = min( c, vec3( knee ) ) + ( 1.0 - knee ) * ( vec3( 1.0 ) - exp( -over / ( 1.0 - knee ) ) );
+
+	// luma for FXAA
+	gl_FragColor = vec4( c, dot( c, vec3( 0.299, 0.587, 0.114 ) ) );
+}
@@ -0,0 +1,40 @@
+// the sun's cascaded shadow map, see ShadowMap
+#define MAX_SHADOW_CASCADES 4
+
+uniform bool shadowEnabled;
+uniform sampler2DShadow shadowMap;	// all cascades side by side
+uniform mat4 shadowMatrix[MAX_SHADOW_CASCADES];	// view space to cascade coordinates
+uniform vec4 shadowTiles[MAX_SHADOW_CASCADES];	// offset and size of each cascade in the map
+uniform int shadowCascades;
+uniform bool shadowFilter;
+uniform vec2 shadowTexelSize;
+
+
+// returns 0 for fully shadowed up to 1 for lit fragments - taken from the first cascade covering the fragment
+float shadowFactor( vec3 vertex )
+{
+	if( !shadowEnabled )
+		return 1.0;
+	vec4 position = vec4( vertex, 1.0 );
+	for( int i=0; i<MAX_SHADOW_CASCADES; ++i )
+	{
+		if( i >= shadowCascades )
+			break;
+		vec3 coord = ( shadowMatrix[i] * position ).xyz;
+		if( any( lessThan( coord, vec3( 0.0 ) ) ) || any( greaterThan( coord, vec3( 1.0 ) ) ) )
+			continue;
+		// keep the filter footprint inside the tile - linear filtering reads half a texel around each tap
+		vec2 offset = shadowTexelSize * 0.5;
+		vec2 margin = shadowFilter ? shadowTexelSize : offset;
+		vec3 mapCoord = vec3( clamp( shadowTiles[i].xy + coord.xy * shadowTiles[i].zw,
+			shadowTiles[i].xy + margin, shadowTiles[i].xy + shadowTiles[i].zw - margin ), coord.z );
+		if( !shadowFilter )
+			return shadow2D( shadowMap, mapCoord ).r;
+		return 0.25 * (
+			shadow2D( shadowMap, mapCoord + vec3( -offset.x, -offset.y, 0.0 ) ).r +
+			shadow2D( shadowMap, mapCoord + vec3( offset.x, -offset.y, 0.0 ) ).r +
+			shadow2D( shadowMap, mapCoord + vec3( -offset.x, offset.y, 0.0 ) ).r +
+			shadow2D( shadowMap, mapCoord + vec3( offset.x, offset.y, 0.0 ) ).r );
+	}
+	return 1.0;
+}
@@ -0,0 +1,11 @@
+#version 120
+
+uniform sampler2D diffuseMap;
+
+
+void main()
+{
+	// the accumulation map holds a factor for the terrain's color - white leaves it unchanged
+	vec4 colorFromMap = texture2D( diffuseMap, gl_TexCoord[0].st );
+	gl_FragColor = vec4( mix( vec3( 1.0 ), gl_Color.rgb * colorFromMap.rgb, colorFromMap.a ), 1.0 );
+}
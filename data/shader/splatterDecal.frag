@@ -0,0 +1,92 @@
+#version 120
+#define MAX_LIGHTS 2
+
+varying vec4 vRect;
+varying vec4 vParams;
+
+uniform sampler2D diffuseMap;
+uniform sampler2D depthMap;
+uniform sampler2D heightMap;
+uniform vec4 viewport;
+uniform vec3 terrainOffset;
+uniform vec3 terrainSize;
+uniform vec2 heightMapSize;
+uniform float heightTolerance;
+uniform float driftFactor;
+
+#include "lightGrid.glsl"
+
+
+void main()
+{
+	// reconstruct the visible surface's position from the depth buffer
+	vec2 screenCoord = ( gl_FragCoord.xy - viewport.xy ) / viewport.zw;
+	float depth = texture2D( depthMap, screenCoord ).r;
+	vec4 eyePosition = gl_ProjectionMatrixInverse * vec4( vec3( screenCoord, depth ) * 2.0 - 1.0, 1.0 );
+	vec3 vVertex = eyePosition.xyz / eyePosition.w;
+	vec3 position = ( gl_ModelViewMatrixInverse * vec4( vVertex, 1.0 ) ).xyz;
+
+	// only splatter the terrain within this decal's box
+	vec2 local = ( position.xz - vRect.xy ) / vRect.zw;
+	if( any( lessThan( local, vec2( 0.0 ) ) ) || any( greaterThan( local, vec2( 1.0 ) ) ) )
+		discard;
+	if( position.y < vParams.x || position.y > vParams.x + vParams.y )
+		discard;
+	vec2 mapCoord = ( position.xz - terrainOffset.xz ) / terrainSize.xz + 0.5 / heightMapSize;
+	float ground = texture2D( heightMap, mapCoord ).r * terrainSize.y + terrainOffset.y;
+	if( abs( position.y - ground ) > heightTolerance )
+		discard;
+
+	// the same texture transformation as drawing terrain patches: drifting apart while fading, rotated around the center
+	float sizeFactor = pow( vParams.w, driftFactor );
+	vec2 texCoord = ( local - sizeFactor * 0.5 ) / max( 1.0 - sizeFactor, 0.0001 );
+	if( any( lessThan( texCoord, vec2( 0.0 ) ) ) || any( greaterThan( texCoord, vec2( 1.0 ) ) ) )
+		discard;
+	float angle = vParams.z * 1.5707963;
+	mat2 rotation = mat2( cos( angle ), sin( angle ), -sin( angle ), cos( angle ) );
+	texCoord = rotation * ( texCoord - 0.5 ) + 0.5;
+
+	vec3 normal = normalize( cross( dFdx( vVertex ), dFdy( vVertex ) ) );
+	vec3 viewDir = normalize( -vVertex );
+	vec3 finalColor = mix( vec3( 1.0 ), gl_FrontMaterial.emission.rgb, sqrt( vParams.w ) );
+
+	vec4 colorFromMap = texture2D( diffuseMap, texCoord ) * gl_Color;
+
+	for( int i=0; i<MAX_LIGHTS; ++i )
+	{
+		vec3 lightPos = gl_LightSource[i].position.xyz - gl_LightSource[i].position.w * vVertex;
+		finalColor += gl_LightSource[i].ambient.rgb * gl_FrontMaterial.ambient.rgb * colorFromMap.rgb;
+
+		vec3 lightDir = normalize( lightPos );
+		float lambert = max( 0.0, dot( normal, lightDir ) );
+
+		float d = length( lightPos );
+		float attenuation = 1.0 / (
+			gl_LightSource[i].constantAttenuation +
+			gl_LightSource[i].linearAttenuation * d +
+			gl_LightSource[i].quadraticAttenuation * d*d );
+
+		finalColor +=
+			gl_LightSource[i].diffuse.rgb *
+			gl_FrontMaterial.diffuse.rgb *
+			lambert * attenuation * colorFromMap.rgb;
+
+		vec3 R = reflect( -lightDir, normal );
+		float specular = pow( max(dot(R, viewDir), 0.0), gl_FrontMaterial.shininess );
+
+		finalColor +=
+			gl_LightSource[i].specular.rgb *
+			gl_FrontMaterial.specular.rgb *
+			specular * attenuation;
+	}
+
+	vec3 gridDiffuse = vec3( 0.0 );
+	vec3 gridSpecular = vec3( 0.0 );
+	gridLights( vVertex, normal, viewDir, gl_FrontMaterial.shininess, gridDiffuse, gridSpecular );
+	finalColor += gridDiffuse * gl_FrontMaterial.diffuse.rgb * colorFromMap.rgb;
+	finalColor += gridSpecular * gl_FrontMaterial.specular.rgb;
+
+	float fogFactor = clamp( -(length( vVertex )-gl_Fog.start) * gl_Fog.scale, 0.0, 1.0 );
+	vec3 finalFragment = mix( gl_Fog.color.rgb, finalColor, fogFactor );
+	gl_FragColor = vec4( finalFragment, colorFromMap.a * gl_FrontMaterial.diffuse.a );
+}
@@ -0,0 +1,24 @@
+#version 120
+
+attribute vec4 decalRect;	// x, z, width, depth of the splatter in world coordinates
+attribute vec4 decalParams;	// x: bottom, y: height of the box, z: rotation in quarter turns, w: fade
+
+varying vec4 vRect;
+varying vec4 vParams;
+
+
+void main()
+{
+	// gl_Vertex is a corner of the unit cube
+	vec4 position = vec4(
+		decalRect.x + gl_Vertex.x * decalRect.z,
+		decalParams.x + gl_Vertex.y * decalParams.y,
+		decalRect.y + gl_Vertex.z * decalRect.w,
+		1.0 );
+	vec4 vertex = gl_ModelViewMatrix * position;
+	gl_ClipVertex = vertex;
+	gl_Position = gl_ModelViewProjectionMatrix * position;
+	gl_FrontColor = gl_Color;
+	vRect = decalRect;
+	vParams = decalParams;
+}
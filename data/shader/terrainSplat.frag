@@ -0,0 +1,117 @@
+#version 120
+#extension GL_EXT_texture_array : require
+#define MAX_LIGHTS 2
+#define MAX_BLOBS 8
+
+varying vec3 vNormal, vVertex;
+varying vec3 vLightPos[MAX_LIGHTS];
+varying vec2 vMapCoord;
+
+uniform sampler2DArray diffuseLayers;
+uniform sampler2DArray specularLayers;
+uniform sampler2DArray normalLayers;
+uniform sampler2D weightMap0;
+uniform sampler2D weightMap1;
+uniform sampler2D splatterMap;
+uniform bool splatterEnabled;
+
+uniform vec2 mapSize;
+uniform vec2 baseScale;
+uniform vec2 blobScale[MAX_BLOBS];
+uniform float blobLayer[MAX_BLOBS];
+uniform vec4 blobEnabled0;
+uniform vec4 blobEnabled1;
+
+#include "lightGrid.glsl"
+#include "shadowMap.glsl"
+
+
+// blends one blob's layer over the layers below - the same as drawing it with alpha blending
+void blend( inout vec4 color, inout vec4 specular, inout vec3 normal, float weight, vec2 scale, float layer )
+{
+	vec3 coord = vec3( vMapCoord * vec2( scale.x, -scale.y ), layer );
+	vec4 colorFromLayer = texture2DArray( diffuseLayers, coord );
+	weight *= colorFromLayer.a;
+	color = mix( color, colorFromLayer, weight );
+	specular = mix( specular, texture2DArray( specularLayers, coord ), weight );
+	normal = mix( normal, texture2DArray( normalLayers, coord ).rgb, weight );
+}
+
+
+void main()
+{
+	vec3 finalColor = gl_FrontMaterial.emission.rgb;
+	vec3 normal = normalize( vNormal );
+	vec3 viewDir = normalize( -vVertex );
+
+	// calculate tangent space matrix
+	vec2 texCoord = vMapCoord * vec2( 1.0, -1.0 );
+	vec3 dpx = dFdx( vVertex );
+	vec3 dpy = dFdy( vVertex );
+	vec2 dtx = dFdx( texCoord );
+	vec2 dty = dFdy( texCoord );
+	vec3 tangent = normalize( dpx * dty.t - dpy * dtx.t );
+	vec3 binormal = normalize( -dpx * dty.s + dpy * dtx.s );
+	mat3 TBN = mat3( tangent, binormal, normal );	// the transpose of texture-to-eye space matrix
+
+	vec2 weightCoord = ( vMapCoord + 0.5 ) / mapSize;
+	vec4 weights0 = texture2D( weightMap0, weightCoord ) * blobEnabled0;
+	vec4 weights1 = texture2D( weightMap1, weightCoord ) * blobEnabled1;
+
+	vec3 baseCoord = vec3( vMapCoord * vec2( baseScale.x, -baseScale.y ), 0.0 );
+	vec4 colorFromMap = texture2DArray( diffuseLayers, baseCoord );
+	vec4 specularFromMap = texture2DArray( specularLayers, baseCoord );
+	vec3 normalFromMap = texture2DArray( normalLayers, baseCoord ).rgb;
+	blend( colorFromMap, specularFromMap, normalFromMap, weights0.x, blobScale[0], blobLayer[0] );
+	blend( colorFromMap, specularFromMap, normalFromMap, weights0.y, blobScale[1], blobLayer[1] );
+	blend( colorFromMap, specularFromMap, normalFromMap, weights0.z, blobScale[2], blobLayer[2] );
+	blend( colorFromMap, specularFromMap, normalFromMap, weights0.w, blobScale[3], blobLayer[3] );
+	blend( colorFromMap, specularFromMap, normalFromMap, weights1.x, blobScale[4], blobLayer[4] );
+	blend( colorFromMap, specularFromMap, normalFromMap, weights1.y, blobScale[5], blobLayer[5] );
+	blend( colorFromMap, specularFromMap, normalFromMap, weights1.z, blobScale[6], blobLayer[6] );
+	blend( colorFromMap, specularFromMap, normalFromMap, weights1.w, blobScale[7], blobLayer[7] );
+	colorFromMap *= gl_Color;
+	if( splatterEnabled )
+		colorFromMap.rgb *= texture2D( splatterMap, vMapCoord / mapSize ).rgb;
+	normal = normalize( TBN * normalize( normalFromMap * 2.0 - 1.0 ) );	// transform the normal to eye space
+
+	float sunShadow = shadowFactor( vVertex );
+	for( int i=0; i<MAX_LIGHTS; ++i )
+	{
+		finalColor += gl_LightSource[i].ambient.rgb * gl_FrontMaterial.ambient.rgb * colorFromMap.rgb;
+
+		vec3 lightDir = normalize( vLightPos[i] );
+		float lambert = max( 0.0, dot( normal, lightDir ) );
+
+		float d = length( vLightPos[i] );
+		float attenuation = 1.0 / (
+			gl_LightSource[i].constantAttenuation +
+			gl_LightSource[i].linearAttenuation * d +
+			gl_LightSource[i].quadraticAttenuation * d*d );
+		if( i == 0 )
+			attenuation *= sunShadow;	// the sun is the first light
+
+		finalColor +=
+			gl_LightSource[i].diffuse.rgb *
+			gl_FrontMaterial.diffuse.rgb *
+			lambert * attenuation * colorFromMap.rgb;
+
+		vec3 R = reflect( -lightDir, normal );
+		float specular = pow( max(dot(R, viewDir), 0.0), gl_FrontMaterial.shininess * specularFromMap.a + 1 );
+
+		finalColor +=
+			gl_LightSource[i].specular.rgb *
+			gl_FrontMaterial.specular.rgb *
+			specular * attenuation * specularFromMap.rgb;
+	}
+
+	vec3 gridDiffuse = vec3( 0.0 );
+	vec3 gridSpecular = vec3( 0.0 );
+	gridLights( vVertex, normal, viewDir, gl_FrontMaterial.shininess * specularFromMap.a + 1, gridDiffuse, gridSpecular );
+	finalColor += gridDiffuse * gl_FrontMaterial.diffuse.rgb * colorFromMap.rgb;
+	finalColor += gridSpecular * gl_FrontMaterial.specular.rgb * specularFromMap.rgb;
+
+	float fogFactor = clamp( -(length( vVertex )-gl_Fog.start) * gl_Fog.scale, 0.0, 1.0 );
+	vec3 finalFragment = mix( gl_Fog.color.rgb, finalColor, fogFactor );
+	gl_FragColor = vec4( finalFragment, 1.0 );
+}
@@ -3,11 +3,64 @@
 varying vec3 vVertex;
 varying vec3 vNormal;
 varying vec4 vTexCoord;
+varying vec4 vReflectionTexCoord;
 
 uniform sampler2D reflectionMap;
 uniform sampler2D refractionMap;
 uniform sampler2D waterMap;
+uniform sampler2D sceneDepthMap;
 uniform float time;
+uniform bool screenSpaceReflection;	// reflect the main pass instead of sampling reflectionMap
+uniform vec3 skyColor;
+
+// distance from the eye to the main pass' geometry at a screen position
+float sceneDistance( vec2 screenCoord )
+{
+	float sceneDepth = texture2D( sceneDepthMap, screenCoord ).r * 2.0 - 1.0;
+	return gl_ProjectionMatrix[3][2] / ( sceneDepth + gl_ProjectionMatrix[2][2] );
+}
+
+vec2 toScreen( vec3 position )
+{
+	vec4 clip = gl_ProjectionMatrix * vec4( position, 1.0 );
+	return clip.xy / clip.w * 0.5 + 0.5;
+}
+
+// marches the reflected ray through the main pass' depth and returns its color there - the sky's color on misses
+vec3 traceReflection( vec3 origin, vec3 direction, vec2 offset )
+{
+	float stepLength = 0.5;
+	vec3 position = origin;
+	for( int i = 0; i < 32; ++i )
+	{
+		vec3 lastPosition = position;
+		position += direction * stepLength;
+		stepLength *= 1.25;
+		if( position.z > -0.01 )
+			break;
+		vec2 screenCoord = toScreen( position );
+		if( any( lessThan( screenCoord, vec2(0.0) ) ) || any( greaterThan( screenCoord, vec2(1.0) ) ) )
+			break;
+		float behind = -position.z - sceneDistance( screenCoord );
+		if( behind > 0.0 && behind < stepLength )
+		{
+			// refine between the last two steps
+			for( int j = 0; j < 4; ++j )
+			{
+				vec3 middle = ( lastPosition + position ) * 0.5;
+				if( -middle.z > sceneDistance( toScreen( middle ) ) )
+					position = middle;
+				else
+					lastPosition = middle;
+			}
+			screenCoord = toScreen( position );
+			vec2 edge = min( screenCoord, 1.0 - screenCoord );
+			float fade = clamp( min( edge.x, edge.y ) * 10.0, 0.0, 1.0 );
+			return mix( skyColor, vec3( texture2D( refractionMap, screenCoord + offset ) ), fade );
+		}
+	}
+	return skyColor;
+}
 
 void main()
 {
@@ -20,10 +73,18 @@ void main()
 	vec2 texCoord = vec2( vTexCoord.x / vTexCoord.w, vTexCoord.y / vTexCoord.w );
 	vec2 samplePos = vec2(256, 255) / 4 + time * 8 * vec2(0,1);
 	vec3 bump = vec3( texture2D( waterMap, gl_TexCoord[0].st/32 + samplePos ) );
-	vec2 perturbation = texCoord + 2 * (bump.rg - 0.5f);
+	vec2 reflTexCoord = vec2( vReflectionTexCoord.x / vReflectionTexCoord.w, vReflectionTexCoord.y / vReflectionTexCoord.w );
+	vec2 perturbation = reflTexCoord + 2 * (bump.rg - 0.5f);
 	vec2 refrPerturbation = texCoord + 0.5 * (bump.rg - 0.5f);
+	// the refraction map is the main pass - perturbed samples in front of the water would show what is above it
+	if( texture2D( sceneDepthMap, refrPerturbation ).r < gl_FragCoord.z )
+		refrPerturbation = texCoord;
 
-	vec3 reflection = vec3( texture2D( reflectionMap, perturbation ) );
+	vec3 reflection;
+	if( screenSpaceReflection )
+		reflection = traceReflection( vVertex, reflect( -viewDir, normal ), 0.05 * (bump.rg - 0.5) );
+	else
+		reflection = vec3( texture2D( reflectionMap, perturbation ) );
 	vec3 refraction = vec3( texture2D( refractionMap, refrPerturbation ) );
 
 	vec3 finalColor = mix( reflection, refraction, (1-fresnelTerm) );
@@ -3,6 +3,9 @@
 varying vec3 vVertex;
 varying vec3 vNormal;
 varying vec4 vTexCoord;
+varying vec4 vReflectionTexCoord;
+
+uniform mat4 reflectionMatrix;	// view projection the reflection was rendered for
 
 void main()
 {
@@ -15,6 +18,7 @@ void main()
 	vVertex = vec3( gl_ModelViewMatrix * gl_Vertex );
 	vNormal = gl_NormalMatrix * gl_Normal;
 	vTexCoord = (gl_ModelViewProjectionMatrix * gl_Vertex) * proj2Tex;
+	vReflectionTexCoord = (reflectionMatrix * gl_Vertex) * proj2Tex;
 	gl_TexCoord[0].xy   = gl_MultiTexCoord0.xy;
 	gl_Position = ftransform();
 }
@@ -25,9 +25,11 @@
 
 #include <scene/Scene.hpp>
 #include <scene/object/Landscape.hpp>
+#include <resource/ResourceCache.hpp>
 
 #include <QBoxLayout>
 #include <QCheckBox>
+#include <QPushButton>
 #include <QSlider>
 #include <QLabel>
 #include <QDebug>
@@ -50,6 +52,10 @@ DebugWindow::DebugWindow( Scene * scene, QWidget * parent ) :
 	QObject::connect( mObjectBoundingSpheres, SIGNAL(stateChanged(int)), this, SLOT(setObjectBoundingSpheres(int)) );
 	mLayout->addWidget( mObjectBoundingSpheres );
 
+	mDumpResourceCaches = new QPushButton( "Dump resource caches" );
+	QObject::connect( mDumpResourceCaches, SIGNAL(clicked()), this, SLOT(dumpResourceCaches()) );
+	mLayout->addWidget( mDumpResourceCaches );
+
 	mLayout->addSpacerItem( new QSpacerItem( 50, 1, QSizePolicy::Expanding, QSizePolicy::Expanding ) );
 
 	setLayout( mLayout );
@@ -61,6 +67,7 @@ DebugWindow::~DebugWindow()
 	delete mLayout;
 	delete mWireFrame;
 	delete mObjectBoundingSpheres;
+	delete mDumpResourceCaches;
 }
 
 
@@ -74,3 +81,9 @@ void DebugWindow::setObjectBoundingSpheres( int enable )
 {
 	AObject::setGlobalDebugBoundingSpheres( enable );
 }
+
+
+void DebugWindow::dumpResourceCaches()
+{
+	ResourceCache::dump();
+}
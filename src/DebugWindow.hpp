@@ -32,6 +32,7 @@ class Scene;
 
 class QSlider;
 class QCheckBox;
+class QPushButton;
 class QBoxLayout;
 
 
@@ -48,10 +49,12 @@ private:
 	QBoxLayout * mLayout;
 	QCheckBox * mWireFrame;
 	QCheckBox * mObjectBoundingSpheres;
+	QPushButton * mDumpResourceCaches;
 
 public slots:
 	void setWireFrame( int enable );
 	void setObjectBoundingSpheres( int enable );
+	void dumpResourceCaches();
 };
 
 
@@ -27,6 +27,9 @@
 #include <scene/object/environment/AVegetation.hpp>
 #include <scene/object/Landscape.hpp>
 #include <scene/Scene.hpp>
+#include <scene/ShadowMap.hpp>
+#include <scene/PostProcess.hpp>
+#include <scene/DynamicResolution.hpp>
 #include <scene/object/World.hpp>
 
 #include <QBoxLayout>
@@ -81,6 +84,11 @@ GfxOptionWindow::GfxOptionWindow( Scene * scene, QWidget * parent ) :
 	mLayout->addWidget( mLandscapeBlobPriorityLabel );
 	mLayout->addWidget( mLandscapeBlobPriority );
 
+	mLandscapeSinglePass = new QCheckBox( "Single Pass Terrain" );
+	mLandscapeSinglePass->setChecked( Landscape::singlePassTerrain() );
+	QObject::connect( mLandscapeSinglePass, SIGNAL(stateChanged(int)), this, SLOT(setSinglePassTerrain(int)) );
+	mLayout->addWidget( mLandscapeSinglePass );
+
 	mLandscapeVegetationPriorityLabel = new QLabel();
 	mLandscapeVegetationPriority = new QSlider( Qt::Horizontal );
 	mLandscapeVegetationPriority->setRange( 0, 99 );
@@ -92,6 +100,17 @@ GfxOptionWindow::GfxOptionWindow( Scene * scene, QWidget * parent ) :
 	mLayout->addWidget( mLandscapeVegetationPriorityLabel );
 	mLayout->addWidget( mLandscapeVegetationPriority );
 
+	mShadowQualityLabel = new QLabel();
+	mShadowQuality = new QSlider( Qt::Horizontal );
+	mShadowQuality->setRange( 0, 3 );
+	mShadowQuality->setSingleStep( 1 );
+	mShadowQuality->setPageStep( 1 );
+	mShadowQuality->setValue( ShadowMap::quality() );
+	setShadowQuality( mShadowQuality->value() );
+	QObject::connect( mShadowQuality, SIGNAL(valueChanged(int)), this, SLOT(setShadowQuality(int)) );
+	mLayout->addWidget( mShadowQualityLabel );
+	mLayout->addWidget( mShadowQuality );
+
 	mMaterialAnisotropyLabel = new QLabel();
 	mMaterialAnisotropy = new QSlider( Qt::Horizontal );
 	mMaterialAnisotropy->setRange( 1, Material::filterAnisotropyMaximum() );
@@ -121,6 +140,27 @@ GfxOptionWindow::GfxOptionWindow( Scene * scene, QWidget * parent ) :
 	QObject::connect( mMultiSample, SIGNAL(stateChanged(int)), this, SLOT(setMultiSample(int)) );
 	mLayout->addWidget( mMultiSample );
 
+	QSettings settings;
+	mPostProcess = new QCheckBox( "HDR Post Processing (needs restart)" );
+	mPostProcess->setChecked( settings.value( "postProcess", true ).toBool() );
+	QObject::connect( mPostProcess, SIGNAL(stateChanged(int)), this, SLOT(setPostProcess(int)) );
+	mLayout->addWidget( mPostProcess );
+
+	mBloom = new QCheckBox( "Bloom" );
+	mBloom->setChecked( PostProcess::bloom() );
+	QObject::connect( mBloom, SIGNAL(stateChanged(int)), this, SLOT(setBloom(int)) );
+	mLayout->addWidget( mBloom );
+
+	mFXAA = new QCheckBox( "FXAA" );
+	mFXAA->setChecked( PostProcess::fxaa() );
+	QObject::connect( mFXAA, SIGNAL(stateChanged(int)), this, SLOT(setFXAA(int)) );
+	mLayout->addWidget( mFXAA );
+
+	mDynamicResolution = new QCheckBox( "Dynamic Resolution" );
+	mDynamicResolution->setChecked( DynamicResolution::enabled() );
+	QObject::connect( mDynamicResolution, SIGNAL(stateChanged(int)), this, SLOT(setDynamicResolution(int)) );
+	mLayout->addWidget( mDynamicResolution );
+
 	mStereo = new QCheckBox( "Stereo Rendering" );
 	mStereo->setChecked( mScene->stereo() );
 	QObject::connect( mStereo, SIGNAL(stateChanged(int)), this, SLOT(setStereo(int)) );
@@ -142,7 +182,13 @@ GfxOptionWindow::~GfxOptionWindow()
 	delete mStereo;
 	delete mStereoUseOVR;
 	delete mMultiSample;
+	delete mPostProcess;
+	delete mBloom;
+	delete mFXAA;
+	delete mLandscapeSinglePass;
 	delete mFarPlaneLabel;
+	delete mShadowQuality;
+	delete mShadowQualityLabel;
 	delete mMaterialAnisotropy;
 	delete mMaterialAnisotropyLabel;
 	delete mMaterialQuality;
@@ -195,6 +241,16 @@ void GfxOptionWindow::setBlobQuality( int q )
 }
 
 
+void GfxOptionWindow::setSinglePassTerrain( int state )
+{
+	bool enable = state;
+	Landscape::setSinglePassTerrain( enable );
+
+	QSettings settings;
+	settings.setValue( "landscapeSinglePassTerrain", enable );
+}
+
+
 void GfxOptionWindow::setVegetationQuality( int q )
 {
 	AVegetation::setQuality( q );
@@ -205,6 +261,16 @@ void GfxOptionWindow::setVegetationQuality( int q )
 }
 
 
+void GfxOptionWindow::setShadowQuality( int q )
+{
+	ShadowMap::setQuality( q );
+	mShadowQualityLabel->setText(tr("Shadow Quality (%1):").arg(q));
+
+	QSettings settings;
+	settings.setValue( "shadowQuality", q );
+}
+
+
 void GfxOptionWindow::setFarPlane( int distance )
 {
 	mScene->eye()->setFarPlane( distance );
@@ -225,6 +291,45 @@ void GfxOptionWindow::setMultiSample( int state )
 }
 
 
+void GfxOptionWindow::setPostProcess( int state )
+{
+	bool enable = state;
+
+	QSettings settings;
+	settings.setValue( "postProcess", enable );
+}
+
+
+void GfxOptionWindow::setBloom( int state )
+{
+	bool enable = state;
+	PostProcess::setBloom( enable );
+
+	QSettings settings;
+	settings.setValue( "bloom", enable );
+}
+
+
+void GfxOptionWindow::setFXAA( int state )
+{
+	bool enable = state;
+	PostProcess::setFXAA( enable );
+
+	QSettings settings;
+	settings.setValue( "fxaa", enable );
+}
+
+
+void GfxOptionWindow::setDynamicResolution( int state )
+{
+	bool enable = state;
+	DynamicResolution::setEnabled( enable );
+
+	QSettings settings;
+	settings.setValue( "dynamicResolution", enable );
+}
+
+
 void GfxOptionWindow::setStereo( int state )
 {
 	bool enable = state;
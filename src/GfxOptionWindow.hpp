@@ -55,11 +55,18 @@ private:
 	QSlider * mMaterialAnisotropy;
 	QLabel * mLandscapeBlobPriorityLabel;
 	QSlider * mLandscapeBlobPriority;
+	QCheckBox * mLandscapeSinglePass;
 	QLabel * mLandscapeVegetationPriorityLabel;
 	QSlider * mLandscapeVegetationPriority;
+	QLabel * mShadowQualityLabel;
+	QSlider * mShadowQuality;
 	QLabel * mFarPlaneLabel;
 	QSlider * mFarPlane;
 	QCheckBox * mMultiSample;
+	QCheckBox * mPostProcess;
+	QCheckBox * mBloom;
+	QCheckBox * mFXAA;
+	QCheckBox * mDynamicResolution;
 	QCheckBox * mStereo;
 	QCheckBox * mStereoUseOVR;
 
@@ -68,9 +75,15 @@ public slots:
 	void setSplatterQuality( int q );
 	void setMaterialFilterAnisotropy( int a );
 	void setBlobQuality( int q );
+	void setSinglePassTerrain( int state );
 	void setVegetationQuality( int q );
+	void setShadowQuality( int q );
 	void setFarPlane( int distance );
 	void setMultiSample( int state );
+	void setPostProcess( int state );
+	void setBloom( int state );
+	void setFXAA( int state );
+	void setDynamicResolution( int state );
 	void setStereo( int state );
 	void setStereoUseOVR( int state );
 };
@@ -25,10 +25,28 @@
 
 #include <GLWidget.hpp>
 #include <scene/Scene.hpp>
+#include <scene/LightGrid.hpp>
+#include <scene/ShadowMap.hpp>
+#include <scene/PostProcess.hpp>
+#include <scene/RenderTargetPool.hpp>
+#include <scene/DynamicResolution.hpp>
 #include <scene/object/Eye.hpp>
 #include <scene/object/World.hpp>
 #include <scene/object/Landscape.hpp>
+#include <scene/object/Sky.hpp>
 #include <scene/object/environment/AVegetation.hpp>
+#include <geometry/ParticleSystem.hpp>
+#include <geometry/GPUParticleSystem.hpp>
+#include <geometry/ColliderGrid.hpp>
+#include <effect/SplatterSystem.hpp>
+#include <effect/EffectBudget.hpp>
+#include <resource/ResourceLoader.hpp>
+#include <resource/ResourceCache.hpp>
+#include <resource/CompressedTexture.hpp>
+#include <resource/ShaderBinaryCache.hpp>
+#include <resource/Material.hpp>
+#include <resource/AudioSample.hpp>
+#include <resource/StaticModel.hpp>
 
 #include <QBoxLayout>
 #include <QLabel>
@@ -111,6 +129,10 @@ void View::initGL()
 	mGLWidget = new GLWidget( glFormat, this );
 	setViewport( mGLWidget );
 
+	CompressedTexture::setCompressionSupported(
+		settings.value( "compressedTextures", true ).toBool() && GLEW_EXT_texture_compression_s3tc );
+	ShaderBinaryCache::setEnabled( settings.value( "shaderBinaryCache", true ).toBool() );
+
 	const GLubyte * vendorGL = glGetString( GL_VENDOR );
 	qDebug( "\t* %s:\t%s", qPrintable(tr("Vendor")), vendorGL );
 	const GLubyte * rendererGL = glGetString( GL_RENDERER );
@@ -127,6 +149,11 @@ void View::initGL()
 void View::initScene()
 {
 	QSettings settings;
+	ResourceLoader::setEnabled( settings.value( "resourceAsyncLoading", true ).toBool() );
+	ResourceLoader::setUploadBudget( settings.value( "resourceUploadBudget", 4 ).toInt() );
+	Material::setCacheBudget( settings.value( "materialCacheBudget", 256 ).toLongLong()*1024*1024 );
+	StaticModel::setCacheBudget( settings.value( "staticModelCacheBudget", 64 ).toLongLong()*1024*1024 );
+	AudioSample::setCacheBudget( settings.value( "audioSampleCacheBudget", 64 ).toLongLong()*1024*1024 );
 	Material::setFilterAnisotropy( settings.value( "materialFilterAnisotropy", 1.0f ).toFloat() );
 	MaterialQuality::setMaximum( MaterialQuality::fromString(
 		settings.value( "materialQuality", MaterialQuality::toString(MaterialQuality::HIGH) ).toString()
@@ -135,7 +162,48 @@ void View::initScene()
 		settings.value( "splatterQuality", SplatterQuality::toString(SplatterQuality::HIGH) ).toString()
 	));
 	Landscape::Blob::setQuality( settings.value( "landscapeBlobQuality", 99 ).toInt() );
+	Landscape::setSinglePassTerrain( settings.value( "landscapeSinglePassTerrain", true ).toBool() );
+	Landscape::setReflectionScale( settings.value( "landscapeReflectionScale", 0.5f ).toFloat() );
+	Landscape::setReflectionInterval( settings.value( "landscapeReflectionInterval", 2 ).toInt() );
+	Landscape::setScreenSpaceReflection( settings.value( "landscapeScreenSpaceReflection", false ).toBool() );
+	Sky::setCacheSize( settings.value( "skyCacheSize", 512 ).toInt() );
+	Sky::setCacheTolerance( settings.value( "skyCacheTolerance", 0.002f ).toFloat() );
+	LightGrid::setTileSize( settings.value( "lightGridTileSize", 32 ).toInt() );
+	LightGrid::setMaxLights( settings.value( "lightGridMaxLights", 128 ).toInt() );
+	ShadowMap::setQuality( settings.value( "shadowQuality", 2 ).toInt() );
+	ShadowMap::setSize( settings.value( "shadowMapSize", 1024 ).toInt() );
+	ShadowMap::setDistance( settings.value( "shadowDistance", 300.0f ).toFloat() );
+	ShadowMap::setVegetationBudget( settings.value( "shadowVegetationBudget", 256 ).toInt() );
+	RenderTargetPool::setIdleFrames( settings.value( "renderTargetIdleFrames", 120 ).toInt() );
+	PostProcess::setBloom( settings.value( "bloom", true ).toBool() );
+	PostProcess::setBloomDivisor( settings.value( "bloomDivisor", 2 ).toInt() );
+	PostProcess::setBloomThreshold( settings.value( "bloomThreshold", 0.8f ).toFloat() );
+	PostProcess::setBloomStrength( settings.value( "bloomStrength", 0.3f ).toFloat() );
+	PostProcess::setExposure( settings.value( "exposure", 1.0f ).toFloat() );
+	PostProcess::setFXAA( settings.value( "fxaa", true ).toBool() );
+	DynamicResolution::setEnabled( settings.value( "dynamicResolution", true ).toBool() );
+	DynamicResolution::setTargetTime( settings.value( "dynamicResolutionTargetTime", 14.0f ).toFloat() );
+	DynamicResolution::setMinimumScale( settings.value( "dynamicResolutionMinimumScale", 0.5f ).toFloat() );
 	AVegetation::setQuality( settings.value( "landscapeVegetationQuality", 99 ).toInt() );
+	ParticleSystem::setGPUExpansion( settings.value( "particleGPUExpansion", true ).toBool() );
+	GPUParticleSystem::setEnabled( settings.value( "particleGPUSimulation", true ).toBool() );
+	ParticleSystem::setSorting( settings.value( "particleSorting", true ).toBool() );
+	ParticleSystem::setSoftness( settings.value( "particleSoftness", 1.0f ).toFloat() );
+	ColliderGrid::setBudget( settings.value( "particleCollisionBudget", 2048 ).toInt() );
+	SplatterSystem::setDecals( settings.value( "splatterDecals", true ).toBool() );
+	SplatterSystem::setAccumulation( settings.value( "splatterAccumulation", false ).toBool() );
+	EffectBudget::setMaxParticles( settings.value( "effectMaxParticles", 4096 ).toInt() );
+	EffectBudget::setMaxEmittedParticles( settings.value( "effectMaxEmittedParticles", 1024 ).toInt() );
+	EffectBudget::setMaxPlacedSplatters( settings.value( "effectMaxPlacedSplatters", 32 ).toInt() );
+	EffectBudget::setMaxDecals( settings.value( "effectMaxDecals", 2048 ).toInt() );
+	EffectBudget::setNearDistance( settings.value( "effectNearDistance", 40.0f ).toFloat() );
+	EffectBudget::setFarDistance( settings.value( "effectFarDistance", 400.0f ).toFloat() );
+
+	if( settings.value( "shaderPrecompile", true ).toBool() )
+	{
+		int num = Material::precompileShaders( mGLWidget );
+		qDebug( "* %s", qPrintable(tr("Precompiled %1 material shaders").arg(num)) );
+	}
 
 	mScene = new Scene( mGLWidget, this );
 	mWorld = new World( mScene, "earth" );
@@ -154,11 +222,14 @@ View::View( QWidget * parent ) : QGraphicsView( parent )
 
 View::~View()
 {
+	ResourceLoader::finish();
+	delete mScene->root();
+	delete mScene;
+	// cached buffers and sources need the AL context to be released
+	ResourceCache::clear();
 	alcMakeContextCurrent( NULL );
 	alcDestroyContext( mALContext );
 	alcCloseDevice( mALDevice );
-	delete mScene->root();
-	delete mScene;
 	delete mGLWidget;
 }
 
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EffectBudget.hpp"
+
+#include <scene/object/Eye.hpp>
+
+#include <math.h>
+
+
+const float EffectBudget::offscreenFactor = 0.25f;
+const float EffectBudget::priorityShare = 0.25f;
+const float EffectBudget::skipThreshold = 0.1f;
+const float EffectBudget::skipInterval = 0.1f;
+
+FrustumTest EffectBudget::sFrustum;
+QVector3D EffectBudget::sEyePosition;
+bool EffectBudget::sSynced = false;
+int EffectBudget::sLiveParticles = 0;
+int EffectBudget::sEmittedParticles = 0;
+int EffectBudget::sPlacedSplatters = 0;
+int EffectBudget::sMaxParticles = 4096;
+int EffectBudget::sMaxEmittedParticles = 1024;
+int EffectBudget::sMaxPlacedSplatters = 32;
+int EffectBudget::sMaxDecals = 2048;
+float EffectBudget::sNearDistance = 40.0f;
+float EffectBudget::sFarDistance = 400.0f;
+
+
+void EffectBudget::beginFrame( const Eye * eye )
+{
+	sFrustum.sync( eye->projectionMatrix(), eye->viewMatrix() );
+	sEyePosition = eye->position();
+	sSynced = true;
+	sEmittedParticles = 0;
+	sPlacedSplatters = 0;
+}
+
+
+float EffectBudget::lod( const QVector3D & center, const float & radius )
+{
+	if( !sSynced )
+		return 1.0f;
+	float distance = ( center - sEyePosition ).length() - radius;
+	if( distance <= sNearDistance )
+		return 1.0f;
+	float lod = 1.0f - ( distance - sNearDistance ) / qMax( sFarDistance - sNearDistance, 1.0f );
+	if( lod <= 0.0f )
+		return 0.0f;
+	if( !sFrustum.isSphereInFrustum( center, radius ) )
+		lod *= offscreenFactor;
+	return lod;
+}
+
+
+int EffectBudget::grant( const QVector3D & position, int wanted, int limit, int & used )
+{
+	float detail = lod( position );
+	// far emitters leave a share of the frame budget for the ones near the player
+	if( detail < 1.0f )
+		limit = (int)( limit * ( 1.0f - priorityShare ) );
+	int granted = qMin( (int)ceilf( wanted * detail ), limit - used );
+	if( granted <= 0 )
+		return 0;
+	used += granted;
+	return granted;
+}
+
+
+int EffectBudget::grantParticles( const QVector3D & position, int wanted, bool live )
+{
+	if( live )
+		wanted = qMin( wanted, sMaxParticles - sLiveParticles - sEmittedParticles );
+	if( wanted <= 0 )
+		return 0;
+	return grant( position, wanted, sMaxEmittedParticles, sEmittedParticles );
+}
+
+
+int EffectBudget::grantSplatters( const QVector3D & position, int wanted )
+{
+	return grant( position, wanted, sMaxPlacedSplatters, sPlacedSplatters );
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_EFFECTBUDGET_INCLUDED
+#define EFFECT_EFFECTBUDGET_INCLUDED
+
+#include <utility/FrustumTest.hpp>
+
+#include <QVector3D>
+
+
+class Eye;
+
+
+/// Limits the cost of particle and splatter effects
+/**
+ * Caps the number of live CPU particles and limits how many particles and splatters may be emitted per frame,
+ * so mass-kill moments don't spike the frame time.\n
+ * Emitters get a level of detail from their distance to the eye and whether they are on screen:
+ * - Within nearDistance emitters get full detail and may use the whole frame budget.
+ * - Further away emission is reduced linearly until farDistance, where it is skipped.
+ * - Off-screen emitters get offscreenFactor of that.
+ * - Emitters not at full detail can only use the part of the frame budget not reserved for near ones.
+ * - Effects whose level of detail drops below skipThreshold are only simulated every skipInterval seconds.
+ */
+class EffectBudget
+{
+public:
+	/// Syncs to the eye's last applied matrices and resets the per-frame limits - call once per frame before effects are emitted
+	static void beginFrame( const Eye * eye );
+
+	/// Level of detail of an emitter or effect from 0 (skip) to 1 (full)
+	static float lod( const QVector3D & center, const float & radius = 0.0f );
+	/// Returns how many of the wanted particles may be emitted at the position and takes them from the frame's budget
+	/**
+	 * @param live Whether the particles count towards the live particle cap - false for particles simulated on the GPU.
+	 */
+	static int grantParticles( const QVector3D & position, int wanted, bool live = true );
+	/// Returns how many of the wanted splatters may be placed at the position and takes them from the frame's budget
+	static int grantSplatters( const QVector3D & position, int wanted );
+
+	/// Set by the ParticleEffectManager to the number of alive CPU particles after updating
+	static void setLiveParticles( const int & live ) { sLiveParticles = live; }
+	static const int & liveParticles() { return sLiveParticles; }
+
+	/// Maximum number of alive CPU particles of all effects
+	static const int & maxParticles() { return sMaxParticles; }
+	static void setMaxParticles( const int & max ) { sMaxParticles = max; }
+	/// Maximum number of particles emitted per frame
+	static const int & maxEmittedParticles() { return sMaxEmittedParticles; }
+	static void setMaxEmittedParticles( const int & max ) { sMaxEmittedParticles = max; }
+	/// Maximum number of splatters placed per frame
+	static const int & maxPlacedSplatters() { return sMaxPlacedSplatters; }
+	static void setMaxPlacedSplatters( const int & max ) { sMaxPlacedSplatters = max; }
+	/// Maximum number of splatter decals kept by a splatter system
+	static const int & maxDecals() { return sMaxDecals; }
+	static void setMaxDecals( const int & max ) { sMaxDecals = max; }
+	/// Emitters closer to the eye get full detail
+	static const float & nearDistance() { return sNearDistance; }
+	static void setNearDistance( const float & distance ) { sNearDistance = distance; }
+	/// Emitters further away from the eye are skipped
+	static const float & farDistance() { return sFarDistance; }
+	static void setFarDistance( const float & distance ) { sFarDistance = distance; }
+
+	static const float offscreenFactor;	///< Level of detail factor for emitters outside the view frustum
+	static const float priorityShare;	///< Part of the frame budget only emitters at full detail may use
+	static const float skipThreshold;	///< Effects below this level of detail are simulated less often
+	static const float skipInterval;	///< Seconds between simulation steps of skipped effects
+
+private:
+	EffectBudget() {}
+	static int grant( const QVector3D & position, int wanted, int limit, int & used );
+
+	static FrustumTest sFrustum;
+	static QVector3D sEyePosition;
+	static bool sSynced;
+	static int sLiveParticles;
+	static int sEmittedParticles;
+	static int sPlacedSplatters;
+	static int sMaxParticles;
+	static int sMaxEmittedParticles;
+	static int sMaxPlacedSplatters;
+	static int sMaxDecals;
+	static float sNearDistance;
+	static float sFarDistance;
+};
+
+
+#endif
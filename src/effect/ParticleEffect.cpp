@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParticleEffect.hpp"
+#include "EffectBudget.hpp"
+
+#include <geometry/ParticleSystem.hpp>
+#include <geometry/GPUParticleSystem.hpp>
+#include <geometry/ColliderGrid.hpp>
+#include <resource/Material.hpp>
+#include <utility/FrustumTest.hpp>
+#include <utility/glWrappers.hpp>
+
+#include <QSettings>
+#include <QFile>
+#include <QDebug>
+
+
+ParticleEffect::ParticleEffect( GLWidget * glWidget, const QString & name ) :
+	mName( name )
+{
+	QString iniPath = baseDirectory()+name+"/effect.ini";
+	if( !QFile::exists( iniPath ) )
+		qWarning() << "!" << this << "ParticleEffect" << iniPath << "not found - using defaults";
+	QSettings s( iniPath, QSettings::IniFormat );
+
+	s.beginGroup( "Particles" );
+		mParticleSystem = new ParticleSystem( s.value( "capacity", 256 ).toInt() );
+		mParticleSystem->setSize( s.value( "size", 1.0f ).toFloat() );
+		mParticleSystem->setGravity( QVector3D(
+			s.value( "gravityX", 0.0f ).toFloat(),
+			s.value( "gravityY", -9.81f ).toFloat(),
+			s.value( "gravityZ", 0.0f ).toFloat()
+		) );
+		mParticleSystem->setDrag( s.value( "drag", 1.0f ).toFloat() );
+		mParticleSystem->setMinLife( s.value( "minLife", 1.0f ).toFloat() );
+		mParticleSystem->setMaxLife( s.value( "maxLife", 2.0f ).toFloat() );
+		int gpuCapacity = s.value( "gpuCapacity", 0 ).toInt();
+	s.endGroup();
+
+	mGPUParticleSystem = NULL;
+	if( gpuCapacity > 0 && GPUParticleSystem::supported() )
+	{
+		mGPUParticleSystem = new GPUParticleSystem( glWidget, gpuCapacity );
+		mGPUParticleSystem->setSize( mParticleSystem->size() );
+		mGPUParticleSystem->setGravity( mParticleSystem->gravity() );
+		mGPUParticleSystem->setDrag( mParticleSystem->drag() );
+		mGPUParticleSystem->setMinLife( mParticleSystem->minLife() );
+		mGPUParticleSystem->setMaxLife( mParticleSystem->maxLife() );
+	}
+
+	s.beginGroup( "Draw" );
+		mMaterial = new Material( glWidget, s.value( "material", "Splatter" ).toString(),
+			ParticleSystem::gpuExpansion() ? MaterialShaderVariant::BILLBOARD : MaterialShaderVariant::DEFAULT );
+		mPass = s.value( "pass", 1 ).toInt();
+		QString blend = s.value( "blend", "none" ).toString();
+		if( blend == "alpha" )
+			mBlending = BLEND_ALPHA;
+		else if( blend == "additive" )
+			mBlending = BLEND_ADDITIVE;
+		else
+			mBlending = BLEND_NONE;
+		mDepthWrite = s.value( "depthWrite", true ).toBool();
+		mColor = QVector4D(
+			s.value( "colorRed", 1.0f ).toFloat(),
+			s.value( "colorGreen", 1.0f ).toFloat(),
+			s.value( "colorBlue", 1.0f ).toFloat(),
+			s.value( "colorAlpha", 1.0f ).toFloat()
+		);
+	s.endGroup();
+
+	s.beginGroup( "Collision" );
+		QString response = s.value( "response", "none" ).toString();
+		mCollide = response == "bounce" || response == "stick";
+		mCollisionResponse = response == "stick" ? ColliderGrid::STICK : ColliderGrid::BOUNCE;
+		mBounce = s.value( "bounce", 0.5f ).toFloat();
+		mCollisionRadius = s.value( "radius", mParticleSystem->size()*0.5f ).toFloat();
+	s.endGroup();
+	mCollisionSpan = 0;
+	mSkippedDelta = 0.0;
+
+	qDebug() << "+" << this << "ParticleEffect" << name;
+}
+
+
+ParticleEffect::~ParticleEffect()
+{
+	delete mGPUParticleSystem;
+	delete mParticleSystem;
+	delete mMaterial;
+	qDebug() << "-" << this << "ParticleEffect" << mName;
+}
+
+
+bool ParticleEffect::idle() const
+{
+	return !mParticleSystem->alive() && ( !mGPUParticleSystem || mGPUParticleSystem->idle() );
+}
+
+
+void ParticleEffect::update( const double & delta, ColliderGrid * colliders )
+{
+	float lod = 0.0f;
+	if( mParticleSystem->alive() )
+		lod = EffectBudget::lod( mParticleSystem->boundsCenter(), mParticleSystem->boundsRadius() );
+	if( mGPUParticleSystem && !mGPUParticleSystem->idle() )
+		lod = qMax( lod, EffectBudget::lod( mGPUParticleSystem->boundsCenter(), mGPUParticleSystem->boundsRadius() ) );
+	mSkippedDelta += delta;
+	if( lod < EffectBudget::skipThreshold && mSkippedDelta < EffectBudget::skipInterval )
+		return;
+	const double step = mSkippedDelta;
+	mSkippedDelta = 0.0;
+
+	if( mParticleSystem->alive() )
+	{
+		mParticleSystem->update( step );
+		if( mCollide && colliders )
+		{
+			// start at a different span each frame so all particles get tested if the budget runs out
+			int spans = ( mParticleSystem->alive() + ParticleSystem::spanSize - 1 ) / ParticleSystem::spanSize;
+			mCollisionSpan = ( mCollisionSpan + 1 ) % qMax( 1, spans );
+			for( int n = 0; n < spans; ++n )
+			{
+				int first = ( ( mCollisionSpan + n ) % spans ) * ParticleSystem::spanSize;
+				ParticleSystem::Span span( mParticleSystem, first, qMin( ParticleSystem::spanSize, mParticleSystem->alive()-first ) );
+				colliders->collide( span, mCollisionRadius, (ColliderGrid::Response)mCollisionResponse, mBounce );
+			}
+		}
+	}
+	if( mGPUParticleSystem && !mGPUParticleSystem->idle() )
+		mGPUParticleSystem->update( step );
+}
+
+
+void ParticleEffect::draw( const QMatrix4x4 & modelView, const FrustumTest & frustum )
+{
+	bool drawCPU = mParticleSystem->alive() &&
+		frustum.isSphereInFrustum( mParticleSystem->boundsCenter(), mParticleSystem->boundsRadius() );
+	bool drawGPU = mGPUParticleSystem && !mGPUParticleSystem->idle() &&
+		frustum.isSphereInFrustum( mGPUParticleSystem->boundsCenter(), mGPUParticleSystem->boundsRadius() );
+	if( !drawCPU && !drawGPU )
+		return;
+
+	glPushAttrib( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_CURRENT_BIT );
+	glColor( mColor );
+	glDepthMask( mDepthWrite ? GL_TRUE : GL_FALSE );
+	switch( mBlending )
+	{
+	case BLEND_NONE:
+		glDisable( GL_BLEND );
+		break;
+	case BLEND_ALPHA:
+		glEnable( GL_BLEND );
+		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+		break;
+	case BLEND_ADDITIVE:
+		glEnable( GL_BLEND );
+		glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+		break;
+	}
+
+	mMaterial->bind();
+	if( drawCPU )
+		mParticleSystem->draw( modelView );
+	if( drawGPU )
+		mGPUParticleSystem->draw();
+	mMaterial->release();
+
+	glPopAttrib();
+}
+
+
+int ParticleEffect::emitSpherical( const QVector3D & source, int toEmit, const float & minVel, const float & maxVel,
+	const QVector3D & velOffset, bool onGPU )
+{
+	bool gpu = mGPUParticleSystem && onGPU;
+	toEmit = EffectBudget::grantParticles( source, toEmit, !gpu );
+	if( toEmit <= 0 )
+		return 0;
+	if( gpu )
+		mGPUParticleSystem->emitSpherical( source, toEmit, minVel, maxVel, velOffset );
+	else
+		mParticleSystem->emitSpherical( source, toEmit, minVel, maxVel, velOffset );
+	return toEmit;
+}
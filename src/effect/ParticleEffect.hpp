@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_PARTICLEEFFECT_INCLUDED
+#define EFFECT_PARTICLEEFFECT_INCLUDED
+
+#include <GLWidget.hpp>
+#include <resource/AResource.hpp>
+
+#include <QString>
+#include <QVector3D>
+#include <QVector4D>
+
+
+class Material;
+class ParticleSystem;
+class GPUParticleSystem;
+class FrustumTest;
+class ColliderGrid;
+
+
+/// Particle effect defined by an ini file
+/**
+ * Reads ./data/effect/<name>/effect.ini:
+ * - [Particles] capacity, gpuCapacity, size, gravityX/Y/Z, drag, minLife and maxLife
+ * - [Draw] material, pass (1 for opaque objects, 2 for transparent ones), blend (none, alpha or additive),
+ *   depthWrite and colorRed/Green/Blue/Alpha
+ * - [Collision] response (none, bounce or stick), bounce and radius (half the size by default) - applies to particles simulated on the CPU
+ *
+ * Effects are shared by all emitters through the ParticleEffectManager, which also updates and draws them.
+ * A gpuCapacity of zero or an unsupported GPU simulation keeps all particles on the CPU.
+ */
+class ParticleEffect
+{
+public:
+	ParticleEffect( GLWidget * glWidget, const QString & name );
+	~ParticleEffect();
+
+	/// Updates both particle systems and collides the CPU particles with the colliders if given
+	/**
+	 * Effects with a low level of detail collect the time and are only simulated every EffectBudget::skipInterval seconds.
+	 */
+	void update( const double & delta, ColliderGrid * colliders = NULL );
+	/// Binds the material and the draw states, draws both particle systems unless their bounds are outside the frustum
+	void draw( const QMatrix4x4 & modelView, const FrustumTest & frustum );
+	/// Emits into the GPU particle system if available and onGPU is set, into the CPU particle system otherwise
+	/**
+	 * The number of particles is limited by the EffectBudget.
+	 * @return The number of particles actually emitted.
+	 */
+	int emitSpherical( const QVector3D & source, int toEmit, const float & minVel, const float & maxVel,
+		const QVector3D & velOffset = QVector3D(0,0,0), bool onGPU = true );
+
+	/// Returns true if no particle is alive - idle effects are neither updated nor drawn
+	bool idle() const;
+
+	const QString & name() const { return mName; }
+	const int & pass() const { return mPass; }
+	Material * material() const { return mMaterial; }
+	ParticleSystem * particleSystem() const { return mParticleSystem; }
+	/// Returns the particle system simulated on the GPU or NULL if not available
+	GPUParticleSystem * gpuParticleSystem() const { return mGPUParticleSystem; }
+
+	static QString baseDirectory() { return AResourceData::baseDirectory()+"effect/"; }
+
+private:
+	enum Blending
+	{
+		BLEND_NONE,
+		BLEND_ALPHA,
+		BLEND_ADDITIVE
+	};
+
+	QString mName;
+	int mPass;
+	Blending mBlending;
+	bool mDepthWrite;
+	QVector4D mColor;
+	bool mCollide;
+	int mCollisionResponse;
+	float mBounce;
+	float mCollisionRadius;
+	int mCollisionSpan;
+	double mSkippedDelta;
+	Material * mMaterial;
+	ParticleSystem * mParticleSystem;
+	GPUParticleSystem * mGPUParticleSystem;
+};
+
+
+#endif
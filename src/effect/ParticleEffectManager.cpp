@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ParticleEffectManager.hpp"
+#include "EffectBudget.hpp"
+
+#include <geometry/ColliderGrid.hpp>
+#include <utility/FrustumTest.hpp>
+
+
+QHash< QString, QWeakPointer<ParticleEffect> > ParticleEffectManager::sEffects;
+ColliderGrid * ParticleEffectManager::sColliderGrid = NULL;
+
+
+QSharedPointer<ParticleEffect> ParticleEffectManager::effect( GLWidget * glWidget, const QString & name )
+{
+	QSharedPointer<ParticleEffect> effect = sEffects.value( name ).toStrongRef();
+	if( !effect )
+	{
+		effect = QSharedPointer<ParticleEffect>( new ParticleEffect( glWidget, name ) );
+		sEffects.insert( name, effect.toWeakRef() );
+	}
+	return effect;
+}
+
+
+void ParticleEffectManager::update( const double & delta )
+{
+	if( sColliderGrid )
+		sColliderGrid->beginFrame();
+	int live = 0;
+	QMutableHashIterator< QString, QWeakPointer<ParticleEffect> > i( sEffects );
+	while( i.hasNext() )
+	{
+		QSharedPointer<ParticleEffect> effect = i.next().value().toStrongRef();
+		if( !effect )
+		{
+			i.remove();
+			continue;
+		}
+		if( !effect->idle() )
+			effect->update( delta, sColliderGrid );
+		live += effect->particleSystem()->alive();
+	}
+	EffectBudget::setLiveParticles( live );
+}
+
+
+void ParticleEffectManager::draw( int pass, const QMatrix4x4 & modelView )
+{
+	FrustumTest frustum;
+	bool synced = false;
+	QHash< QString, QWeakPointer<ParticleEffect> >::const_iterator i;
+	for( i = sEffects.constBegin(); i != sEffects.constEnd(); ++i )
+	{
+		QSharedPointer<ParticleEffect> effect = i.value().toStrongRef();
+		if( !effect || effect->pass() != pass || effect->idle() )
+			continue;
+		if( !synced )
+		{
+			frustum.sync();
+			synced = true;
+		}
+		effect->draw( modelView, frustum );
+	}
+}
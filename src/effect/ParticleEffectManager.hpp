@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EFFECT_PARTICLEEFFECTMANAGER_INCLUDED
+#define EFFECT_PARTICLEEFFECTMANAGER_INCLUDED
+
+#include "ParticleEffect.hpp"
+
+#include <QHash>
+#include <QString>
+#include <QSharedPointer>
+#include <QWeakPointer>
+
+
+/// Shares particle effects by name and updates and draws all of them once per frame
+/**
+ * All emitters of an effect share its particle systems, so their particles live in one pool of memory
+ * and are updated and drawn in one batch per effect.
+ * Effects are released when the last emitter drops its reference.
+ */
+class ParticleEffectManager
+{
+public:
+	/// Returns the shared effect with the given name, loading it if needed
+	static QSharedPointer<ParticleEffect> effect( GLWidget * glWidget, const QString & name );
+	/// Updates all effects with alive particles and collides them with the collider grid if set
+	static void update( const double & delta );
+	/// Draws all visible effects of a pass (1: with opaque objects, 2: with transparent objects) - expects the modelview matrix the particles are in
+	static void draw( int pass, const QMatrix4x4 & modelView );
+	/// Sets the static colliders particles collide with - may be NULL, the grid is not owned
+	static void setColliderGrid( ColliderGrid * colliderGrid ) { sColliderGrid = colliderGrid; }
+	static ColliderGrid * colliderGrid() { return sColliderGrid; }
+
+private:
+	ParticleEffectManager() {}
+	static QHash< QString, QWeakPointer<ParticleEffect> > sEffects;
+	static ColliderGrid * sColliderGrid;
+};
+
+
+#endif
@@ -22,41 +22,57 @@
  */
 
 #include "SplatterSystem.hpp"
+#include "ParticleEffectManager.hpp"
+#include "EffectBudget.hpp"
 
 #include <GLWidget.hpp>
 #include <geometry/Terrain.hpp>
+#include <scene/TextureRenderer.hpp>
+#include <scene/LightGrid.hpp>
 #include <utility/Interpolation.hpp>
 #include <utility/RandomNumber.hpp>
 #include <resource/Material.hpp>
+#include <resource/Shader.hpp>
 #include <resource/AudioSample.hpp>
 
+#include <QGLShaderProgram>
+#include <QDebug>
+
 #include <math.h>
 #include <float.h>
 
 
+bool SplatterSystem::sDecals = true;
+bool SplatterSystem::sAccumulation = false;
+
+
 SplatterSystem::SplatterSystem( GLWidget * glWidget, Terrain * terrain,
-		const QString & splatterMaterialName, const QString & particleMaterialName,
+		const QString & splatterMaterialName, const QString & particleEffectName,
 		const QString & burstAudioSampleName,
-		int maxSplatters, int maxParticles ) :
+		int maxSplatters ) :
 	mGLWidget( glWidget ),
 	mTerrain( terrain ),
 	mSplatters( maxSplatters )
 {
 	mSplatterMaterial = new Material( glWidget, splatterMaterialName );
-	mParticleMaterial = new Material( glWidget, particleMaterialName );
 
-	mParticleSystem = new ParticleSystem( maxParticles );
-	mParticleSystem->setSize( 4.0f );
-	mParticleSystem->setGravity( QVector3D( 0.0f, -120.0f, 0.0f ) );
-	mParticleSystem->setDrag( 0.25f );
-	mParticleSystem->setInteractionCallback( this );
+	mParticleEffect = ParticleEffectManager::effect( glWidget, particleEffectName );
+	if( mParticleEffect->particleSystem()->interactionCallback() )
+		qWarning() << "! Particle effect" << particleEffectName << "already used by another splatter system - taking over its interaction";
+	Q_ASSERT( !mParticleEffect->particleSystem()->interactionCallback() );
+	mParticleEffect->particleSystem()->setInteractionCallback( this );
+	if( mParticleEffect->gpuParticleSystem() )
+		mParticleEffect->gpuParticleSystem()->setTerrain( terrain );
 
+	mNextSplatter = 0;
 	mSplatBelow = true;
+	mSprayOnGPU = false;
 	mSplatterFadeSpeed = 0.3f;
 	mSplatterDriftFactor = 100.0f;
 
 	mBurstPitchRange = 0.3;
 
+	mNextBurstSampleSource = 0;
 	mBurstSampleSources.resize( 4 );
 	for( int i=0; i<mBurstSampleSources.size(); ++i )
 	{
@@ -64,37 +80,331 @@ SplatterSystem::SplatterSystem( GLWidget * glWidget, Terrain * terrain,
 		mBurstSampleSources[i]->setLooping( false );
 		mBurstSampleSources[i]->setRolloffFactor( 0.05f );
 	}
+
+	mAccumulationShader = NULL;
+	mAccumulationRenderer = NULL;
+	mAccumulationDecaySpeed = 0.01f;
+	mAccumulationDecay = 0.0f;
+	if( sAccumulation )
+	{
+		mAccumulationShader = new Shader( glWidget, "splatterAccumulate" );
+		if( !mAccumulationShader->constData()->loaded() )
+		{
+			qWarning() << "! Splatter accumulation shader not available - splatters will fade individually";
+			delete mAccumulationShader;
+			mAccumulationShader = NULL;
+		}
+	}
+
+	if( mAccumulationShader )
+	{
+		GLint maxTextureSize;
+		glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxTextureSize );
+		int maxSize = qMin( (int)maxTextureSize, maxAccumulationSize );
+		QSize size(
+			qMin( terrain->mapSize().width() * accumulationTexelsPerCell, maxSize ),
+			qMin( terrain->mapSize().height() * accumulationTexelsPerCell, maxSize ) );
+		mAccumulationRenderer = new TextureRenderer( glWidget, size, false );
+		mAccumulationRenderer->bind();
+		glPushAttrib( GL_COLOR_BUFFER_BIT );
+		glClearColor( 1.0f, 1.0f, 1.0f, 1.0f );
+		glClear( GL_COLOR_BUFFER_BIT );
+		glPopAttrib();
+		mAccumulationRenderer->release();
+		// splatters are only kept until they got rendered into the accumulation map
+		mSplatters.clear();
+		mNextSplatter = 0;
+	}
+
+	mDecalShader = NULL;
+	mDecalCubeBuffer = 0;
+	mDecalIndexBuffer = 0;
+	mDecalInstanceBuffer = 0;
+	mDepthTexture = 0;
+	mHeightMap = 0;
+	if( !mAccumulationRenderer && sDecals && GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced && GLEW_ARB_depth_texture )
+	{
+		mDecalShader = new Shader( glWidget, "splatterDecal" );
+		if( !mDecalShader->constData()->loaded() )
+		{
+			qWarning() << "! Splatter decal shader not available - splatters will redraw terrain patches";
+			delete mDecalShader;
+			mDecalShader = NULL;
+		}
+	}
+
+	if( mDecalShader )
+	{
+		// corners of the unit cube: bit 0 is x, bit 1 is y, bit 2 is z
+		GLfloat corners[8*3];
+		for( int i=0; i<8; ++i )
+		{
+			corners[i*3+0] = ( i & 1 ) ? 1.0f : 0.0f;
+			corners[i*3+1] = ( i & 2 ) ? 1.0f : 0.0f;
+			corners[i*3+2] = ( i & 4 ) ? 1.0f : 0.0f;
+		}
+		// counter-clockwise seen from outside - only the back faces get drawn, so the box also works with the eye inside
+		static const GLushort indices[] =
+		{
+			0, 4, 6,  0, 6, 2,	// -x
+			1, 3, 7,  1, 7, 5,	// +x
+			0, 1, 5,  0, 5, 4,	// -y
+			2, 6, 7,  2, 7, 3,	// +y
+			0, 2, 3,  0, 3, 1,	// -z
+			4, 5, 7,  4, 7, 6	// +z
+		};
+		glGenBuffers( 1, &mDecalCubeBuffer );
+		glBindBuffer( GL_ARRAY_BUFFER, mDecalCubeBuffer );
+		glBufferData( GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW );
+		glGenBuffers( 1, &mDecalIndexBuffer );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mDecalIndexBuffer );
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+		glGenBuffers( 1, &mDecalInstanceBuffer );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+		glGenTextures( 1, &mDepthTexture );
+		glBindTexture( GL_TEXTURE_2D, mDepthTexture );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_DEPTH_TEXTURE_MODE, GL_LUMINANCE );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+
+		mHeightMap = terrain->createHeightTexture();
+	}
+	else if( !mAccumulationRenderer && mSplatters.size() > maxPatchSplatters )
+	{
+		mSplatters.resize( maxPatchSplatters );
+	}
 }
 
 
 SplatterSystem::~SplatterSystem()
 {
-	delete mParticleSystem;
-	delete mParticleMaterial;
+	mParticleEffect->particleSystem()->setInteractionCallback( NULL );
 	delete mSplatterMaterial;
 	for( int i=0; i<mBurstSampleSources.size(); ++i )
 	{
 		delete mBurstSampleSources[i];
 	}
+	if( mDecalShader )
+	{
+		glDeleteBuffers( 1, &mDecalCubeBuffer );
+		glDeleteBuffers( 1, &mDecalIndexBuffer );
+		glDeleteBuffers( 1, &mDecalInstanceBuffer );
+		glDeleteTextures( 1, &mDepthTexture );
+		glDeleteTextures( 1, &mHeightMap );
+		delete mDecalShader;
+	}
+	delete mAccumulationRenderer;
+	delete mAccumulationShader;
+}
+
+
+GLuint SplatterSystem::accumulationMap() const
+{
+	return mAccumulationRenderer ? mAccumulationRenderer->texID() : 0;
 }
 
 
 void SplatterSystem::update( const double & delta )
 {
-	mParticleSystem->update( delta );
 	for( int i = 0; i < mSplatters.size(); ++i )
 	{
 		mSplatters[i].fade -= mSplatterFadeSpeed * delta;
 	}
+	if( mAccumulationRenderer )
+		updateAccumulation( delta );
+}
+
+
+void SplatterSystem::updateAccumulation( const double & delta )
+{
+	// the map has 8 bits per channel - smaller steps towards white would get lost, so they are collected
+	mAccumulationDecay += mAccumulationDecaySpeed * delta;
+	bool decay = mAccumulationDecay >= 1.0f/255.0f;
+	bool splat = !mPendingSplatters.isEmpty() && mSplatterMaterial->constData()->loaded();
+	if( !decay && !splat )
+		return;
+
+	const QSize & mapSize = mTerrain->mapSize();
+	mAccumulationRenderer->bind();
+	glPushAttrib( GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_CURRENT_BIT );
+	glMatrixMode( GL_PROJECTION );	glPushMatrix();	glLoadIdentity();
+	glOrtho( 0.0, mapSize.width(), 0.0, mapSize.height(), -1.0, 1.0 );
+	glMatrixMode( GL_MODELVIEW );	glPushMatrix();	glLoadIdentity();
+	glDisable( GL_DEPTH_TEST );
+	glDisable( GL_CULL_FACE );
+	glDisable( GL_LIGHTING );
+	glDisable( GL_TEXTURE_2D );
+	glEnable( GL_BLEND );
+
+	if( decay )
+	{
+		glBlendFunc( GL_ONE, GL_ONE );
+		glColor4f( mAccumulationDecay, mAccumulationDecay, mAccumulationDecay, 1.0f );
+		glBegin( GL_QUADS );
+			glVertex2f( 0.0f, 0.0f );
+			glVertex2f( mapSize.width(), 0.0f );
+			glVertex2f( mapSize.width(), mapSize.height() );
+			glVertex2f( 0.0f, mapSize.height() );
+		glEnd();
+		mAccumulationDecay = 0.0f;
+	}
+
+	if( splat )
+	{
+		static const QPointF texCoords[4] = { QPointF(0,0), QPointF(1,0), QPointF(1,1), QPointF(0,1) };
+		mSplatterMaterial->bind();
+		mAccumulationShader->bind();
+		mAccumulationShader->program()->setUniformValue( "diffuseMap", 0 );
+		glDisable( GL_DEPTH_TEST );
+		glDisable( GL_CULL_FACE );
+		glEnable( GL_BLEND );
+		glBlendFunc( GL_DST_COLOR, GL_ZERO );
+		const QVector4D & diffuse = mSplatterMaterial->constData()->diffuse();
+		glColor4f( diffuse.x(), diffuse.y(), diffuse.z(), diffuse.w() );
+		glBegin( GL_QUADS );
+		for( int i = 0; i < mPendingSplatters.size(); ++i )
+		{
+			QRectF mapRect = mTerrain->toMapF( mPendingSplatters[i].rect );
+			const int r = mPendingSplatters[i].rotation;
+			glTexCoord2f( texCoords[(r+0)%4].x(), texCoords[(r+0)%4].y() );	glVertex2f( mapRect.left(), mapRect.top() );
+			glTexCoord2f( texCoords[(r+1)%4].x(), texCoords[(r+1)%4].y() );	glVertex2f( mapRect.right(), mapRect.top() );
+			glTexCoord2f( texCoords[(r+2)%4].x(), texCoords[(r+2)%4].y() );	glVertex2f( mapRect.right(), mapRect.bottom() );
+			glTexCoord2f( texCoords[(r+3)%4].x(), texCoords[(r+3)%4].y() );	glVertex2f( mapRect.left(), mapRect.bottom() );
+		}
+		glEnd();
+		mAccumulationShader->release();
+		mSplatterMaterial->release();
+		mPendingSplatters.clear();
+	}
+
+	glMatrixMode( GL_PROJECTION );	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW );	glPopMatrix();
+	glPopAttrib();
+	mAccumulationRenderer->release();
+}
+
+
+void SplatterSystem::draw()
+{
+	if( mDecalShader )
+		drawDecals();
+	else if( !mAccumulationRenderer )
+		drawPatches();
 }
 
 
-void SplatterSystem::draw( const QMatrix4x4 & modelView )
+void SplatterSystem::drawDecals()
 {
-	mParticleMaterial->bind();
-	mParticleSystem->draw( modelView );
-	mParticleMaterial->release();
+	GLint viewport[4];
+	glGetIntegerv( GL_VIEWPORT, viewport );
 
+	// copy the scene's depth once, all decals reconstruct the terrain surface from it
+	glActiveTexture( GL_TEXTURE1 );
+	glBindTexture( GL_TEXTURE_2D, mDepthTexture );
+	QSize viewportSize( viewport[2], viewport[3] );
+	if( mDepthTextureSize != viewportSize )
+	{
+		mDepthTextureSize = viewportSize;
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, viewportSize.width(), viewportSize.height(), 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL );
+	}
+	glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewportSize.width(), viewportSize.height() );
+	glActiveTexture( GL_TEXTURE2 );
+	glBindTexture( GL_TEXTURE_2D, mHeightMap );
+	glActiveTexture( GL_TEXTURE0 );
+
+	// orphan the previous frame's storage, so the driver does not need to wait until it was drawn
+	glBindBuffer( GL_ARRAY_BUFFER, mDecalInstanceBuffer );
+	glBufferData( GL_ARRAY_BUFFER, mSplatters.size()*decalFloats*sizeof(GLfloat), NULL, GL_STREAM_DRAW );
+	GLfloat * instance = reinterpret_cast<GLfloat*>( glMapBuffer( GL_ARRAY_BUFFER, GL_WRITE_ONLY ) );
+	if( !instance )
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		return;
+	}
+	int instances = 0;
+	for( int i = 0; i < mSplatters.size(); ++i )
+	{
+		const Splatter & splatter = mSplatters[i];
+		if( splatter.fade <= 0.0f )
+			continue;
+		*instance++ = splatter.rect.x();
+		*instance++ = splatter.rect.y();
+		*instance++ = splatter.rect.width();
+		*instance++ = splatter.rect.height();
+		*instance++ = splatter.bottom;
+		*instance++ = splatter.height;
+		*instance++ = splatter.rotation;
+		*instance++ = splatter.fade;
+		instances++;
+	}
+	glUnmapBuffer( GL_ARRAY_BUFFER );
+	if( !instances )
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		return;
+	}
+
+	mSplatterMaterial->bind();
+	mDecalShader->bind();
+	QGLShaderProgram * program = mDecalShader->program();
+	program->setUniformValue( "diffuseMap", 0 );
+	program->setUniformValue( "depthMap", 1 );
+	program->setUniformValue( "heightMap", 2 );
+	program->setUniformValue( "viewport", QVector4D( viewport[0], viewport[1], viewport[2], viewport[3] ) );
+	program->setUniformValue( "terrainOffset", mTerrain->offset() );
+	program->setUniformValue( "terrainSize", mTerrain->size() );
+	program->setUniformValue( "heightMapSize", QSizeF( mTerrain->mapSize() ) );
+	// the height map is interpolated bilinearly, the terrain's triangles are not - allow about one cell of slope
+	program->setUniformValue( "heightTolerance", (GLfloat)qMax(
+		mTerrain->size().x() / mTerrain->mapSize().width(),
+		mTerrain->size().z() / mTerrain->mapSize().height() ) );
+	program->setUniformValue( "driftFactor", mSplatterDriftFactor );
+	LightGrid::bindCurrent( program, 3 );
+
+	int rectAttribute = program->attributeLocation( "decalRect" );
+	int paramsAttribute = program->attributeLocation( "decalParams" );
+	glVertexAttribPointer( rectAttribute, 4, GL_FLOAT, GL_FALSE, decalFloats*sizeof(GLfloat), (void*)0 );
+	glVertexAttribPointer( paramsAttribute, 4, GL_FLOAT, GL_FALSE, decalFloats*sizeof(GLfloat), (void*)(4*sizeof(GLfloat)) );
+	glVertexAttribDivisorARB( rectAttribute, 1 );
+	glVertexAttribDivisorARB( paramsAttribute, 1 );
+	glEnableVertexAttribArray( rectAttribute );
+	glEnableVertexAttribArray( paramsAttribute );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mDecalCubeBuffer );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, (void*)0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mDecalIndexBuffer );
+
+	// the material's enable bits get restored on release
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_DST_COLOR, GL_ZERO );
+	glDisable( GL_DEPTH_TEST );
+	glEnable( GL_CULL_FACE );
+	glCullFace( GL_FRONT );
+
+	glDrawElementsInstancedARB( GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, (void*)0, instances );
+
+	glCullFace( GL_BACK );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glDisableVertexAttribArray( paramsAttribute );
+	glDisableVertexAttribArray( rectAttribute );
+	glVertexAttribDivisorARB( paramsAttribute, 0 );
+	glVertexAttribDivisorARB( rectAttribute, 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	mDecalShader->release();
+	mSplatterMaterial->release();
+}
+
+
+void SplatterSystem::drawPatches()
+{
 	mSplatterMaterial->bind();
 	glEnable( GL_BLEND );
 	glBlendFunc( GL_DST_COLOR, GL_ZERO );
@@ -143,54 +453,74 @@ void SplatterSystem::spray( const QVector3D & source, float size )
 	if( size > 100.0f ) size = 100.0f;
 	int numToEmit = 0.5f * size;
 	if( numToEmit < 1 ) numToEmit = 1;
-	mParticleSystem->emitSpherical( source, numToEmit, 0.25f*size, 1.0f*size );
+	int emitted = mParticleEffect->emitSpherical( source, numToEmit, 0.25f*size, 1.0f*size, QVector3D(0,0,0), mSprayOnGPU );
 
 	if( mSplatBelow && mTerrain->getHeightAboveGround( source ) < size*0.5f )
-		splat( source, size * RandomNumber::minMax( 0.2f, 0.3f ) );
-
-	int maxSecOffset = 0;
-	for( int i=0; i<mBurstSampleSources.size(); ++i )
 	{
-		if( !mBurstSampleSources[i]->isPlaying() )
-		{
-			maxSecOffset = i;
-			break;
-		}
-		if( mBurstSampleSources[i]->secOffset() > mBurstSampleSources[maxSecOffset]->secOffset() )
-		{
-			maxSecOffset = i;
-		}
+		// a downgraded spray leaves a larger splatter to make up for the missing particles
+		float scale = qMin( sqrtf( (float)numToEmit / qMax( emitted, 1 ) ), 2.0f );
+		splat( source, scale * size * RandomNumber::minMax( 0.2f, 0.3f ) );
 	}
-	mBurstSampleSources[maxSecOffset]->setPosition( source );
-	mBurstSampleSources[maxSecOffset]->rewind();
-	mBurstSampleSources[maxSecOffset]->setPitch( RandomNumber::minMax( 1.0f-mBurstPitchRange*0.5, 1.0+mBurstPitchRange*0.5 ) );
-	mBurstSampleSources[maxSecOffset]->play();
+
+	// sources are used round-robin - the next one is the one started longest ago
+	AudioSample * burst = mBurstSampleSources[mNextBurstSampleSource];
+	mNextBurstSampleSource = ( mNextBurstSampleSource + 1 ) % mBurstSampleSources.size();
+	burst->setPosition( source );
+	burst->rewind();
+	burst->setPitch( RandomNumber::minMax( 1.0f-mBurstPitchRange*0.5, 1.0+mBurstPitchRange*0.5 ) );
+	burst->play();
 }
 
 
 void SplatterSystem::splat( const QVector3D & source, float size )
 {
-	int minFadeSplatter = 0;
-	for( int i = 0; i < mSplatters.size(); ++i )
+	if( !EffectBudget::grantSplatters( source, 1 ) )
+		return;
+
+	if( mAccumulationRenderer )
 	{
-		if( mSplatters[i].fade <= 0.0f )
-		{
-			minFadeSplatter = i;
-			break;
-		}
-		if( mSplatters[i].fade < mSplatters[minFadeSplatter].fade )
+		mPendingSplatters.append( Splatter( QRectF( source.x()-size*0.5f, source.z()-size*0.5f, size, size ) ) );
+		return;
+	}
+
+	// all splatters fade at the same speed, so the ring's next splatter is the oldest and the most faded one
+	Splatter & splatter = mSplatters[mNextSplatter];
+	mNextSplatter = ( mNextSplatter + 1 ) % mSplatters.size();
+	splatter.fade = 1.0f;
+	splatter.rect = QRectF( source.x()-size*0.5f, source.z()-size*0.5f, size, size );
+
+	// the decal box spans the terrain heights below the splatter with some margin
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	for( int z = 0; z < 3; ++z )
+	{
+		for( int x = 0; x < 3; ++x )
 		{
-			minFadeSplatter = i;
+			float height = mTerrain->getHeight( QPointF(
+				splatter.rect.x() + splatter.rect.width()*0.5f*x,
+				splatter.rect.y() + splatter.rect.height()*0.5f*z ) );
+			minY = qMin( minY, height );
+			maxY = qMax( maxY, height );
 		}
 	}
-	mSplatters[minFadeSplatter].fade = 1.0f;
-	mSplatters[minFadeSplatter].rect = QRectF( source.x()-size*0.5f, source.z()-size*0.5f, size, size );
+	const float margin = size * 0.5f;
+	splatter.bottom = minY - margin;
+	splatter.height = maxY - minY + 2.0f * margin;
 }
 
 
-void SplatterSystem::particleInteraction( const double & delta, ParticleSystem::Particle & particle )
+void SplatterSystem::setInteractionCallback( ParticleSystem::Interactable * callback )
 {
-	if( mTerrain->getHeightAboveGround( particle.position() ) > -particleSystem()->size()/2.0f )
-		return;
-	particle.setLife( 0.0f );
+	mParticleEffect->particleSystem()->setInteractionCallback( callback ? callback : this );
+}
+
+
+void SplatterSystem::particleInteraction( const double & delta, ParticleSystem::Span & particles )
+{
+	const float halfSize = particleSystem()->size()/2.0f;
+	for( int i = 0; i < particles.size(); ++i )
+	{
+		if( mTerrain->getHeightAboveGround( particles.position( i ) ) <= -halfSize )
+			particles.kill( i );
+	}
 }
@@ -25,16 +25,21 @@
 #define EFFECT_SPLATTERSYSTEM_INCLUDED
 
 #include <GLWidget.hpp>
+#include "ParticleEffect.hpp"
 #include <geometry/ParticleSystem.hpp>
+#include <geometry/GPUParticleSystem.hpp>
 
 #include <QVector>
+#include <QSharedPointer>
 #include <QVector2D>
 #include <QVector3D>
 
 
 class AudioSample;
 class Material;
+class Shader;
 class Terrain;
+class TextureRenderer;
 
 
 /// Simulates splatter on a terrain
@@ -42,24 +47,29 @@ class SplatterSystem : ParticleSystem::Interactable
 {
 public:
 	SplatterSystem( GLWidget * glWidget, Terrain * terrain,
-		const QString & splatterMaterialName, const QString & particleMaterialName,
+		const QString & splatterMaterialName, const QString & particleEffectName,
 		const QString & burstAudioSampleName,
-		int maxSplatters = 200, int maxParticles = 500 );
+		int maxSplatters = 2048 );
 	virtual ~SplatterSystem();
 	void update( const double & delta );
-	void draw( const QMatrix4x4 & modelView );
+	/// Draws the splatters - sprayed particles are drawn by the ParticleEffectManager
+	void draw();
 	void spray( const QVector3D & source, float size );
 	void splat( const QVector3D & source, float size );
 
 	Material * splatterMaterial() { return mSplatterMaterial; }
 	void setSplatterMaterial( Material * splatterMaterial ) { mSplatterMaterial = splatterMaterial; }
 
-	Material * particleMaterial() { return mParticleMaterial; }
-	void setParticleMaterial( Material * particleMaterial ) { mParticleMaterial = particleMaterial; }
+	/// The shared effect sprayed particles are emitted into - updated and drawn by the ParticleEffectManager
+	const QSharedPointer<ParticleEffect> & particleEffect() const { return mParticleEffect; }
 
 	const bool & splatBelow() const { return mSplatBelow; }
 	void setSplatBelow( const bool & enable ) { mSplatBelow = enable; }
 
+	/// Emits sprayed particles into the GPU particle system if available - particles simulated on the GPU never call the interaction callback
+	const bool & sprayOnGPU() const { return mSprayOnGPU; }
+	void setSprayOnGPU( const bool & enable ) { mSprayOnGPU = enable; }
+
 	const float & splatterFadeSpeed() const { return mSplatterFadeSpeed; }
 	void setSplatterFadeSpeed( const float & speed ) { mSplatterFadeSpeed = speed; }
 
@@ -69,33 +79,95 @@ public:
 	const float & burstPitchRange() const { return mBurstPitchRange; }
 	void setBurstPitchRange( const float & range ) { mBurstPitchRange = range; }
 
-	ParticleSystem * particleSystem() const { return mParticleSystem; }
+	/// Returns true if splatters are drawn as projected decals, false if they redraw terrain patches
+	bool drawsDecals() const { return mDecalShader != NULL; }
+
+	/// Returns the accumulation map in heightmap space or 0 if splatters are not accumulated
+	/**
+	 * Its color is a factor for the terrain's color, splatters only get rendered into it once.
+	 */
+	GLuint accumulationMap() const;
+
+	/// Accumulated splatters fade to white by this amount per second
+	const float & accumulationDecaySpeed() const { return mAccumulationDecaySpeed; }
+	void setAccumulationDecaySpeed( const float & speed ) { mAccumulationDecaySpeed = speed; }
+
+	ParticleSystem * particleSystem() const { return mParticleEffect->particleSystem(); }
+	/// Replaces the splatter particles' interaction - NULL restores the splatter system's own
+	/**
+	 * The splatter effect is shared, so it has a single interaction callback owned by the splatter system.
+	 * The callback is cleared when the splatter system is destroyed.
+	 */
+	void setInteractionCallback( ParticleSystem::Interactable * callback );
+	/// Returns the particle system simulated on the GPU or NULL if not supported
+	GPUParticleSystem * gpuParticleSystem() const { return mParticleEffect->gpuParticleSystem(); }
 
 	// Overrides:
-	virtual void particleInteraction( const double & delta, ParticleSystem::Particle & particle );
+	virtual void particleInteraction( const double & delta, ParticleSystem::Span & particles );
+
+	/// Returns true if splatters should be projected onto the depth buffer instead of redrawing terrain patches
+	static const bool & decals() { return sDecals; }
+	/// Enables projected splatter decals - takes effect for splatter systems created afterwards
+	static void setDecals( const bool & enable ) { sDecals = enable; }
+
+	/// Returns true if splatters should be accumulated in a map sampled by the terrain
+	static const bool & accumulation() { return sAccumulation; }
+	/// Enables accumulating splatters - takes effect for splatter systems created afterwards
+	static void setAccumulation( const bool & enable ) { sAccumulation = enable; }
 
 protected:
 
 private:
+	static const int maxPatchSplatters = 200;	///< Each splatter redraws its terrain patch, so the fallback is limited to fewer splatters
+	static const int decalFloats = 8;		///< Per instance: rect x, z, width, depth and box bottom, box height, rotation, fade
+	static const int accumulationTexelsPerCell = 4;	///< Resolution of the accumulation map relative to the heightmap
+	static const int maxAccumulationSize = 2048;
+
 	class Splatter
 	{
 	public:
-		Splatter( const QRectF & _rect = QRectF(0,0,0,0) ) : rect(_rect), fade(0.0f), rotation(rand()%4) {}
+		Splatter( const QRectF & _rect = QRectF(0,0,0,0) ) : rect(_rect), bottom(0.0f), height(0.0f), fade(0.0f), rotation(rand()%4) {}
 		QRectF rect;
+		float bottom;
+		float height;
 		float fade;
 		int rotation;
 	};
+
+	void drawDecals();
+	void drawPatches();
+	void updateAccumulation( const double & delta );
+
+	static bool sDecals;
+	static bool sAccumulation;
+
 	GLWidget * mGLWidget;
 	Terrain * mTerrain;
 	QVector< Splatter > mSplatters;
-	ParticleSystem * mParticleSystem;
+	int mNextSplatter;
+	QSharedPointer<ParticleEffect> mParticleEffect;
 	Material * mSplatterMaterial;
-	Material * mParticleMaterial;
 	float mSplatterFadeSpeed;
 	float mSplatterDriftFactor;
 	float mBurstPitchRange;
 	bool mSplatBelow;
+	bool mSprayOnGPU;
 	QVector< AudioSample * > mBurstSampleSources;
+	int mNextBurstSampleSource;
+
+	Shader * mDecalShader;
+	GLuint mDecalCubeBuffer;
+	GLuint mDecalIndexBuffer;
+	GLuint mDecalInstanceBuffer;
+	GLuint mDepthTexture;
+	QSize mDepthTextureSize;
+	GLuint mHeightMap;
+
+	Shader * mAccumulationShader;
+	TextureRenderer * mAccumulationRenderer;
+	QVector< Splatter > mPendingSplatters;
+	float mAccumulationDecaySpeed;
+	float mAccumulationDecay;
 };
 
 
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ColliderGrid.hpp"
+
+#include <utility/Sphere.hpp>
+#include <utility/Capsule.hpp>
+
+
+
+int ColliderGrid::sBudget = 2048;
+
+
+ColliderGrid::ColliderGrid( const QRectF & area, const float & cellSize ) :
+	mArea( area ),
+	mCellSize( cellSize )
+{
+	mCells = QSize( qMax( 1, (int)ceilf( area.width() / cellSize ) ), qMax( 1, (int)ceilf( area.height() / cellSize ) ) );
+	mCellStart.fill( 0, mCells.width()*mCells.height()+1 );
+	mRemainingBudget = sBudget;
+	mCursor = 0;
+}
+
+
+void ColliderGrid::addSphere( const QVector3D & center, const float & radius )
+{
+	Collider collider;
+	collider.start = center;
+	collider.end = center;
+	collider.radius = radius;
+	collider.capsule = false;
+	mColliders.append( collider );
+}
+
+
+void ColliderGrid::addCapsule( const QVector3D & start, const QVector3D & end, const float & radius )
+{
+	Collider collider;
+	collider.start = start;
+	collider.end = end;
+	collider.radius = radius;
+	collider.capsule = true;
+	mColliders.append( collider );
+}
+
+
+void ColliderGrid::build()
+{
+	// count the colliders per cell, then fill the cells in a second pass
+	QVector<int> count( mCells.width()*mCells.height(), 0 );
+	for( int pass = 0; pass < 2; ++pass )
+	{
+		for( int c = 0; c < mColliders.size(); ++c )
+		{
+			const Collider & collider = mColliders[c];
+			int fromX = qMax( 0, cellX( qMin( collider.start.x(), collider.end.x() ) - collider.radius ) );
+			int toX = qMin( mCells.width()-1, cellX( qMax( collider.start.x(), collider.end.x() ) + collider.radius ) );
+			int fromZ = qMax( 0, cellZ( qMin( collider.start.z(), collider.end.z() ) - collider.radius ) );
+			int toZ = qMin( mCells.height()-1, cellZ( qMax( collider.start.z(), collider.end.z() ) + collider.radius ) );
+			for( int z = fromZ; z <= toZ; ++z )
+			{
+				for( int x = fromX; x <= toX; ++x )
+				{
+					int cell = z*mCells.width()+x;
+					if( pass == 0 )
+						count[cell]++;
+					else
+						mCellColliders[mCellStart[cell]+count[cell]++] = c;
+				}
+			}
+		}
+		if( pass == 0 )
+		{
+			for( int cell = 0; cell < count.size(); ++cell )
+			{
+				mCellStart[cell+1] = mCellStart[cell] + count[cell];
+				count[cell] = 0;
+			}
+			mCellColliders.resize( mCellStart.last() );
+		}
+	}
+}
+
+
+int ColliderGrid::collide( ParticleSystem::Span & particles, const float & particleRadius, Response response, const float & bounce )
+{
+	int tests = qMin( particles.size(), mRemainingBudget );
+	if( tests <= 0 || mCellColliders.isEmpty() )
+		return 0;
+	mRemainingBudget -= tests;
+	int first = mCursor % particles.size();
+	mCursor = ( mCursor + tests ) % ( 1 << 30 );
+
+	int collisions = 0;
+	for( int n = 0; n < tests; ++n )
+	{
+		int i = ( first + n ) % particles.size();
+		// colliders are only expanded by their own radius, so test every cell the particle overlaps
+		int fromX = qMax( 0, cellX( particles.positionX[i] - particleRadius ) );
+		int toX = qMin( mCells.width()-1, cellX( particles.positionX[i] + particleRadius ) );
+		int fromZ = qMax( 0, cellZ( particles.positionZ[i] - particleRadius ) );
+		int toZ = qMin( mCells.height()-1, cellZ( particles.positionZ[i] + particleRadius ) );
+		if( fromX > toX || fromZ > toZ )
+			continue;
+
+		QVector3D position = particles.position( i );
+		QVector3D velocity = particles.velocity( i );
+		bool collided = false;
+		for( int z = fromZ; z <= toZ; ++z )
+		{
+			for( int x = fromX; x <= toX; ++x )
+			{
+				if( collideCell( z*mCells.width()+x, position, velocity, particleRadius, response, bounce ) )
+					collided = true;
+			}
+		}
+		if( collided )
+		{
+			particles.setPosition( i, position );
+			particles.setVelocity( i, velocity );
+			++collisions;
+		}
+	}
+	return collisions;
+}
+
+
+bool ColliderGrid::collideCell( int cell, QVector3D & position, QVector3D & velocity, const float & particleRadius, Response response, const float & bounce ) const
+{
+	bool collided = false;
+	for( int c = mCellStart[cell]; c < mCellStart[cell+1]; ++c )
+	{
+		const Collider & collider = mColliders[mCellColliders[c]];
+		QVector3D normal( 0.0f, 1.0f, 0.0f );
+		float depth;
+		bool hit = collider.capsule ?
+			Capsule::intersectSphere( collider.start, collider.end, collider.radius, position, particleRadius, &normal, &depth ) :
+			Sphere::intersectSphere( collider.start, collider.radius, position, particleRadius, &normal, &depth );
+		if( !hit )
+			continue;
+		position += normal * depth;
+		if( response == STICK )
+		{
+			velocity = QVector3D( 0.0f, 0.0f, 0.0f );
+		}
+		else
+		{
+			float normalVelocity = QVector3D::dotProduct( velocity, normal );
+			if( normalVelocity < 0.0f )
+				velocity -= ( 1.0f + bounce ) * normalVelocity * normal;
+		}
+		collided = true;
+	}
+	return collided;
+}
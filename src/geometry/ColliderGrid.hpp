@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOMETRY_COLLIDERGRID_INCLUDED
+#define GEOMETRY_COLLIDERGRID_INCLUDED
+
+#include "ParticleSystem.hpp"
+
+#include <QVector>
+#include <QVector3D>
+#include <QRectF>
+#include <QSize>
+
+#include <math.h>
+
+
+/// Coarse grid of static colliders for batched particle collision
+/**
+ * Spheres and capsules are sorted into square cells on the XZ plane once by build(),
+ * so each particle is only tested against the colliders of the cells it overlaps.\n
+ * A budget limits the number of particles tested per frame.
+ * If more particles are alive, consecutive frames test different ones.
+ */
+class ColliderGrid
+{
+public:
+	/// What happens to colliding particles - both get pushed out of the collider
+	enum Response
+	{
+		BOUNCE,	///< Reflects the velocity along the surface normal, scaled by the bounce factor
+		STICK	///< Stops the particle on the surface
+	};
+
+	ColliderGrid( const QRectF & area, const float & cellSize );
+
+	void addSphere( const QVector3D & center, const float & radius );
+	void addCapsule( const QVector3D & start, const QVector3D & end, const float & radius );
+	/// Sorts all colliders into the cells - call after adding colliders
+	void build();
+
+	/// Resets the budget - call once per frame before colliding
+	void beginFrame() { mRemainingBudget = sBudget; }
+	/// Collides particles with the colliders as far as the budget allows and returns the number of collisions
+	int collide( ParticleSystem::Span & particles, const float & particleRadius, Response response, const float & bounce = 0.5f );
+
+	int colliders() const { return mColliders.size(); }
+
+	/// Maximum number of particles tested per frame
+	static const int & budget() { return sBudget; }
+	static void setBudget( const int & budget ) { sBudget = budget; }
+
+private:
+	struct Collider
+	{
+		QVector3D start;
+		QVector3D end;
+		float radius;
+		bool capsule;
+	};
+
+	QRectF mArea;
+	float mCellSize;
+	QSize mCells;
+	QVector<Collider> mColliders;
+	QVector<int> mCellStart;	///< Index of each cell's first entry in mCellColliders, one more for the end
+	QVector<int> mCellColliders;
+	int mRemainingBudget;
+	int mCursor;
+
+	int cellX( const float & x ) const { return (int)floorf( ( x - mArea.left() ) / mCellSize ); }
+	int cellZ( const float & z ) const { return (int)floorf( ( z - mArea.top() ) / mCellSize ); }
+	/// Pushes a particle out of the colliders of a cell and returns true if it hit any
+	bool collideCell( int cell, QVector3D & position, QVector3D & velocity, const float & particleRadius, Response response, const float & bounce ) const;
+
+	static int sBudget;
+};
+
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GPUParticleSystem.hpp"
+#include "ParticleSystem.hpp"
+#include "Terrain.hpp"
+
+#include <resource/Shader.hpp>
+
+#include <QGLShaderProgram>
+#include <QVector2D>
+#include <QVector4D>
+#include <QDebug>
+
+#include <math.h>
+
+
+bool GPUParticleSystem::sEnabled = true;
+
+// per particle: position xyz, size, rotation, life, velocity xyz
+static const int stateFloats = 9;
+
+
+GPUParticleSystem::GPUParticleSystem( GLWidget * glWidget, int capacity ) :
+	mGLWidget( glWidget ),
+	mCapacity( capacity )
+{
+	mMinLife = 1.0f;
+	mMaxLife = 2.0f;
+	mDrag = 1.0f;
+	mSize = 1.0f;
+	mGravity = QVector3D( 0.0f, -9.81f, 0.0f );
+	mWaterHeight = -1e10f;
+	mBuoyancy = 0.0f;
+	mEmitCursor = 0;
+	mTime = 0.0f;
+	mQuietTime = 1e10f;	// nothing emitted yet
+	mBoundsRadius = 0.0f;
+	mCurrentState = 0;
+	mHeightMap = 0;
+
+	mUpdateProgram = new QGLShaderProgram( glWidget );
+	mUpdateProgram->addShaderFromSourceFile( QGLShader::Vertex, ShaderData::baseDirectory()+"particleUpdate.vert" );
+	// generic attribute 0 has to be used, or nothing is drawn
+	mUpdateProgram->bindAttributeLocation( "inPosition", 0 );
+	static const char * varyings[] = { "outPosition", "outParams", "outVelocity" };
+	glTransformFeedbackVaryingsEXT( mUpdateProgram->programId(), 3, varyings, GL_INTERLEAVED_ATTRIBS_EXT );
+	if( !mUpdateProgram->link() )
+		qWarning() << "!" << this << "GPUParticleSystem" << mUpdateProgram->log();
+
+	QVector<GLfloat> state( mCapacity*stateFloats, 0.0f );
+	glGenBuffers( 2, mStateBuffers );
+	for( int i = 0; i < 2; ++i )
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, mStateBuffers[i] );
+		glBufferData( GL_ARRAY_BUFFER, state.size()*sizeof(GLfloat), state.constData(), GL_DYNAMIC_COPY );
+	}
+
+	QVector<GLfloat> indices( mCapacity );
+	for( int i = 0; i < mCapacity; ++i )
+		indices[i] = i;
+	glGenBuffers( 1, &mIndexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mIndexBuffer );
+	glBufferData( GL_ARRAY_BUFFER, indices.size()*sizeof(GLfloat), indices.constData(), GL_STATIC_DRAW );
+
+	// corner x, corner y, corner index - see ParticleSystem::drawExpanded()
+	static const GLfloat corners[] =
+	{
+		-1.0f, -1.0f, 0.0f,
+		 1.0f, -1.0f, 1.0f,
+		 1.0f,  1.0f, 2.0f,
+		-1.0f,  1.0f, 3.0f
+	};
+	glGenBuffers( 1, &mCornerBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mCornerBuffer );
+	glBufferData( GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+
+GPUParticleSystem::~GPUParticleSystem()
+{
+	if( mHeightMap )
+		glDeleteTextures( 1, &mHeightMap );
+	glDeleteBuffers( 1, &mCornerBuffer );
+	glDeleteBuffers( 1, &mIndexBuffer );
+	glDeleteBuffers( 2, mStateBuffers );
+	delete mUpdateProgram;
+}
+
+
+bool GPUParticleSystem::supported()
+{
+	return sEnabled && GLEW_EXT_transform_feedback && ParticleSystem::gpuExpansion();
+}
+
+
+void GPUParticleSystem::setTerrain( const Terrain * terrain )
+{
+	if( mHeightMap )
+	{
+		glDeleteTextures( 1, &mHeightMap );
+		mHeightMap = 0;
+	}
+	if( !terrain )
+		return;
+
+	mTerrainOffset = terrain->offset();
+	mTerrainSize = terrain->size();
+	mHeightMapSize = terrain->mapSize();
+	mHeightMap = terrain->createHeightTexture();
+}
+
+
+void GPUParticleSystem::emitSpherical( const QVector3D & source, int toEmit, const float & minVel, const float & maxVel, const QVector3D & velOffset )
+{
+	if( toEmit <= 0 )
+		return;
+
+	// particles are never read back, so the bounds cover the farthest distance they can travel in their life
+	float reach = ( maxVel + velOffset.length() ) * mMaxLife + 0.5f * mGravity.length() * mMaxLife * mMaxLife + mSize;
+	if( idle() )
+	{
+		mBoundsCenter = source;
+		mBoundsRadius = reach;
+	}
+	else
+	{
+		float distance = ( source - mBoundsCenter ).length();
+		if( distance + mBoundsRadius <= reach )
+		{
+			mBoundsCenter = source;
+			mBoundsRadius = reach;
+		}
+		else if( distance + reach > mBoundsRadius )
+		{
+			float radius = ( distance + mBoundsRadius + reach ) / 2.0f;
+			mBoundsCenter += ( source - mBoundsCenter ) * ( ( radius - mBoundsRadius ) / distance );
+			mBoundsRadius = radius;
+		}
+	}
+
+	Emit emit;
+	emit.source = source;
+	emit.velocityOffset = velOffset;
+	emit.minVelocity = minVel;
+	emit.maxVelocity = maxVel;
+	emit.first = mEmitCursor;
+	emit.count = qMin( toEmit, mCapacity );
+	mEmits.append( emit );
+	mEmitCursor = ( mEmitCursor + emit.count ) % mCapacity;
+}
+
+
+void GPUParticleSystem::update( const double & delta )
+{
+	mTime += delta;
+	int emits = qMin( mEmits.size(), maxEmitsPerUpdate );
+	if( emits )
+		mQuietTime = 0.0f;
+	else
+		mQuietTime += delta;
+	if( mQuietTime > mMaxLife )
+		return;	// all particles are dead
+
+	QVector4D emitSource[maxEmitsPerUpdate];
+	QVector4D emitVelocity[maxEmitsPerUpdate];
+	QVector2D emitSpeed[maxEmitsPerUpdate];
+	for( int i = 0; i < emits; ++i )
+	{
+		emitSource[i] = QVector4D( mEmits[i].source, mEmits[i].first );
+		emitVelocity[i] = QVector4D( mEmits[i].velocityOffset, mEmits[i].count );
+		emitSpeed[i] = QVector2D( mEmits[i].minVelocity, mEmits[i].maxVelocity );
+	}
+	mEmits.remove( 0, emits );
+
+	mUpdateProgram->bind();
+	mUpdateProgram->setUniformValue( "delta", (GLfloat)delta );
+	mUpdateProgram->setUniformValue( "time", (GLfloat)fmod( mTime, 1000.0f ) );
+	mUpdateProgram->setUniformValue( "capacity", (GLfloat)mCapacity );
+	mUpdateProgram->setUniformValue( "size", mSize );
+	mUpdateProgram->setUniformValue( "life", QVector2D( mMinLife, mMaxLife ) );
+	mUpdateProgram->setUniformValue( "dragFactor", (GLfloat)pow( mDrag, delta ) );
+	mUpdateProgram->setUniformValue( "gravity", mGravity );
+	mUpdateProgram->setUniformValue( "waterHeight", mWaterHeight );
+	mUpdateProgram->setUniformValue( "buoyancy", mBuoyancy );
+	mUpdateProgram->setUniformValue( "terrainEnabled", (GLint)( mHeightMap != 0 ) );
+	mUpdateProgram->setUniformValue( "heightMap", 0 );
+	mUpdateProgram->setUniformValue( "terrainOffset", mTerrainOffset );
+	mUpdateProgram->setUniformValue( "terrainSize", mTerrainSize );
+	mUpdateProgram->setUniformValue( "heightMapSize", QSizeF( mHeightMapSize ) );
+	mUpdateProgram->setUniformValue( "emitCount", emits );
+	mUpdateProgram->setUniformValueArray( "emitSource", emitSource, maxEmitsPerUpdate );
+	mUpdateProgram->setUniformValueArray( "emitVelocity", emitVelocity, maxEmitsPerUpdate );
+	mUpdateProgram->setUniformValueArray( "emitSpeed", emitSpeed, maxEmitsPerUpdate );
+	glActiveTexture( GL_TEXTURE0 );
+	glBindTexture( GL_TEXTURE_2D, mHeightMap );
+
+	int position = 0;
+	int params = mUpdateProgram->attributeLocation( "inParams" );
+	int velocity = mUpdateProgram->attributeLocation( "inVelocity" );
+	int index = mUpdateProgram->attributeLocation( "inIndex" );
+	glBindBuffer( GL_ARRAY_BUFFER, mStateBuffers[mCurrentState] );
+	glVertexAttribPointer( position, 4, GL_FLOAT, GL_FALSE, stateFloats*sizeof(GLfloat), (void*)0 );
+	glVertexAttribPointer( params, 2, GL_FLOAT, GL_FALSE, stateFloats*sizeof(GLfloat), (void*)(4*sizeof(GLfloat)) );
+	glVertexAttribPointer( velocity, 3, GL_FLOAT, GL_FALSE, stateFloats*sizeof(GLfloat), (void*)(6*sizeof(GLfloat)) );
+	glBindBuffer( GL_ARRAY_BUFFER, mIndexBuffer );
+	glVertexAttribPointer( index, 1, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+	glEnableVertexAttribArray( position );
+	glEnableVertexAttribArray( params );
+	glEnableVertexAttribArray( velocity );
+	glEnableVertexAttribArray( index );
+
+	glEnable( GL_RASTERIZER_DISCARD_EXT );
+	glBindBufferBaseEXT( GL_TRANSFORM_FEEDBACK_BUFFER_EXT, 0, mStateBuffers[1-mCurrentState] );
+	glBeginTransformFeedbackEXT( GL_POINTS );
+	glDrawArrays( GL_POINTS, 0, mCapacity );
+	glEndTransformFeedbackEXT();
+	glBindBufferBaseEXT( GL_TRANSFORM_FEEDBACK_BUFFER_EXT, 0, 0 );
+	glDisable( GL_RASTERIZER_DISCARD_EXT );
+
+	glDisableVertexAttribArray( index );
+	glDisableVertexAttribArray( velocity );
+	glDisableVertexAttribArray( params );
+	glDisableVertexAttribArray( position );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	mUpdateProgram->release();
+
+	mCurrentState = 1-mCurrentState;
+}
+
+
+void GPUParticleSystem::draw()
+{
+	if( mQuietTime > mMaxLife )
+		return;
+
+	GLint program = 0;
+	glGetIntegerv( GL_CURRENT_PROGRAM, &program );
+	if( !program )
+		return;
+	GLint positionAttribute = glGetAttribLocation( program, "particlePosition" );
+	GLint paramsAttribute = glGetAttribLocation( program, "particleParams" );
+	if( positionAttribute < 0 || paramsAttribute < 0 )
+		return;
+	ParticleSystem::bindSceneDepth( program );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mStateBuffers[mCurrentState] );
+	glVertexAttribPointer( positionAttribute, 4, GL_FLOAT, GL_FALSE, stateFloats*sizeof(GLfloat), (void*)0 );
+	glVertexAttribPointer( paramsAttribute, 2, GL_FLOAT, GL_FALSE, stateFloats*sizeof(GLfloat), (void*)(4*sizeof(GLfloat)) );
+	glVertexAttribDivisorARB( positionAttribute, 1 );
+	glVertexAttribDivisorARB( paramsAttribute, 1 );
+	glEnableVertexAttribArray( positionAttribute );
+	glEnableVertexAttribArray( paramsAttribute );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mCornerBuffer );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, (void*)0 );
+
+	// dead particles have a size of zero and are not rasterized
+	glDrawArraysInstancedARB( GL_TRIANGLE_FAN, 0, 4, mCapacity );
+
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glDisableVertexAttribArray( paramsAttribute );
+	glDisableVertexAttribArray( positionAttribute );
+	glVertexAttribDivisorARB( paramsAttribute, 0 );
+	glVertexAttribDivisorARB( positionAttribute, 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
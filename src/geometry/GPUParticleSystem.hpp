@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOMETRY_GPUPARTICLESYSTEM_INCLUDED
+#define GEOMETRY_GPUPARTICLESYSTEM_INCLUDED
+
+#include <GLWidget.hpp>
+
+#include <QVector>
+#include <QVector3D>
+#include <QSize>
+
+
+class QGLShaderProgram;
+class Terrain;
+
+
+/// Particle system simulated entirely on the GPU
+/**
+ * Emission, integration and lifetime are computed by the particleUpdate shader
+ * using transform feedback into two buffers which are swapped every update.
+ * The CPU only queues emit commands, there is no per-particle work and no read back.\n
+ * Particles are emitted into a ring, so emitting into a full system replaces the oldest particles.
+ * Particles below the terrain are killed by sampling a height texture.\n
+ * Drawing requires a material using MaterialShaderVariant::BILLBOARD, as particles are never seen by the CPU.
+ */
+class GPUParticleSystem
+{
+public:
+	GPUParticleSystem( GLWidget * glWidget, int capacity=4096 );
+	~GPUParticleSystem();
+
+	void update( const double & delta );
+	void draw();
+	void emitSpherical( const QVector3D & source, int toEmit, const float & minVel, const float & maxVel, const QVector3D & velOffset = QVector3D(0,0,0) );
+
+	const float & minLife() const { return mMinLife; }
+	const float & maxLife() const { return mMaxLife; }
+	const float & drag() const { return mDrag; }
+	const float & size() const { return mSize; }
+	const QVector3D & gravity() const { return mGravity; }
+	const int & capacity() const { return mCapacity; }
+	void setMinLife( const float & minLife ) { mMinLife = minLife; }
+	void setMaxLife( const float & maxLife ) { mMaxLife = maxLife; }
+	void setDrag( const float & drag ) { mDrag = drag; }
+	void setSize( const float & size ) { mSize = size; }
+	void setGravity( const QVector3D & gravity ) { mGravity = gravity; }
+
+	/// Returns true if all particles are dead and nothing is queued - updating and drawing do nothing then
+	bool idle() const { return mEmits.isEmpty() && mQuietTime > mMaxLife; }
+	/// Conservative bounding sphere of all particles emitted during the last maximum life time
+	const QVector3D & boundsCenter() const { return mBoundsCenter; }
+	const float & boundsRadius() const { return mBoundsRadius; }
+
+	/// Kills particles sinking below the given terrain's surface by more than half their size
+	void setTerrain( const Terrain * terrain );
+	/// Counteracts the given fraction of gravity for particles below the water's surface
+	void setWater( const float & height, const float & buoyancy ) { mWaterHeight = height; mBuoyancy = buoyancy; }
+
+	/// Returns true if particles can be simulated on the GPU - requires a current context
+	static bool supported();
+	/// Enables or disables simulation on the GPU - particle systems fall back to the CPU if disabled
+	static void setEnabled( bool enable ) { sEnabled = enable; }
+
+	/// Maximum number of emit commands processed per update - further commands are processed during the next updates
+	static const int maxEmitsPerUpdate = 8;
+
+private:
+	/// Queued emit command
+	struct Emit
+	{
+		QVector3D source;
+		QVector3D velocityOffset;
+		float minVelocity;
+		float maxVelocity;
+		int first;
+		int count;
+	};
+
+	GLWidget * mGLWidget;
+	int mCapacity;
+	float mMinLife;
+	float mMaxLife;
+	float mDrag;
+	float mSize;
+	QVector3D mGravity;
+	float mWaterHeight;
+	float mBuoyancy;
+	QVector<Emit> mEmits;
+	int mEmitCursor;
+	float mTime;
+	float mQuietTime;
+	QVector3D mBoundsCenter;
+	float mBoundsRadius;
+
+	QGLShaderProgram * mUpdateProgram;
+	GLuint mStateBuffers[2];
+	int mCurrentState;
+	GLuint mIndexBuffer;
+	GLuint mCornerBuffer;
+	GLuint mHeightMap;
+	QVector3D mTerrainOffset;
+	QVector3D mTerrainSize;
+	QSize mHeightMapSize;
+
+	static bool sEnabled;
+};
+
+
+#endif
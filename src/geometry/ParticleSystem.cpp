@@ -27,10 +27,24 @@
 #include <utility/RandomNumber.hpp>
 
 #include <math.h>
+#include <float.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+
+bool ParticleSystem::sGPUExpansion = true;
+bool ParticleSystem::sSorting = true;
+float ParticleSystem::sSoftness = 1.0f;
+GLuint ParticleSystem::sSceneDepthMap = 0;
+QRect ParticleSystem::sSceneViewport;
 
 
 ParticleSystem::ParticleSystem( int capacity )
 {
+	mAlive = 0;
+	mBoundsRadius = 0.0f;
 	setCapacity( capacity );
 	mMinLife = 1.0f;
 	mMaxLife = 2.0f;
@@ -38,32 +52,311 @@ ParticleSystem::ParticleSystem( int capacity )
 	mSize = 1.0f;
 	mGravity = QVector3D( 0.0f, -9.81f, 0.0f );
 	mInteractionCallback = 0;
-	for( int i=0; i<mParticles.size(); ++i )
+	mCornerBuffer = 0;
+	mInstanceBuffer = 0;
+}
+
+
+ParticleSystem::~ParticleSystem()
+{
+	if( mInstanceBuffer )
+		glDeleteBuffers( 1, &mInstanceBuffer );
+	if( mCornerBuffer )
+		glDeleteBuffers( 1, &mCornerBuffer );
+}
+
+
+bool ParticleSystem::gpuExpansion()
+{
+	return sGPUExpansion && GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+}
+
+
+void ParticleSystem::bindSceneDepth( GLuint program )
+{
+	GLint softnessLocation = glGetUniformLocation( program, "softness" );
+	if( softnessLocation < 0 )
+		return;
+	bool soft = sSceneDepthMap && sSoftness > 0.0f;
+	glUniform1f( softnessLocation, soft ? sSoftness : 0.0f );
+	if( !soft )
+		return;
+	glUniform1i( glGetUniformLocation( program, "sceneDepthMap" ), sceneDepthUnit );
+	glUniform4f( glGetUniformLocation( program, "sceneViewport" ),
+		sSceneViewport.x(), sSceneViewport.y(), sSceneViewport.width(), sSceneViewport.height() );
+	glActiveTexture( GL_TEXTURE0 + sceneDepthUnit );
+	glBindTexture( GL_TEXTURE_2D, sSceneDepthMap );
+	glActiveTexture( GL_TEXTURE0 );
+}
+
+
+void ParticleSystem::setCapacity( const int & capacity )
+{
+	mPositionX.resize( capacity );
+	mPositionY.resize( capacity );
+	mPositionZ.resize( capacity );
+	mVelocityX.resize( capacity );
+	mVelocityY.resize( capacity );
+	mVelocityZ.resize( capacity );
+	mLife.resize( capacity );
+	mRotation.resize( capacity );
+	mParticleVertices.resize( capacity*4 );
+	mAlive = qMin( mAlive, capacity );
+}
+
+
+void ParticleSystem::update( const double & delta )
+{
+	float dragFactor = pow( mDrag, delta );
+	for( int first = 0; first < mAlive; first += spanSize )
 	{
-		mParticles[i] = Particle();
+		int size = qMin( spanSize, mAlive-first );
+		integrate( first, size, delta, dragFactor );
+		if( mInteractionCallback )
+		{
+			Span span( this, first, size );
+			mInteractionCallback->particleInteraction( delta, span );
+		}
 	}
+	removeDead();
+	updateBounds();
 }
 
 
-void ParticleSystem::update( const double & delta )
+void ParticleSystem::updateBounds()
 {
-	QVector3D deltaVelocity = mGravity * delta;
-	double powDragDelta = pow( mDrag, delta );
-	for( int i=0; i<mParticles.size(); ++i )
+	if( !mAlive )
+	{
+		mBoundsRadius = 0.0f;
+		return;
+	}
+	float minX = mPositionX[0], maxX = minX;
+	float minY = mPositionY[0], maxY = minY;
+	float minZ = mPositionZ[0], maxZ = minZ;
+	for( int i = 1; i < mAlive; ++i )
 	{
-		if( mParticles[i].life() <= 0.0f )
+		minX = qMin( minX, mPositionX[i] );	maxX = qMax( maxX, mPositionX[i] );
+		minY = qMin( minY, mPositionY[i] );	maxY = qMax( maxY, mPositionY[i] );
+		minZ = qMin( minZ, mPositionZ[i] );	maxZ = qMax( maxZ, mPositionZ[i] );
+	}
+	QVector3D min( minX, minY, minZ );
+	QVector3D max( maxX, maxY, maxZ );
+	mBoundsCenter = ( min + max ) / 2.0f;
+	mBoundsRadius = ( max - min ).length() / 2.0f + mSize;
+}
+
+
+void ParticleSystem::integrate( int first, int size, const float & delta, const float & dragFactor )
+{
+	float * positionX = mPositionX.data() + first;
+	float * positionY = mPositionY.data() + first;
+	float * positionZ = mPositionZ.data() + first;
+	float * velocityX = mVelocityX.data() + first;
+	float * velocityY = mVelocityY.data() + first;
+	float * velocityZ = mVelocityZ.data() + first;
+	float * life = mLife.data() + first;
+	const float deltaVelocityX = mGravity.x() * delta;
+	const float deltaVelocityY = mGravity.y() * delta;
+	const float deltaVelocityZ = mGravity.z() * delta;
+
+	int i = 0;
+#ifdef __SSE__
+	const __m128 d = _mm_set1_ps( delta );
+	const __m128 drag = _mm_set1_ps( dragFactor );
+	const __m128 dvX = _mm_set1_ps( deltaVelocityX );
+	const __m128 dvY = _mm_set1_ps( deltaVelocityY );
+	const __m128 dvZ = _mm_set1_ps( deltaVelocityZ );
+	for( ; i+4 <= size; i += 4 )
+	{
+		__m128 vX = _mm_loadu_ps( velocityX+i );
+		__m128 vY = _mm_loadu_ps( velocityY+i );
+		__m128 vZ = _mm_loadu_ps( velocityZ+i );
+		_mm_storeu_ps( positionX+i, _mm_add_ps( _mm_loadu_ps( positionX+i ), _mm_mul_ps( vX, d ) ) );
+		_mm_storeu_ps( positionY+i, _mm_add_ps( _mm_loadu_ps( positionY+i ), _mm_mul_ps( vY, d ) ) );
+		_mm_storeu_ps( positionZ+i, _mm_add_ps( _mm_loadu_ps( positionZ+i ), _mm_mul_ps( vZ, d ) ) );
+		_mm_storeu_ps( velocityX+i, _mm_add_ps( _mm_mul_ps( vX, drag ), dvX ) );
+		_mm_storeu_ps( velocityY+i, _mm_add_ps( _mm_mul_ps( vY, drag ), dvY ) );
+		_mm_storeu_ps( velocityZ+i, _mm_add_ps( _mm_mul_ps( vZ, drag ), dvZ ) );
+		_mm_storeu_ps( life+i, _mm_sub_ps( _mm_loadu_ps( life+i ), d ) );
+	}
+#endif
+	for( ; i < size; ++i )
+	{
+		positionX[i] += velocityX[i] * delta;
+		positionY[i] += velocityY[i] * delta;
+		positionZ[i] += velocityZ[i] * delta;
+		velocityX[i] = velocityX[i] * dragFactor + deltaVelocityX;
+		velocityY[i] = velocityY[i] * dragFactor + deltaVelocityY;
+		velocityZ[i] = velocityZ[i] * dragFactor + deltaVelocityZ;
+		life[i] -= delta;
+	}
+}
+
+
+void ParticleSystem::removeDead()
+{
+	int i = 0;
+	while( i < mAlive )
+	{
+		if( mLife[i] > 0.0f )
+		{
+			++i;
 			continue;
-		mParticles[i].rPosition() += mParticles[i].velocity() * delta;
-		mParticles[i].rVelocity() *= powDragDelta;
-		mParticles[i].rVelocity() += deltaVelocity;
-		mParticles[i].rLife() -= delta;
-		if( mInteractionCallback )
-			mInteractionCallback->particleInteraction( delta, mParticles[i] );
+		}
+		// move the last alive particle into this slot and check it again
+		--mAlive;
+		mPositionX[i] = mPositionX[mAlive];
+		mPositionY[i] = mPositionY[mAlive];
+		mPositionZ[i] = mPositionZ[mAlive];
+		mVelocityX[i] = mVelocityX[mAlive];
+		mVelocityY[i] = mVelocityY[mAlive];
+		mVelocityZ[i] = mVelocityZ[mAlive];
+		mLife[i] = mLife[mAlive];
+		mRotation[i] = mRotation[mAlive];
 	}
 }
 
 
 void ParticleSystem::draw( const QMatrix4x4 & modelView )
+{
+	if( !mAlive )
+		return;
+	const int * order = sSorting ? sort( modelView ) : NULL;
+	if( !drawExpanded( order ) )
+		drawQuads( modelView, order );
+}
+
+
+const int * ParticleSystem::sort( const QMatrix4x4 & modelView )
+{
+	// sorted completely for every draw - reflections and stereo views draw the same particles from other eyes
+	// quantize the view depth - the farthest particle gets the lowest key
+	const QVector4D row = modelView.row( 2 );
+	mSortDepths.resize( mAlive );
+	float minDepth = FLT_MAX;
+	float maxDepth = -FLT_MAX;
+	for( int i = 0; i < mAlive; ++i )
+	{
+		float depth = row.x()*mPositionX[i] + row.y()*mPositionY[i] + row.z()*mPositionZ[i];
+		mSortDepths[i] = depth;
+		minDepth = qMin( minDepth, depth );
+		maxDepth = qMax( maxDepth, depth );
+	}
+	const float scale = 65535.0f / qMax( maxDepth - minDepth, FLT_EPSILON );
+	mSortKeys.resize( mAlive );
+	for( int i = 0; i < mAlive; ++i )
+	{
+		mSortKeys[i] = ( mSortDepths[i] - minDepth ) * scale;
+	}
+
+	// sort by the low byte
+	int offsets[256] = { 0 };
+	for( int i = 0; i < mAlive; ++i )
+		++offsets[mSortKeys[i] & 0xff];
+	for( int b = 0, sum = 0; b < 256; ++b )
+	{
+		int count = offsets[b];
+		offsets[b] = sum;
+		sum += count;
+	}
+	mSortScratch.resize( mAlive );
+	for( int i = 0; i < mAlive; ++i )
+		mSortScratch[offsets[mSortKeys[i] & 0xff]++] = i;
+
+	// sort by the high byte - the radix sort is stable, so the order is complete
+	int highOffsets[256] = { 0 };
+	for( int k = 0; k < mAlive; ++k )
+		++highOffsets[mSortKeys[mSortScratch[k]] >> 8];
+	for( int b = 0, sum = 0; b < 256; ++b )
+	{
+		int count = highOffsets[b];
+		highOffsets[b] = sum;
+		sum += count;
+	}
+	mSortOrder.resize( mAlive );
+	for( int k = 0; k < mAlive; ++k )
+		mSortOrder[highOffsets[mSortKeys[mSortScratch[k]] >> 8]++] = mSortScratch[k];
+	return mSortOrder.constData();
+}
+
+
+bool ParticleSystem::drawExpanded( const int * order )
+{
+	if( !gpuExpansion() )
+		return false;
+
+	GLint program = 0;
+	glGetIntegerv( GL_CURRENT_PROGRAM, &program );
+	if( !program )
+		return false;
+	GLint positionAttribute = glGetAttribLocation( program, "particlePosition" );
+	GLint paramsAttribute = glGetAttribLocation( program, "particleParams" );
+	if( positionAttribute < 0 || paramsAttribute < 0 )
+		return false;
+	bindSceneDepth( program );
+
+	if( !mCornerBuffer )
+	{
+		// corner x, corner y, corner index - in the order the CPU path emits them
+		static const GLfloat corners[] =
+		{
+			-1.0f, -1.0f, 0.0f,
+			 1.0f, -1.0f, 1.0f,
+			 1.0f,  1.0f, 2.0f,
+			-1.0f,  1.0f, 3.0f
+		};
+		glGenBuffers( 1, &mCornerBuffer );
+		glBindBuffer( GL_ARRAY_BUFFER, mCornerBuffer );
+		glBufferData( GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW );
+		glGenBuffers( 1, &mInstanceBuffer );
+	}
+
+	// orphan the previous frame's storage, so the driver does not need to wait until it was drawn
+	const int instanceFloats = 6;
+	glBindBuffer( GL_ARRAY_BUFFER, mInstanceBuffer );
+	glBufferData( GL_ARRAY_BUFFER, capacity()*instanceFloats*sizeof(GLfloat), NULL, GL_STREAM_DRAW );
+	GLfloat * instance = reinterpret_cast<GLfloat*>( glMapBuffer( GL_ARRAY_BUFFER, GL_WRITE_ONLY ) );
+	if( !instance )
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		return false;
+	}
+	for( int k=0; k<mAlive; ++k )
+	{
+		const int i = order ? order[k] : k;
+		*instance++ = mPositionX[i];
+		*instance++ = mPositionY[i];
+		*instance++ = mPositionZ[i];
+		*instance++ = mSize;
+		*instance++ = mRotation[i];
+		*instance++ = mLife[i];
+	}
+	glUnmapBuffer( GL_ARRAY_BUFFER );
+
+	glVertexAttribPointer( positionAttribute, 4, GL_FLOAT, GL_FALSE, instanceFloats*sizeof(GLfloat), (void*)0 );
+	glVertexAttribPointer( paramsAttribute, 2, GL_FLOAT, GL_FALSE, instanceFloats*sizeof(GLfloat), (void*)(4*sizeof(GLfloat)) );
+	glVertexAttribDivisorARB( positionAttribute, 1 );
+	glVertexAttribDivisorARB( paramsAttribute, 1 );
+	glEnableVertexAttribArray( positionAttribute );
+	glEnableVertexAttribArray( paramsAttribute );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mCornerBuffer );
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, (void*)0 );
+
+	glDrawArraysInstancedARB( GL_TRIANGLE_FAN, 0, 4, mAlive );
+
+	glDisableClientState( GL_VERTEX_ARRAY );
+	glDisableVertexAttribArray( paramsAttribute );
+	glDisableVertexAttribArray( positionAttribute );
+	glVertexAttribDivisorARB( paramsAttribute, 0 );
+	glVertexAttribDivisorARB( positionAttribute, 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	return true;
+}
+
+
+void ParticleSystem::drawQuads( const QMatrix4x4 & modelView, const int * order )
 {
 	QVector3D dir( modelView.row(2).toVector3D() );
 	QVector3D up( modelView.row(1).toVector3D() );
@@ -80,26 +373,25 @@ void ParticleSystem::draw( const QMatrix4x4 & modelView )
 	QVector3D nD = (vD+dir).normalized();
 
 	int activeVertices = 0;
-	for( int i=0; i<mParticles.size(); ++i )
+	for( int k=0; k<mAlive; ++k )
 	{
-		if( mParticles[i].life() <= 0.0f )
-			continue;
-
+		const int i = order ? order[k] : k;
+		QVector3D position( mPositionX[i], mPositionY[i], mPositionZ[i] );
 		int current = activeVertices;
-		mParticleVertices[current].position = mParticles[i].position() + vD;
+		mParticleVertices[current].position = position + vD;
 		mParticleVertices[current].normal = nD;
 		++current;
-		mParticleVertices[current].position = mParticles[i].position() + vC;
+		mParticleVertices[current].position = position + vC;
 		mParticleVertices[current].normal = nC;
 		++current;
-		mParticleVertices[current].position = mParticles[i].position() + vB;
+		mParticleVertices[current].position = position + vB;
 		mParticleVertices[current].normal = nB;
 		++current;
-		mParticleVertices[current].position = mParticles[i].position() + vA;
+		mParticleVertices[current].position = position + vA;
 		mParticleVertices[current].normal = nA;
 
 		current = activeVertices;
-		int nextCoord = mParticles[i].rotation();
+		int nextCoord = mRotation[i];
 		for( int j = 0; j < 4; ++j )
 		{
 			switch( nextCoord & 0x03 )	// modulo 4
@@ -143,16 +435,29 @@ void ParticleSystem::draw( const QMatrix4x4 & modelView )
 
 void ParticleSystem::emitSpherical( const QVector3D & source, int toEmit, const float & minVel, const float & maxVel, const QVector3D & velOffset )
 {
-	for( int i=0; i<mParticles.size() && toEmit>0; ++i )
+	if( toEmit <= 0 || mAlive >= capacity() )
+		return;
+	if( mAlive )
+	{
+		mBoundsRadius = qMax( mBoundsRadius, ( source - mBoundsCenter ).length() + mSize );
+	}
+	else
+	{
+		mBoundsCenter = source;
+		mBoundsRadius = mSize;
+	}
+	for( ; mAlive < capacity() && toEmit > 0; --toEmit, ++mAlive )
 	{
-		if( mParticles[i].life()>0.0f )
-			continue;
-
-		--toEmit;
 		QVector3D direction = RandomNumber::inUnitSphere();
 		direction.normalize();
-		mParticles[i].rVelocity() = direction * RandomNumber::minMax( minVel, maxVel ) + velOffset;
-		mParticles[i].rPosition() = source;
-		mParticles[i].rLife() = RandomNumber::minMax( mMinLife, mMaxLife );
+		QVector3D velocity = direction * RandomNumber::minMax( minVel, maxVel ) + velOffset;
+		mPositionX[mAlive] = source.x();
+		mPositionY[mAlive] = source.y();
+		mPositionZ[mAlive] = source.z();
+		mVelocityX[mAlive] = velocity.x();
+		mVelocityY[mAlive] = velocity.y();
+		mVelocityZ[mAlive] = velocity.z();
+		mLife[mAlive] = RandomNumber::minMax( mMinLife, mMaxLife );
+		mRotation[mAlive] = rand()%4;
 	}
 }
@@ -29,46 +29,67 @@
 #include <QVector>
 #include <QVector2D>
 #include <QVector3D>
+#include <QRect>
 
 
 /// Simple particle system
+/**
+ * Particles are stored as a structure of arrays.
+ * Alive particles are kept compact at the beginning of the arrays by moving the last alive particle into the slot of a dead one,
+ * so updating, emitting and drawing only touch alive particles.
+ *
+ * If sorting is enabled, particles are drawn back to front. The view depth is quantized to 16 bits and sorted by
+ * two 8 bit radix passes for every view the system is drawn in.
+ */
 class ParticleSystem
 {
 public:
-	/// A single particle
-	class Particle
+	/// A contiguous range of alive particles
+	/**
+	 * Element i of each array belongs to the same particle.
+	 * Setting a particle's life to zero or below removes it after the interaction.
+	 */
+	class Span
 	{
 	public:
-		Particle( float life=0.0f, QVector3D position=QVector3D(0,0,0), QVector3D velocity=QVector3D(0,0,0) ) :
-			mVelocity(velocity), mPosition(position), mLife(life), mRotation(rand()%4) {}
-		~Particle() {}
-		const QVector3D & velocity() const { return mVelocity; }
-		const QVector3D & position() const { return mPosition; }
-		const float & life() const { return mLife; }
-		const int & rotation() const { return mRotation; }
-		QVector3D & rVelocity() { return mVelocity; }
-		QVector3D & rPosition() { return mPosition; }
-		float & rLife() { return mLife; }
-		void setVelocity( const QVector3D & velocity ) { mVelocity = velocity; }
-		void setPosition( const QVector3D & position ) { mPosition = position; }
-		void setLife( const float & life ) { mLife = life; }
+		Span( ParticleSystem * system, int first, int size ) :
+			positionX( system->mPositionX.data()+first ), positionY( system->mPositionY.data()+first ), positionZ( system->mPositionZ.data()+first ),
+			velocityX( system->mVelocityX.data()+first ), velocityY( system->mVelocityY.data()+first ), velocityZ( system->mVelocityZ.data()+first ),
+			life( system->mLife.data()+first ), mSize( size ) {}
+		const int & size() const { return mSize; }
+		QVector3D position( int i ) const { return QVector3D( positionX[i], positionY[i], positionZ[i] ); }
+		QVector3D velocity( int i ) const { return QVector3D( velocityX[i], velocityY[i], velocityZ[i] ); }
+		void setPosition( int i, const QVector3D & p ) { positionX[i] = p.x(); positionY[i] = p.y(); positionZ[i] = p.z(); }
+		void setVelocity( int i, const QVector3D & v ) { velocityX[i] = v.x(); velocityY[i] = v.y(); velocityZ[i] = v.z(); }
+		void kill( int i ) { life[i] = 0.0f; }
+
+		float * const positionX;
+		float * const positionY;
+		float * const positionZ;
+		float * const velocityX;
+		float * const velocityY;
+		float * const velocityZ;
+		float * const life;
 	private:
-		QVector3D mVelocity;
-		QVector3D mPosition;
-		float mLife;
-		int mRotation;
+		int mSize;
 	};
 
 	/// Inherit to define particle interaction with environment
 	class Interactable
 	{
 	public:
-		virtual void particleInteraction( const double & delta, Particle & particle ) = 0;
+		/// Called after integration for consecutive spans of alive particles
+		virtual void particleInteraction( const double & delta, Span & particles ) = 0;
 	};
 
 	ParticleSystem( int capacity=1000 );
-	~ParticleSystem() {}
+	~ParticleSystem();
 	void update( const double & delta );
+	/// Draws all alive particles as billboards
+	/**
+	 * If the bound shader provides the particlePosition and particleParams attributes (MaterialShaderVariant::BILLBOARD),
+	 * only per-particle data is streamed and the corners are expanded by the shader - quads are built on the CPU otherwise.
+	 */
 	void draw( const QMatrix4x4 & modelView );
 	void emitSpherical( const QVector3D & source, int toEmit, const float & minVel, const float & maxVel, const QVector3D & velOffset = QVector3D(0,0,0) );
 	const float & minLife() const { return mMinLife; }
@@ -76,14 +97,47 @@ public:
 	const float & drag() const { return mDrag; }
 	const float & size() const { return mSize; }
 	const QVector3D & gravity() const { return mGravity; }
-	const int capacity() const { return mParticles.size(); }
+	const int capacity() const { return mLife.size(); }
+	const int & alive() const { return mAlive; }
+	/// Bounding sphere of all alive particles including their size - updated by update() and emitting
+	const QVector3D & boundsCenter() const { return mBoundsCenter; }
+	const float & boundsRadius() const { return mBoundsRadius; }
 	void setMinLife( const float & minLife ) { mMinLife = minLife; }
 	void setMaxLife( const float & maxLife ) { mMaxLife = maxLife; }
 	void setDrag( const float & drag ) { mDrag = drag; }
 	void setSize( const float & size ) { mSize = size; }
 	void setGravity( const QVector3D & gravity ) { mGravity = gravity; }
-	void setCapacity( const int & capacity ) { mParticles.resize( capacity ); mParticleVertices.resize( capacity*4 ); }
+	void setCapacity( const int & capacity );
+	/// Sets the object alive particles interact with - not owned, the owner must clear it before it is destroyed
 	void setInteractionCallback( Interactable * callback ) { mInteractionCallback = callback; }
+	Interactable * interactionCallback() const { return mInteractionCallback; }
+
+	/// Number of particles integrated and passed to the interaction callback at once
+	static const int spanSize = 1024;
+
+	/// Returns true if billboards are expanded by shaders - materials for particles should use MaterialShaderVariant::BILLBOARD then
+	static bool gpuExpansion();
+	/// Enables or disables expanding billboards by shaders - should be set before any particle material is created
+	static void setGPUExpansion( bool enable ) { sGPUExpansion = enable; }
+
+	/// Returns true if particles are drawn back to front
+	static const bool & sorting() { return sSorting; }
+	static void setSorting( const bool & enable ) { sSorting = enable; }
+
+	/// Distance over which billboards fade out in front of scene geometry - zero disables soft particles
+	static const float & softness() { return sSoftness; }
+	static void setSoftness( const float & softness ) { sSoftness = softness; }
+
+	/// Sets the depth texture of the scene drawn so far and the viewport it was copied from - 0 disables soft particles
+	static void setSceneDepth( GLuint depthMap, const QRect & viewport ) { sSceneDepthMap = depthMap; sSceneViewport = viewport; }
+	static GLuint sceneDepthMap() { return sSceneDepthMap; }
+	static const QRect & sceneViewport() { return sSceneViewport; }
+
+	/// Passes the scene depth to a billboard shader providing the softness uniform
+	static void bindSceneDepth( GLuint program );
+
+	/// Texture unit the scene depth is bound to
+	static const int sceneDepthUnit = 7;
 
 protected:
 
@@ -93,9 +147,38 @@ private:
 	float mDrag;
 	float mSize;
 	QVector3D mGravity;
-	QVector<Particle> mParticles;
+	int mAlive;
+	QVector3D mBoundsCenter;
+	float mBoundsRadius;
+	QVector<float> mPositionX;
+	QVector<float> mPositionY;
+	QVector<float> mPositionZ;
+	QVector<float> mVelocityX;
+	QVector<float> mVelocityY;
+	QVector<float> mVelocityZ;
+	QVector<float> mLife;
+	QVector<unsigned char> mRotation;
 	QVector<VertexP3fN3fT2f> mParticleVertices;
 	Interactable * mInteractionCallback;
+	GLuint mCornerBuffer;
+	GLuint mInstanceBuffer;
+	QVector<float> mSortDepths;
+	QVector<quint16> mSortKeys;
+	QVector<int> mSortScratch;
+	QVector<int> mSortOrder;
+
+	static bool sGPUExpansion;
+	static bool sSorting;
+	static float sSoftness;
+	static GLuint sSceneDepthMap;
+	static QRect sSceneViewport;
+
+	bool drawExpanded( const int * order );
+	void drawQuads( const QMatrix4x4 & modelView, const int * order );
+	const int * sort( const QMatrix4x4 & modelView );
+	void integrate( int first, int size, const float & delta, const float & dragFactor );
+	void removeDead();
+	void updateBounds();
 };
 
 
@@ -242,6 +242,33 @@ void Terrain::draw()
 }
 
 
+GLuint Terrain::createHeightTexture() const
+{
+	QVector<GLushort> heights( mMapSize.width() * mMapSize.height() );
+	for( int y = 0; y < mMapSize.height(); ++y )
+	{
+		for( int x = 0; x < mMapSize.width(); ++x )
+		{
+			float height = ( getVertexPosition( x, y ).y() - mOffset.y() ) / mSize.y();
+			heights[y*mMapSize.width()+x] = qBound( 0.0f, height, 1.0f ) * 65535.0f;
+		}
+	}
+
+	GLuint texture;
+	glGenTextures( 1, &texture );
+	glBindTexture( GL_TEXTURE_2D, texture );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 2 );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_LUMINANCE16, mMapSize.width(), mMapSize.height(), 0, GL_LUMINANCE, GL_UNSIGNED_SHORT, heights.constData() );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	return texture;
+}
+
+
 bool Terrain::getTriangle( const QPointF & position, Triangle & t ) const
 {
 	QPoint pos = QPoint( position.x(), position.y() );
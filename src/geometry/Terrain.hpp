@@ -106,6 +106,14 @@ public:
 	 */
 	void drawPatchMap( const QRect & rect );
 
+	/// Creates a texture containing the terrain's height for lookups by shaders.
+	/**
+	 * Texel (x,y) holds the height of the vertex at heightmap coordinates (x,y),
+	 * normalized from offset().y() to offset().y()+size().y() using 16 bits.
+	 * The caller has to delete the texture.
+	 */
+	GLuint createHeightTexture() const;
+
 	const QSizeF & toMapFactor() const { return mToMapFactor; }
 
 	QPointF toMapF( const QVector3D & point ) const;	///< Converts a vector in world coordinates to heightmap coordinates.
@@ -23,6 +23,8 @@
 
 #include "MainWindow.hpp"
 
+#include <resource/Material.hpp>
+
 #include <QDir>
 #include <QTextCodec>
 
@@ -70,6 +72,14 @@ int main( int argc, char * argv[] )
 
 	QApplication app( argc, argv );
 
+	// offline step: transcode all material textures to DDS files and quit
+	if( app.arguments().contains( "--transcode-textures" ) )
+	{
+		int num = MaterialData::transcodeTextures( !app.arguments().contains( "--uncompressed" ) );
+		qDebug( "* %s", qPrintable(QObject::tr("Transcoded %1 textures").arg(num)) );
+		return 0;
+	}
+
 	MainWindow window;
 	window.show();
 
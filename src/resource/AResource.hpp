@@ -25,21 +25,30 @@
 #define RESOURCE_ARESOURCE_INCLUDED
 
 
+#include "ResourceLoader.hpp"
+#include "ResourceCache.hpp"
+
 #include <QHash>
+#include <QList>
 #include <QWeakPointer>
 #include <QString>
+#include <QDebug>
 
 
 /// Abstract base class for common resource data
 /**
  * This class defines a resource's data using a unique identifier.\n
  * The resource data can then be loaded to memory.
+ * Loading is split into decode() and upload(), so that data capable of asynchronous loading
+ * can be decoded by the ResourceLoader's worker threads.
  */
 class AResourceData
 {
+	friend class ResourceLoader;
+	template< class T > friend class AResource;
 public:
 	/// Initializes a description to the data identified by given UID
-	AResourceData( const QString & uid ) : mUID(uid), mLoaded(false) {}
+	AResourceData( const QString & uid ) : mUID(uid), mLoaded(false), mPending(false), mDecodeFailed(false), mUsers(0), mCacheMemoryUsage(0), mCountedMemory(0) {}
 	/// Abstract destructor
 	virtual ~AResourceData() = 0;
 
@@ -49,10 +58,26 @@ public:
 	/// Returns true if the data could be loaded successfully
 	bool loaded() const { return mLoaded; }
 
+	/// Returns true if the data is queued for asynchronous loading but not uploaded yet
+	bool pending() const { return mPending; }
+
+	/// Returns the number of resources currently bound to this data
+	int users() const { return mUsers; }
+
+	/// Returns the approximate number of bytes this data occupies in video or audio memory while loaded
+	virtual qint64 memoryUsage() const { return 0; }
+
+	/// Returns true if decode() may be called from a worker thread
+	virtual bool asyncCapable() const { return false; }
+
 	/// Loads the data to memory
-	virtual bool load() { mLoaded = true; return true; }
+	virtual bool load() { unload(); return decode() && upload(); }
+	/// Reads and decodes the data - must not use the OpenGL or OpenAL context
+	virtual bool decode() { return true; }
+	/// Transfers decoded data to OpenGL or OpenAL - must be called from the render thread
+	virtual bool upload() { mLoaded = true; countMemory( memoryUsage() ); return true; }
 	/// Unload data
-	virtual void unload() { mLoaded = false; }
+	virtual void unload() { mLoaded = false; countMemory( 0 ); }
 
 	virtual bool operator==( const AResourceData & rhs ) const { return mUID==rhs.mUID; }
 	virtual bool operator!=( const AResourceData & rhs ) const { return !(*this==rhs); }
@@ -62,6 +87,19 @@ public:
 private:
 	QString mUID;
 	bool mLoaded;
+	bool mPending;
+	bool mDecodeFailed;
+	int mUsers;
+	qint64 * mCacheMemoryUsage;
+	qint64 mCountedMemory;
+
+	/// Replaces the bytes this data contributes to its resource type's memory usage
+	void countMemory( qint64 bytes )
+	{
+		if( mCacheMemoryUsage )
+			*mCacheMemoryUsage += bytes - mCountedMemory;
+		mCountedMemory = bytes;
+	}
 };
 
 
@@ -70,14 +108,16 @@ private:
  * This class represents a resource.
  * If multiple classes reference the same data,
  * this data is stored using the AResourceData class
- * and shared among all AResource classes.
+ * and shared among all AResource classes.\n
+ * Data which is no longer bound to any resource is kept in a least recently used list
+ * and released only when the memory used by this resource type exceeds the cache budget.
  */
 template< class T >
 class AResource
 {
 public:
 	AResource() {};
-	virtual ~AResource() {};
+	virtual ~AResource() { unbindData(); };
 
 	/// Returns the pointer to this resource's data
 	const QSharedPointer<T> & constData() const { return mData; }
@@ -85,6 +125,47 @@ public:
 	/// Returns the entire cache for this resource type
 	static const QHash< QString, QWeakPointer<T> > & cache() { return sCache; }
 
+	/// Returns the number of bytes used by all loaded data of this resource type
+	static qint64 cacheMemoryUsage() { return sCacheMemoryUsage; }
+	/// Returns the number of bytes this resource type may use before unreferenced data gets released
+	static qint64 cacheBudget() { return sCacheBudget; }
+	/// Sets the number of bytes this resource type may use before unreferenced data gets released
+	static void setCacheBudget( qint64 bytes ) { sCacheBudget = bytes; trimCache(); }
+
+	/// Releases least recently used unreferenced data until the cache budget is met
+	static void trimCache()
+	{
+		while( sCacheMemoryUsage > sCacheBudget && !sUnused.isEmpty() )
+			sUnused.removeFirst();
+	}
+
+	/// Releases all unreferenced data of this resource type and returns the number of released entries
+	static int clearCache()
+	{
+		int num = sUnused.size();
+		sUnused.clear();
+		return num;
+	}
+
+	/// Writes the cache contents of this resource type to the debug output
+	static void dumpCache( const char * typeName )
+	{
+		qDebug( "\t* %s: %d entries, %d unreferenced, %.2f of %.2f MiB",
+			typeName, sCache.size(), sUnused.size(),
+			cacheMemoryUsage()/(1024.0*1024.0), sCacheBudget/(1024.0*1024.0) );
+		QHashIterator< QString, QWeakPointer<T> > i( sCache );
+		while( i.hasNext() )
+		{
+			i.next();
+			QSharedPointer<T> d = i.value().toStrongRef();
+			if( d.isNull() )
+				continue;
+			qDebug( "\t\t* %-32s users: %3d\t%8.1f KiB\t%s",
+				qPrintable( i.key() ), d->users(), d->memoryUsage()/1024.0,
+				d->loaded() ? "loaded" : ( d->pending() ? "pending" : "failed" ) );
+		}
+	}
+
 protected:
 	/// Returns the pointer to this resource's data
 	QSharedPointer<T> & data() { return mData; }
@@ -93,32 +174,65 @@ protected:
 	/**
 	 * Binds the given resource data.
 	 * If the resource's data is already loaded,
-	 * this resource is bound to the already loaded data.\n
+	 * this resource is bound to the already loaded data.
+	 * Data capable of asynchronous loading is queued to the ResourceLoader if enabled.\n
 	 * \warning Do not use the given data pointer after calling this method - use the data() method instead.
 	 * Only data() will return a valid pointer to the resource's data in case the data is already cached.
 	 * @param data The (unloaded) data that is used as a data descriptor.
 	 */
 	void cache( QSharedPointer<T> data )
 	{
+		unbindData();
 		if( sCache.contains(data->uid()) && !(sCache[data->uid()].isNull()) )
 		{
 			mData = sCache[data->uid()];
+			if( mData->mUsers == 0 )
+				sUnused.removeOne( mData );
 		} else {
 			sCache[data->uid()] = data;
 			mData = data;
-			mData->load();
+			mData->mCacheMemoryUsage = &sCacheMemoryUsage;
+			if( ResourceLoader::enabled() && mData->asyncCapable() )
+				ResourceLoader::enqueue( mData );
+			else
+				mData->load();
 		}
+		mData->mUsers++;
 	}
 
 private:
 	static QHash< QString, QWeakPointer<T> > sCache;
+	static QList< QSharedPointer<T> > sUnused;
+	static qint64 sCacheBudget;
+	static qint64 sCacheMemoryUsage;
 	QSharedPointer<T> mData;
+
+	/// Unbinds this resource's data and moves it to the least recently used list if unreferenced
+	void unbindData()
+	{
+		if( mData.isNull() )
+			return;
+		if( --mData->mUsers == 0 )
+		{
+			sUnused.append( mData );
+			mData.clear();
+			trimCache();
+			return;
+		}
+		mData.clear();
+	}
 };
 
 
 #define RESOURCE_CACHE( ResourceDataType ) \
 	template<> QHash< QString, QWeakPointer<ResourceDataType> > AResource<ResourceDataType>::sCache \
-		= QHash< QString, QWeakPointer<ResourceDataType> >()
+		= QHash< QString, QWeakPointer<ResourceDataType> >(); \
+	template<> QList< QSharedPointer<ResourceDataType> > AResource<ResourceDataType>::sUnused \
+		= QList< QSharedPointer<ResourceDataType> >(); \
+	template<> qint64 AResource<ResourceDataType>::sCacheBudget = 64*1024*1024; \
+	template<> qint64 AResource<ResourceDataType>::sCacheMemoryUsage = 0; \
+	static ResourceCache::Registration sResourceCacheRegistration##ResourceDataType( \
+		#ResourceDataType, &AResource<ResourceDataType>::dumpCache, &AResource<ResourceDataType>::clearCache )
 
 
 #endif
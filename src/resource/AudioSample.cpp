@@ -31,15 +31,22 @@
 #include <QVector3D>
 #include <AL/al.h>
 #include <float.h>
+#include <stdlib.h>
 
 
 RESOURCE_CACHE( AudioSampleData );
 
 
+QList<AudioSample*> AudioSample::sWaiting;
+
+
 AudioSampleData::AudioSampleData( QString name ) :
 	AResourceData( name ),
 	mName( name ),
-	mBuffer( 0 )
+	mBuffer( 0 ),
+	mBufferSize( 0 ),
+	mSamples( 0 ),
+	mSamplesSize( 0 )
 {
 }
 
@@ -47,6 +54,15 @@ AudioSampleData::AudioSampleData( QString name ) :
 AudioSampleData::~AudioSampleData()
 {
 	unload();
+	freeSamples();
+}
+
+
+void AudioSampleData::freeSamples()
+{
+	free( mSamples );
+	mSamples = 0;
+	mSamplesSize = 0;
 }
 
 
@@ -58,15 +74,15 @@ void AudioSampleData::unload()
 	qDebug() << "-" << this << "AudioSampleData" << uid();
 
 	alDeleteBuffers( 1, &mBuffer );
+	mBufferSize = 0;
 
 	AResourceData::unload();
 }
 
 
-bool AudioSampleData::load()
+bool AudioSampleData::decode()
 {
-	unload();
-	qDebug() << "+" << this << "AudioSampleData" << uid();
+	freeSamples();
 
 	QDir soundDir( baseDirectory() );
 	QStringList candidateNameFilter;
@@ -79,7 +95,7 @@ bool AudioSampleData::load()
 	bool validFileLoaded = false;
 	foreach( const QString & file, candidates )
 	{
-		if( audioLoader( (baseDirectory()+file).toLocal8Bit().constData(), &mBuffer, &mFrequency, &mFormat ) == 0 )
+		if( audioDecoder( (baseDirectory()+file).toLocal8Bit().constData(), &mSamples, &mSamplesSize, &mFrequency, &mFormat ) == 0 )
 		{
 			validFileLoaded = true;
 			break;
@@ -91,7 +107,24 @@ bool AudioSampleData::load()
 	if( mFormat == AL_FORMAT_STEREO8 || mFormat == AL_FORMAT_STEREO16 )
 		qWarning() << "!" << this << "AudioSampleData" << uid() << "is a stereo file - positional audio disabled.";
 
-	return AResourceData::load();
+	return true;
+}
+
+
+bool AudioSampleData::upload()
+{
+	if( !mSamples )
+		return false;
+	qDebug() << "+" << this << "AudioSampleData" << uid();
+
+	alGenBuffers( 1, &mBuffer );
+	alBufferData( mBuffer, mFormat, mSamples, mSamplesSize, mFrequency );
+	mBufferSize = mSamplesSize;
+	freeSamples();
+
+	bool uploaded = AResourceData::upload();
+	AudioSample::attachWaiting( this );
+	return uploaded;
 }
 
 
@@ -101,6 +134,8 @@ AudioSample::AudioSample( QString file ) : AResource()
 	cache( n );
 
 	mSource = 0;
+	mBufferAttached = false;
+	mPlayPending = false;
 
 	alGenSources( 1, &mSource );
 
@@ -108,7 +143,8 @@ AudioSample::AudioSample( QString file ) : AResource()
 		qFatal( "Could not allocate sound source" );
 
 	alSourcei( mSource, AL_SOURCE_RELATIVE, AL_FALSE );
-	alSourcei( mSource, AL_BUFFER, data()->buffer() );
+	if( !attachBuffer() )
+		sWaiting.append( this );
 
 	setLooping( true );
 	setGain( 1.0f );
@@ -121,6 +157,8 @@ AudioSample::AudioSample( QString file ) : AResource()
 
 AudioSample::~AudioSample()
 {
+	sWaiting.removeOne( this );
+
 	if( !mSource )
 		return;
 
@@ -128,6 +166,45 @@ AudioSample::~AudioSample()
 }
 
 
+bool AudioSample::attachBuffer()
+{
+	if( !mBufferAttached && data()->loaded() )
+	{
+		alSourcei( mSource, AL_BUFFER, data()->buffer() );
+		mBufferAttached = true;
+	}
+	return mBufferAttached;
+}
+
+
+void AudioSample::play()
+{
+	// samples still loading in background are started once their buffer gets attached
+	if( attachBuffer() )
+		alSourcePlay( mSource );
+	else
+		mPlayPending = true;
+}
+
+
+void AudioSample::attachWaiting( const AudioSampleData * data )
+{
+	QMutableListIterator<AudioSample*> i( sWaiting );
+	while( i.hasNext() )
+	{
+		AudioSample * sample = i.next();
+		if( sample->constData().data() != data || !sample->attachBuffer() )
+			continue;
+		i.remove();
+		if( sample->mPlayPending )
+		{
+			sample->mPlayPending = false;
+			alSourcePlay( sample->mSource );
+		}
+	}
+}
+
+
 void AudioSample::setPositionAutoVelocity( const QVector3D & position, const double & delta )
 {
 	setPosition( position );
@@ -50,7 +50,10 @@ public:
 	ALenum format() const { return mFormat; }
 
 	// Overrides:
-	virtual bool load();
+	virtual bool asyncCapable() const { return true; }
+	virtual qint64 memoryUsage() const { return mBufferSize; }
+	virtual bool decode();
+	virtual bool upload();
 	virtual void unload();
 
 	static QString baseDirectory() { return AResourceData::baseDirectory()+"sound/"; }
@@ -60,6 +63,11 @@ private:
 	ALuint mBuffer;
 	ALsizei mFrequency;
 	ALenum mFormat;
+	ALsizei mBufferSize;
+	void * mSamples;
+	ALsizei mSamplesSize;
+
+	void freeSamples();
 };
 
 
@@ -95,12 +103,22 @@ public:
 	void setPositionAutoVelocity( const QVector3D & position, const double & delta );
 
 	void rewind() { alSourceRewind( mSource ); }
-	void play() { alSourcePlay( mSource ); }
-	void stop() { alSourceStop( mSource ); }
+	/// Starts playback - if the data is still loading, playback starts as soon as it is uploaded
+	void play();
+	void stop() { mPlayPending = false; alSourceStop( mSource ); }
+
+	/// Attaches the given data to all sources that were waiting for it to be uploaded
+	static void attachWaiting( const AudioSampleData * data );
 
 private:
 	ALuint mSource;
+	bool mBufferAttached;
+	bool mPlayPending;
 	QVector3D mLastPosition;
+
+	static QList<AudioSample*> sWaiting;
+
+	bool attachBuffer();
 };
 
 
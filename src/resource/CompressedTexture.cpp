@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CompressedTexture.hpp"
+
+#include <QImage>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+
+#include <limits.h>
+#include <string.h>
+
+
+bool CompressedTexture::sCompressionSupported = false;
+
+
+// DirectDraw Surface header values
+#define DDS_MAGIC		0x20534444	// "DDS "
+#define DDS_HEADER_SIZE		124
+#define DDS_PIXELFORMAT_SIZE	32
+#define DDSD_CAPS		0x00000001
+#define DDSD_HEIGHT		0x00000002
+#define DDSD_WIDTH		0x00000004
+#define DDSD_PITCH		0x00000008
+#define DDSD_PIXELFORMAT	0x00001000
+#define DDSD_MIPMAPCOUNT	0x00020000
+#define DDSD_LINEARSIZE		0x00080000
+#define DDPF_ALPHAPIXELS	0x00000001
+#define DDPF_FOURCC		0x00000004
+#define DDPF_RGB		0x00000040
+#define DDSCAPS_COMPLEX		0x00000008
+#define DDSCAPS_TEXTURE		0x00001000
+#define DDSCAPS_MIPMAP		0x00400000
+#define DDS_FOURCC_DXT1		0x31545844	// "DXT1"
+#define DDS_FOURCC_DXT5		0x35545844	// "DXT5"
+
+
+static int levelSize( GLenum format, int width, int height )
+{
+	int blocks = qMax( 1, (width+3)/4 ) * qMax( 1, (height+3)/4 );
+	switch( format )
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			return blocks * 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			return blocks * 16;
+		default:
+			return width * height * 4;
+	}
+}
+
+
+static inline quint16 packRGB565( const int c[3] )
+{
+	return ((c[0]>>3)<<11) | ((c[1]>>2)<<5) | (c[2]>>3);
+}
+
+
+static inline void unpackRGB565( quint16 packed, int c[3] )
+{
+	int r = (packed>>11) & 31;
+	int g = (packed>>5) & 63;
+	int b = packed & 31;
+	c[0] = (r<<3) | (r>>2);
+	c[1] = (g<<2) | (g>>4);
+	c[2] = (b<<3) | (b>>2);
+}
+
+
+qint64 CompressedTexture::memoryUsage() const
+{
+	qint64 bytes = 0;
+	foreach( const Level & level, mLevels )
+		bytes += level.data.size();
+	return bytes;
+}
+
+
+bool CompressedTexture::load( const QString & path )
+{
+	mLevels.clear();
+	mFormat = 0;
+
+	QFile file( path );
+	if( !file.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QDataStream in( &file );
+	in.setByteOrder( QDataStream::LittleEndian );
+
+	quint32 magic, size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+	in >> magic >> size >> flags >> height >> width >> pitchOrLinearSize >> depth >> mipMapCount;
+	if( magic != DDS_MAGIC || size != DDS_HEADER_SIZE )
+		return false;
+	in.skipRawData( 11*4 );	// reserved
+
+	quint32 pfSize, pfFlags, pfFourCC, pfBitCount, pfRMask, pfGMask, pfBMask, pfAMask;
+	in >> pfSize >> pfFlags >> pfFourCC >> pfBitCount >> pfRMask >> pfGMask >> pfBMask >> pfAMask;
+	in.skipRawData( 5*4 );	// caps and reserved
+	if( in.status() != QDataStream::Ok || pfSize != DDS_PIXELFORMAT_SIZE )
+		return false;
+
+	GLenum format = 0;
+	if( pfFlags & DDPF_FOURCC )
+	{
+		if( pfFourCC == DDS_FOURCC_DXT1 )
+			format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		else if( pfFourCC == DDS_FOURCC_DXT5 )
+			format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	}
+	else if( (pfFlags & DDPF_RGB) && pfBitCount == 32
+		&& pfRMask == 0x00ff0000 && pfGMask == 0x0000ff00 && pfBMask == 0x000000ff )
+	{
+		format = GL_RGBA8;
+	}
+	if( !format )
+		return false;
+
+	if( !(flags & DDSD_MIPMAPCOUNT) || mipMapCount == 0 )
+		mipMapCount = 1;
+
+	QVector<Level> levels;
+	int w = width;
+	int h = height;
+	for( quint32 i = 0; i < mipMapCount; ++i )
+	{
+		Level level;
+		level.width = w;
+		level.height = h;
+		level.data.resize( levelSize( format, w, h ) );
+		if( in.readRawData( level.data.data(), level.data.size() ) != level.data.size() )
+			return false;
+		levels.append( level );
+		w = qMax( 1, w/2 );
+		h = qMax( 1, h/2 );
+	}
+
+	mFormat = format;
+	mLevels = levels;
+	return true;
+}
+
+
+bool CompressedTexture::save( const QString & path ) const
+{
+	if( isNull() )
+		return false;
+
+	QFile file( path );
+	if( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+		return false;
+
+	QDataStream out( &file );
+	out.setByteOrder( QDataStream::LittleEndian );
+
+	const Level & base = mLevels.first();
+	quint32 flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+	flags |= isCompressed() ? DDSD_LINEARSIZE : DDSD_PITCH;
+	quint32 caps = DDSCAPS_TEXTURE;
+	if( mLevels.size() > 1 )
+	{
+		flags |= DDSD_MIPMAPCOUNT;
+		caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+
+	out << (quint32)DDS_MAGIC << (quint32)DDS_HEADER_SIZE << flags
+		<< (quint32)base.height << (quint32)base.width
+		<< (quint32)( isCompressed() ? base.data.size() : base.width*4 )
+		<< (quint32)0 << (quint32)mLevels.size();
+	for( int i = 0; i < 11; ++i )
+		out << (quint32)0;
+
+	out << (quint32)DDS_PIXELFORMAT_SIZE;
+	if( isCompressed() )
+	{
+		out << (quint32)DDPF_FOURCC
+			<< (quint32)( mFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? DDS_FOURCC_DXT1 : DDS_FOURCC_DXT5 )
+			<< (quint32)0 << (quint32)0 << (quint32)0 << (quint32)0 << (quint32)0;
+	}
+	else
+	{
+		out << (quint32)( DDPF_RGB | DDPF_ALPHAPIXELS ) << (quint32)0 << (quint32)32
+			<< (quint32)0x00ff0000 << (quint32)0x0000ff00 << (quint32)0x000000ff << (quint32)0xff000000;
+	}
+	out << caps << (quint32)0 << (quint32)0 << (quint32)0 << (quint32)0;
+
+	foreach( const Level & level, mLevels )
+		out.writeRawData( level.data.constData(), level.data.size() );
+
+	return out.status() == QDataStream::Ok;
+}
+
+
+GLuint CompressedTexture::bind( GLint wrapS, GLint wrapT ) const
+{
+	GLuint texture = 0;
+	glGenTextures( 1, &texture );
+	glBindTexture( GL_TEXTURE_2D, texture );
+
+	for( int i = 0; i < mLevels.size(); ++i )
+	{
+		const Level & level = mLevels[i];
+		if( isCompressed() )
+			glCompressedTexImage2D( GL_TEXTURE_2D, i, mFormat, level.width, level.height, 0, level.data.size(), level.data.constData() );
+		else
+			glTexImage2D( GL_TEXTURE_2D, i, GL_RGBA8, level.width, level.height, 0, GL_BGRA, GL_UNSIGNED_BYTE, level.data.constData() );
+	}
+
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mLevels.size()-1 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mLevels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT );
+
+	return texture;
+}
+
+
+CompressedTexture CompressedTexture::fromImage( const QImage & image, bool mipmap, bool compress )
+{
+	CompressedTexture texture;
+	if( image.isNull() )
+		return texture;
+
+	// ARGB32 is stored as BGRA in memory, which is uploaded using GL_BGRA
+	QImage level = image.convertToFormat( QImage::Format_ARGB32 ).mirrored();
+
+	bool alpha = false;
+	if( image.hasAlphaChannel() )
+	{
+		for( int y = 0; y < level.height() && !alpha; ++y )
+		{
+			const QRgb * line = reinterpret_cast<const QRgb*>( level.constScanLine( y ) );
+			for( int x = 0; x < level.width(); ++x )
+			{
+				if( qAlpha( line[x] ) < 255 )
+				{
+					alpha = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if( compress )
+		texture.mFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	else
+		texture.mFormat = GL_RGBA8;
+
+	while( true )
+	{
+		Level l;
+		l.width = level.width();
+		l.height = level.height();
+		if( compress )
+		{
+			l.data = compressLevel( level, alpha );
+		}
+		else
+		{
+			l.data.resize( l.width * l.height * 4 );
+			for( int y = 0; y < l.height; ++y )
+				memcpy( l.data.data() + y*l.width*4, level.constScanLine( y ), l.width*4 );
+		}
+		texture.mLevels.append( l );
+
+		if( !mipmap || ( level.width() == 1 && level.height() == 1 ) )
+			break;
+		level = level.scaled( qMax( 1, level.width()/2 ), qMax( 1, level.height()/2 ), Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+	}
+
+	return texture;
+}
+
+
+QString CompressedTexture::pathFor( const QString & sourcePath )
+{
+	QFileInfo info( sourcePath );
+	return info.path() + '/' + info.completeBaseName() + ".dds";
+}
+
+
+QByteArray CompressedTexture::compressLevel( const QImage & image, bool alpha )
+{
+	const int w = image.width();
+	const int h = image.height();
+	QByteArray data( levelSize( alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT, w, h ), 0 );
+	quint8 * dest = reinterpret_cast<quint8*>( data.data() );
+
+	quint8 block[16][4];
+	for( int by = 0; by < h; by += 4 )
+	{
+		for( int bx = 0; bx < w; bx += 4 )
+		{
+			for( int i = 0; i < 16; ++i )
+			{
+				// repeat border pixels for levels smaller than a block
+				int x = qMin( bx + i%4, w-1 );
+				int y = qMin( by + i/4, h-1 );
+				QRgb p = reinterpret_cast<const QRgb*>( image.constScanLine( y ) )[x];
+				block[i][0] = qRed( p );
+				block[i][1] = qGreen( p );
+				block[i][2] = qBlue( p );
+				block[i][3] = qAlpha( p );
+			}
+			if( alpha )
+			{
+				compressAlphaBlock( block, dest );
+				dest += 8;
+			}
+			compressColorBlock( block, dest );
+			dest += 8;
+		}
+	}
+
+	return data;
+}
+
+
+void CompressedTexture::compressColorBlock( const quint8 block[16][4], quint8 * dest )
+{
+	// end points are the block's bounding box, inset by 1/16 to reduce the error at its corners
+	int minColor[3] = { 255, 255, 255 };
+	int maxColor[3] = { 0, 0, 0 };
+	for( int i = 0; i < 16; ++i )
+	{
+		for( int c = 0; c < 3; ++c )
+		{
+			minColor[c] = qMin( minColor[c], (int)block[i][c] );
+			maxColor[c] = qMax( maxColor[c], (int)block[i][c] );
+		}
+	}
+	for( int c = 0; c < 3; ++c )
+	{
+		int inset = ( maxColor[c] - minColor[c] ) >> 4;
+		minColor[c] += inset;
+		maxColor[c] -= inset;
+	}
+
+	// the maximum is packed first, so color0 > color1 selects the four color mode
+	quint16 color0 = packRGB565( maxColor );
+	quint16 color1 = packRGB565( minColor );
+
+	quint32 indices = 0;
+	if( color0 != color1 )
+	{
+		int palette[4][3];
+		unpackRGB565( color0, palette[0] );
+		unpackRGB565( color1, palette[1] );
+		for( int c = 0; c < 3; ++c )
+		{
+			palette[2][c] = ( 2*palette[0][c] + palette[1][c] ) / 3;
+			palette[3][c] = ( palette[0][c] + 2*palette[1][c] ) / 3;
+		}
+
+		for( int i = 0; i < 16; ++i )
+		{
+			int best = 0;
+			int bestDistance = INT_MAX;
+			for( int p = 0; p < 4; ++p )
+			{
+				int dr = block[i][0] - palette[p][0];
+				int dg = block[i][1] - palette[p][1];
+				int db = block[i][2] - palette[p][2];
+				int distance = dr*dr + dg*dg + db*db;
+				if( distance < bestDistance )
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (2*i);
+		}
+	}
+
+	dest[0] = color0 & 0xff;
+	dest[1] = color0 >> 8;
+	dest[2] = color1 & 0xff;
+	dest[3] = color1 >> 8;
+	dest[4] = indices & 0xff;
+	dest[5] = (indices >> 8) & 0xff;
+	dest[6] = (indices >> 16) & 0xff;
+	dest[7] = (indices >> 24) & 0xff;
+}
+
+
+void CompressedTexture::compressAlphaBlock( const quint8 block[16][4], quint8 * dest )
+{
+	int minAlpha = 255;
+	int maxAlpha = 0;
+	for( int i = 0; i < 16; ++i )
+	{
+		minAlpha = qMin( minAlpha, (int)block[i][3] );
+		maxAlpha = qMax( maxAlpha, (int)block[i][3] );
+	}
+
+	// alpha0 > alpha1 selects the eight value mode
+	int palette[8];
+	palette[0] = maxAlpha;
+	palette[1] = minAlpha;
+	for( int p = 1; p < 7; ++p )
+		palette[p+1] = ( (7-p)*maxAlpha + p*minAlpha ) / 7;
+
+	quint64 indices = 0;
+	if( maxAlpha != minAlpha )
+	{
+		for( int i = 0; i < 16; ++i )
+		{
+			int best = 0;
+			int bestDistance = INT_MAX;
+			for( int p = 0; p < 8; ++p )
+			{
+				int distance = qAbs( block[i][3] - palette[p] );
+				if( distance < bestDistance )
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= (quint64)best << (3*i);
+		}
+	}
+
+	dest[0] = maxAlpha;
+	dest[1] = minAlpha;
+	for( int b = 0; b < 6; ++b )
+		dest[2+b] = ( indices >> (8*b) ) & 0xff;
+}
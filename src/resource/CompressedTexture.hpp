@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCE_COMPRESSEDTEXTURE_INCLUDED
+#define RESOURCE_COMPRESSEDTEXTURE_INCLUDED
+
+
+#include <utility/glWrappers.hpp>
+
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+
+
+class QImage;
+
+
+/// Texture with precomputed mipmap levels, stored as DirectDraw Surface (DDS) file
+/**
+ * Levels are either S3TC compressed (DXT1 for opaque, DXT5 for translucent images)
+ * or uncompressed RGBA8, which is used as fallback if compression is not wanted.\n
+ * Rows are stored bottom-up as expected by OpenGL, so the levels can be uploaded
+ * without flipping (this matches QGLContext::InvertedYBindOption used for ordinary images).\n
+ * Loading and transcoding do not touch the OpenGL context and may be done by worker threads.
+ */
+class CompressedTexture
+{
+public:
+	/// A single mipmap level
+	typedef struct
+	{
+		int width;
+		int height;
+		QByteArray data;
+	} Level;
+
+	CompressedTexture() : mFormat( 0 ) {}
+
+	/// Returns true if no levels are loaded
+	bool isNull() const { return mLevels.isEmpty(); }
+	/// Returns true if the levels are S3TC compressed
+	bool isCompressed() const { return mFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || mFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; }
+	/// Returns the OpenGL internal format of the levels
+	GLenum format() const { return mFormat; }
+	/// Returns all mipmap levels starting with the base level
+	const QVector<Level> & levels() const { return mLevels; }
+	/// Returns the number of bytes occupied by all levels
+	qint64 memoryUsage() const;
+
+	/// Reads a DDS file written by save() - returns false on unsupported or broken files
+	bool load( const QString & path );
+	/// Writes the levels to a DDS file
+	bool save( const QString & path ) const;
+
+	/// Creates a new OpenGL texture from all levels and returns its identifier - must be called from the render thread
+	GLuint bind( GLint wrapS = GL_REPEAT, GLint wrapT = GL_REPEAT ) const;
+
+	/// Builds the mipmap chain of the given image and transcodes it
+	/**
+	 * @param image The source image (top-down, as loaded by QImage).
+	 * @param mipmap Generates the full mipmap chain if true, only the base level otherwise.
+	 * @param compress Uses DXT1/DXT5 if true, RGBA8 otherwise.
+	 */
+	static CompressedTexture fromImage( const QImage & image, bool mipmap = true, bool compress = true );
+
+	/// Returns the path of the transcoded texture belonging to the given source image
+	static QString pathFor( const QString & sourcePath );
+
+	/// Returns true if the OpenGL implementation supports S3TC compressed textures
+	static bool compressionSupported() { return sCompressionSupported; }
+	/// Sets if the OpenGL implementation supports S3TC compressed textures - set after creating the context
+	static void setCompressionSupported( bool supported ) { sCompressionSupported = supported; }
+
+private:
+	GLenum mFormat;
+	QVector<Level> mLevels;
+
+	static void compressColorBlock( const quint8 block[16][4], quint8 * dest );
+	static void compressAlphaBlock( const quint8 block[16][4], quint8 * dest );
+	static QByteArray compressLevel( const QImage & image, bool alpha );
+
+	static bool sCompressionSupported;
+};
+
+
+#endif
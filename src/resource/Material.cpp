@@ -25,12 +25,15 @@
 
 #include "Shader.hpp"
 #include <utility/glWrappers.hpp>
+#include <scene/LightGrid.hpp>
+#include <scene/ShadowMap.hpp>
 
 #include <QSettings>
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QGLShaderProgram>
-
-#include <unistd.h>
+#include <QSet>
 
 
 RESOURCE_CACHE(MaterialData);
@@ -38,6 +41,7 @@ RESOURCE_CACHE(MaterialData);
 MaterialQuality::Type MaterialQuality::sMaximum = MaterialQuality::HIGH;
 
 float Material::sFilterAnisotropy = 1.0f;
+GLuint Material::sPlaceholderTexture = 0;
 
 
 MaterialQuality::Type MaterialQuality::fromString( const QString & name )
@@ -69,10 +73,26 @@ QString MaterialQuality::toString( const MaterialQuality::Type & quality )
 }
 
 
+/// Loads the transcoded version of the given texture if it is up to date and usable
+static bool loadTranscodedTexture( const QString & sourcePath, CompressedTexture & texture )
+{
+	QFileInfo transcoded( CompressedTexture::pathFor( sourcePath ) );
+	if( !transcoded.exists() )
+		return false;
+	QFileInfo source( sourcePath );
+	if( source.exists() && source.lastModified() > transcoded.lastModified() )
+		return false;
+	if( !texture.load( transcoded.filePath() ) )
+		return false;
+	return !texture.isCompressed() || CompressedTexture::compressionSupported();
+}
+
+
 MaterialData::MaterialData( GLWidget * glWidget, QString name ) :
 	AResourceData( name ),
 	mGLWidget(glWidget),
-	mName(name)
+	mName(name),
+	mMemoryUsage(0)
 {
 }
 
@@ -97,14 +117,15 @@ void MaterialData::unload()
 	}
 	mTextures.clear();
 	mConstants.clear();
+	mMemoryUsage = 0;
 	AResourceData::unload();
 }
 
 
-bool MaterialData::load()
+bool MaterialData::decode()
 {
-	unload();
-	qDebug() << "+" << this << "MaterialData" << uid();
+	mImages.clear();
+	mCompressedImages.clear();
 
 	if( !QFile::exists( baseDirectory()+mName+"/material.ini" ) )
 	{
@@ -114,15 +135,11 @@ bool MaterialData::load()
 
 	QSettings s( baseDirectory()+mName+"/material.ini", QSettings::IniFormat );
 
-	GLint wrapS;
-	GLint wrapT;
-	bool mipmap;
-
 	s.beginGroup( "Param" );
 	{
-		wrapS = glGetTextureWrapFromString( s.value( "wrapS", "GL_REPEAT" ).toString() );
-		wrapT = glGetTextureWrapFromString( s.value( "wrapT", "GL_REPEAT" ).toString() );
-		mipmap = s.value( "mipmap", true ).toBool();
+		mWrapS = glGetTextureWrapFromString( s.value( "wrapS", "GL_REPEAT" ).toString() );
+		mWrapT = glGetTextureWrapFromString( s.value( "wrapT", "GL_REPEAT" ).toString() );
+		mMipmap = s.value( "mipmap", true ).toBool();
 	}
 	s.endGroup();
 
@@ -132,6 +149,12 @@ bool MaterialData::load()
 		for( QStringList::const_iterator i = textures.constBegin(); i != textures.constEnd(); ++i )
 		{
 			QString mapPath = baseDirectory()+mName+'/' + s.value( (*i) ).toString();
+			CompressedTexture compressed;
+			if( loadTranscodedTexture( mapPath, compressed ) )
+			{
+				mCompressedImages[(*i)] = compressed;
+				continue;
+			}
 			QImage map = QImage( mapPath );
 			if( map.isNull() )
 			{
@@ -141,14 +164,7 @@ bool MaterialData::load()
 					mapPath.toLocal8Bit().constData()
 				);
 			}
-			QGLContext::BindOptions options = QGLContext::InvertedYBindOption | QGLContext::LinearFilteringBindOption;
-			if( mipmap )
-				options |= QGLContext::MipmapBindOption;
-			GLuint texture =  mGLWidget->bindTexture( map, GL_TEXTURE_2D, GL_RGBA, options );
-			glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, Material::filterAnisotropy() );
-			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS );
-			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT );
-			mTextures[(*i)] = texture;
+			mImages[(*i)] = map;
 		}
 	}
 	s.endGroup();
@@ -210,7 +226,93 @@ bool MaterialData::load()
 	}
 	s.endGroup();
 
-	return AResourceData::load();
+	return true;
+}
+
+
+bool MaterialData::upload()
+{
+	qDebug() << "+" << this << "MaterialData" << uid();
+
+	QGLContext::BindOptions options = QGLContext::InvertedYBindOption | QGLContext::LinearFilteringBindOption;
+	if( mMipmap )
+		options |= QGLContext::MipmapBindOption;
+
+	QMap<QString, QImage>::const_iterator i = mImages.constBegin();
+	while( i != mImages.constEnd() )
+	{
+		GLuint texture =  mGLWidget->bindTexture( i.value(), GL_TEXTURE_2D, GL_RGBA, options );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, Material::filterAnisotropy() );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, mWrapS );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, mWrapT );
+		mTextures[i.key()] = texture;
+		// RGBA8 plus a third for the mipmap chain
+		qint64 bytes = (qint64)i.value().width() * i.value().height() * 4;
+		mMemoryUsage += mMipmap ? bytes*4/3 : bytes;
+		++i;
+	}
+	mImages.clear();
+
+	// transcoded textures already contain all mipmap levels
+	QMap<QString, CompressedTexture>::const_iterator c = mCompressedImages.constBegin();
+	while( c != mCompressedImages.constEnd() )
+	{
+		GLuint texture = c.value().bind( mWrapS, mWrapT );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, Material::filterAnisotropy() );
+		mTextures[c.key()] = texture;
+		mMemoryUsage += c.value().memoryUsage();
+		++c;
+	}
+	mCompressedImages.clear();
+
+	return AResourceData::upload();
+}
+
+
+int MaterialData::transcodeTextures( bool compress )
+{
+	int transcoded = 0;
+
+	QDir materialDir( baseDirectory() );
+	QStringList materials = materialDir.entryList( QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name );
+	foreach( const QString & name, materials )
+	{
+		QString iniPath = baseDirectory()+name+"/material.ini";
+		if( !QFile::exists( iniPath ) )
+			continue;
+
+		QSettings s( iniPath, QSettings::IniFormat );
+		bool mipmap = s.value( "Param/mipmap", true ).toBool();
+
+		s.beginGroup( "Textures" );
+		{
+			QStringList textures = s.allKeys();
+			foreach( const QString & key, textures )
+			{
+				QString mapPath = baseDirectory()+name+'/' + s.value( key ).toString();
+				QFileInfo target( CompressedTexture::pathFor( mapPath ) );
+				if( target.exists() && target.lastModified() >= QFileInfo( mapPath ).lastModified() )
+					continue;
+
+				QImage map( mapPath );
+				if( map.isNull() )
+				{
+					qWarning() << "!" << "MaterialData" << name << "Could not load " << mapPath;
+					continue;
+				}
+				if( !CompressedTexture::fromImage( map, mipmap, compress ).save( target.filePath() ) )
+				{
+					qWarning() << "!" << "MaterialData" << name << "Could not write " << target.filePath();
+					continue;
+				}
+				qDebug() << "+" << "MaterialData" << name << "transcoded" << target.filePath();
+				transcoded++;
+			}
+		}
+		s.endGroup();
+	}
+
+	return transcoded;
 }
 
 
@@ -240,6 +342,22 @@ void Material::setFilterAnisotropy( float anisotropy )
 }
 
 
+GLuint Material::placeholderTexture()
+{
+	if( !sPlaceholderTexture )
+	{
+		const GLubyte grey[4] = { 128, 128, 128, 255 };
+		glGenTextures( 1, &sPlaceholderTexture );
+		glBindTexture( GL_TEXTURE_2D, sPlaceholderTexture );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+	}
+	return sPlaceholderTexture;
+}
+
+
 Material::Material( GLWidget * glWidget, QString name, MaterialShaderVariant::Type variant ) : AResource()
 {
 	mGLWidget = glWidget;
@@ -249,15 +367,25 @@ Material::Material( GLWidget * glWidget, QString name, MaterialShaderVariant::Ty
 	mShaderSet[MaterialQuality::LOW].shader = 0;
 	mShaderSet[MaterialQuality::LOW].blobMapUniform = -1;
 	mShaderSet[MaterialQuality::LOW].cubeMapUniform = -1;
+	mShaderSet[MaterialQuality::LOW].lightGridUniform = -1;
+	mShaderSet[MaterialQuality::LOW].shadowUniform = -1;
 	mShaderSet[MaterialQuality::MEDIUM].textureUnits.clear();
 	mShaderSet[MaterialQuality::MEDIUM].shader = 0;
 	mShaderSet[MaterialQuality::MEDIUM].blobMapUniform = -1;
 	mShaderSet[MaterialQuality::MEDIUM].cubeMapUniform = -1;
+	mShaderSet[MaterialQuality::MEDIUM].lightGridUniform = -1;
+	mShaderSet[MaterialQuality::MEDIUM].shadowUniform = -1;
 	mShaderSet[MaterialQuality::HIGH].textureUnits.clear();
 	mShaderSet[MaterialQuality::HIGH].shader = 0;
 	mShaderSet[MaterialQuality::HIGH].blobMapUniform = -1;
 	mShaderSet[MaterialQuality::HIGH].cubeMapUniform = -1;
+	mShaderSet[MaterialQuality::HIGH].lightGridUniform = -1;
+	mShaderSet[MaterialQuality::HIGH].shadowUniform = -1;
 	mBlobMap = mCubeMap = -1;
+	mVariant = variant;
+	mShaderSetsReady = false;
+	mBoundPlaceholder = false;
+	mBoundDepthOnly = false;
 
 	QSharedPointer<MaterialData> n( new MaterialData( glWidget, name ) );
 	cache( n );
@@ -291,6 +419,21 @@ MaterialQuality::Type Material::getBindingQuality()
 
 void Material::bind()
 {
+	mBoundPlaceholder = false;
+	if( !mShaderSetsReady )
+	{
+		if( !data()->loaded() )
+		{
+			mBoundPlaceholder = true;
+			glPushAttrib( GL_LIGHTING_BIT | GL_ENABLE_BIT | GL_TEXTURE_BIT );
+			glActiveTexture( GL_TEXTURE0 );
+			glEnable( GL_TEXTURE_2D );
+			glBindTexture( GL_TEXTURE_2D, placeholderTexture() );
+			return;
+		}
+		setShader( mVariant );
+	}
+
 	mBoundQuality = getBindingQuality();
 
 	if( !mShaderSet[mBoundQuality].shader )
@@ -344,11 +487,23 @@ void Material::bind()
 		mShaderSet[mBoundQuality].shader->program()->setUniformValue( mShaderSet[mBoundQuality].blobMapUniform, texUnit );
 		texUnit++;
 	}
+
+	if( mShaderSet[mBoundQuality].lightGridUniform >= 0 )
+		texUnit = LightGrid::bindCurrent( mShaderSet[mBoundQuality].shader->program(), texUnit );
+	if( mShaderSet[mBoundQuality].shadowUniform >= 0 )
+		texUnit = ShadowMap::bindCurrent( mShaderSet[mBoundQuality].shader->program(), texUnit );
 }
 
 
 void Material::release()
 {
+	if( mBoundPlaceholder )
+	{
+		glPopAttrib();
+		mBoundPlaceholder = false;
+		return;
+	}
+
 	if( !mShaderSet[mBoundQuality].shader )
 		return;
 
@@ -359,12 +514,37 @@ void Material::release()
 }
 
 
+void Material::bindDepthOnly()
+{
+	mBoundDepthOnly = data()->loaded() && data()->alphaTestEnabled() && data()->textures().contains( "diffuseMap" );
+	if( !mBoundDepthOnly )
+		return;
+
+	glPushAttrib( GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT | GL_TEXTURE_BIT );
+	glAlphaFunc( data()->alphaTestFunction(), data()->alphaTestReferenceValue() );
+	glEnable( GL_ALPHA_TEST );
+	glActiveTexture( GL_TEXTURE0 );
+	glEnable( GL_TEXTURE_2D );
+	glBindTexture( GL_TEXTURE_2D, data()->textures().value( "diffuseMap" ) );
+	glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE );
+}
+
+
+void Material::releaseDepthOnly()
+{
+	if( !mBoundDepthOnly )
+		return;
+	glPopAttrib();
+	mBoundDepthOnly = false;
+}
+
+
 void Material::setShader( MaterialQuality::Type quality, QString shaderFullName )
 {
 	delete mShaderSet[quality].shader;
 	mShaderSet[quality].shader = 0;
 
-	if( access( QString(ShaderData::baseDirectory()+shaderFullName+".vert").toLocal8Bit().constData(), R_OK ) != 0 )
+	if( !ShaderData::exists( shaderFullName ) )
 		return;
 
 	mShaderSet[quality].shader = new Shader( mGLWidget, shaderFullName );
@@ -403,11 +583,60 @@ void Material::setShader( MaterialQuality::Type quality, QString shaderFullName
 
 	mShaderSet[quality].blobMapUniform = mShaderSet[quality].shader->program()->uniformLocation( "blobMap" );
 	mShaderSet[quality].cubeMapUniform = mShaderSet[quality].shader->program()->uniformLocation( "cubeMap" );
+	mShaderSet[quality].lightGridUniform = mShaderSet[quality].shader->program()->uniformLocation( "lightGridEnabled" );
+	mShaderSet[quality].shadowUniform = mShaderSet[quality].shader->program()->uniformLocation( "shadowEnabled" );
+}
+
+
+int Material::precompileShaders( GLWidget * glWidget )
+{
+	static const char * variantSuffixes[MaterialShaderVariant::num] = { ".default", ".blobbing", ".billboard" };
+	static const char * qualityKeys[MaterialQuality::num] = { "low", "medium", "high" };
+
+	QSet<QString> shaderNames;
+	QDir materialDir( MaterialData::baseDirectory() );
+	QStringList materials = materialDir.entryList( QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name );
+	foreach( const QString & name, materials )
+	{
+		QString iniPath = MaterialData::baseDirectory()+name+"/material.ini";
+		if( !QFile::exists( iniPath ) )
+			continue;
+
+		QSettings s( iniPath, QSettings::IniFormat );
+		s.beginGroup( "Shader" );
+		for( int q = 0; q < MaterialQuality::num; ++q )
+		{
+			QString shaderName = s.value( qualityKeys[q], "simple" ).toString();
+			for( int v = 0; v < MaterialShaderVariant::num; ++v )
+			{
+				if( ShaderData::exists( shaderName+variantSuffixes[v] ) )
+					shaderNames.insert( shaderName+variantSuffixes[v] );
+			}
+		}
+		s.endGroup();
+	}
+
+	// unreferenced shader data uses no cache budget, so the compiled programs stay cached for the materials
+	foreach( const QString & shaderName, shaderNames )
+	{
+		Shader shader( glWidget, shaderName );
+	}
+
+	return shaderNames.size();
 }
 
 
 void Material::setShader( MaterialShaderVariant::Type variant )
 {
+	mVariant = variant;
+	// shaders of materials still loading in background are set up on first bind
+	if( !data()->loaded() )
+	{
+		mShaderSetsReady = false;
+		return;
+	}
+	mShaderSetsReady = true;
+
 	switch( variant )
 	{
 		case MaterialShaderVariant::BLOBBING:
@@ -415,6 +644,13 @@ void Material::setShader( MaterialShaderVariant::Type variant )
 			setShader( MaterialQuality::MEDIUM, data()->shaderName(MaterialQuality::MEDIUM)+".blobbing" );
 			setShader( MaterialQuality::HIGH, data()->shaderName(MaterialQuality::HIGH)+".blobbing" );
 			break;
+		case MaterialShaderVariant::BILLBOARD:
+			for( int q = 0; q < MaterialQuality::num; ++q )
+			{
+				QString shaderName = data()->shaderName( (MaterialQuality::Type)q );
+				setShader( (MaterialQuality::Type)q, shaderName + ( ShaderData::exists( shaderName+".billboard" ) ? ".billboard" : ".default" ) );
+			}
+			break;
 		default:
 		case MaterialShaderVariant::DEFAULT:
 			setShader( MaterialQuality::LOW, data()->shaderName(MaterialQuality::LOW)+".default" );
@@ -25,10 +25,12 @@
 #define RESOURCE_MATERIAL_INCLUDED
 
 #include "AResource.hpp"
+#include "CompressedTexture.hpp"
 
 #include <GLWidget.hpp>
 
 #include <QVector4D>
+#include <QImage>
 
 
 class GLWidget;
@@ -65,9 +67,10 @@ namespace MaterialShaderVariant
 	enum Type
 	{
 		DEFAULT		= 0,
-		BLOBBING	= 1
+		BLOBBING	= 1,
+		BILLBOARD	= 2	///< Expands particle billboards in the vertex shader - falls back to DEFAULT if not available
 	};
-	const static int num = 2;
+	const static int num = 3;
 };
 
 
@@ -93,15 +96,33 @@ public:
 	const bool & alphaTestEnabled() const { return mAlphaTestEnabled; }
 
 	// Overrides:
-	virtual bool load();
+	virtual bool asyncCapable() const { return true; }
+	virtual qint64 memoryUsage() const { return mMemoryUsage; }
+	virtual bool decode();
+	virtual bool upload();
 	virtual void unload();
 
 	static QString baseDirectory() { return AResourceData::baseDirectory()+"material/"; }
 
+	/// Transcodes all material textures to DDS files which are preferred when loading materials
+	/**
+	 * Textures with an up to date DDS file are skipped.
+	 * @param compress Uses S3TC compression if true, uncompressed RGBA8 otherwise.
+	 * @return Number of transcoded textures.
+	 */
+	static int transcodeTextures( bool compress = true );
+
 private:
 	GLWidget * mGLWidget;
 	QString mName;
 
+	GLint mWrapS;
+	GLint mWrapT;
+	bool mMipmap;
+	QMap<QString,QImage> mImages;
+	QMap<QString,CompressedTexture> mCompressedImages;
+	qint64 mMemoryUsage;
+
 	QString mShaderNames[MaterialQuality::num];
 
 	QVector4D mAmbient;
@@ -138,12 +159,25 @@ public:
 	void bind();
 	void release();
 
+	/// Binds only what decides the coverage of depth only passes - the diffuse map's alpha if the material is alpha tested
+	void bindDepthOnly();
+	void releaseDepthOnly();
+
 	void setDefaultQuality( MaterialQuality::Type q ) { mDefaultQuality = q; }
 
 	static float filterAnisotropyMaximum() { GLfloat maxAnisotropy; glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy ); return maxAnisotropy; }
 	static void setFilterAnisotropy( float maxAnisotropy );
 	static float filterAnisotropy() { return sFilterAnisotropy; }
 
+	static GLuint placeholderTexture();
+
+	/// Compiles the shaders of all quality levels and variants used by any material
+	/**
+	 * Should be called while loading, so no shader needs to be compiled when a material is first created in game.
+	 * @return Number of shader programs.
+	 */
+	static int precompileShaders( GLWidget * glWidget );
+
 private:
 	typedef struct
 	{
@@ -152,6 +186,8 @@ private:
 		QVector< QPair<int,GLfloat> > constants;
 		int blobMapUniform;
 		int cubeMapUniform;
+		int lightGridUniform;
+		int shadowUniform;
 	} ShaderSet;
 
 	GLWidget * mGLWidget;
@@ -164,6 +200,10 @@ private:
 	const GLclampf * mUsedAlphaTestReferenceValue;
 
 	ShaderSet mShaderSet[MaterialQuality::num];
+	MaterialShaderVariant::Type mVariant;
+	bool mShaderSetsReady;
+	bool mBoundPlaceholder;
+	bool mBoundDepthOnly;
 	MaterialQuality::Type mDefaultQuality;
 	MaterialQuality::Type mBoundQuality;
 
@@ -171,6 +211,7 @@ private:
 	void setShader( MaterialQuality::Type quality, QString shaderFullName );
 
 	static float sFilterAnisotropy;
+	static GLuint sPlaceholderTexture;
 };
 
 
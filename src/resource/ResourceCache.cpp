@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceCache.hpp"
+
+#include <QDebug>
+
+
+QList<ResourceCache::Entry> & ResourceCache::entries()
+{
+	// constructed on first use, as registrations happen during static initialization
+	static QList<Entry> sEntries;
+	return sEntries;
+}
+
+
+ResourceCache::Registration::Registration( const char * typeName, DumpFunction dump, ClearFunction clear )
+{
+	Entry entry;
+	entry.typeName = typeName;
+	entry.dump = dump;
+	entry.clear = clear;
+	ResourceCache::entries().append( entry );
+}
+
+
+void ResourceCache::dump()
+{
+	qDebug( "* Resource caches:" );
+	foreach( const Entry & entry, entries() )
+		entry.dump( entry.typeName );
+}
+
+
+void ResourceCache::clear()
+{
+	// releasing data may release other resources (e.g. a model's materials), so repeat until nothing is left
+	int released;
+	do {
+		released = 0;
+		foreach( const Entry & entry, entries() )
+			released += entry.clear();
+	} while( released > 0 );
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCE_RESOURCECACHE_INCLUDED
+#define RESOURCE_RESOURCECACHE_INCLUDED
+
+
+#include <QList>
+
+
+/// Registry of all resource caches
+/**
+ * Every resource type defined using RESOURCE_CACHE registers its cache here,
+ * so all caches can be dumped or cleared at once without knowing the types.
+ */
+class ResourceCache
+{
+	ResourceCache() {}
+	~ResourceCache() {}
+public:
+	typedef void (*DumpFunction)( const char * typeName );
+	typedef int (*ClearFunction)();
+
+	/// Registers a resource cache on construction - used by RESOURCE_CACHE
+	class Registration
+	{
+	public:
+		Registration( const char * typeName, DumpFunction dump, ClearFunction clear );
+	};
+
+	/// Writes the contents of all caches to the debug output
+	static void dump();
+
+	/// Releases all unreferenced data of all caches - must be called while the contexts are still valid
+	static void clear();
+
+private:
+	typedef struct
+	{
+		const char * typeName;
+		DumpFunction dump;
+		ClearFunction clear;
+	} Entry;
+
+	static QList<Entry> & entries();
+};
+
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ResourceLoader.hpp"
+
+#include "AResource.hpp"
+
+#include <QThreadPool>
+#include <QThread>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+
+
+bool ResourceLoader::sEnabled = true;
+int ResourceLoader::sUploadBudget = 4;
+int ResourceLoader::sPending = 0;
+QThreadPool * ResourceLoader::sPool = 0;
+QMutex ResourceLoader::sDecodedMutex;
+QQueue< QSharedPointer<AResourceData> > ResourceLoader::sDecoded;
+
+
+/// Decodes one resource on a worker thread and hands it back to the render thread
+class ResourceLoader::DecodeTask : public QRunnable
+{
+public:
+	DecodeTask( const QSharedPointer<AResourceData> & data ) : mData( data ) {}
+
+	virtual void run() { ResourceLoader::decode( mData ); }
+
+private:
+	QSharedPointer<AResourceData> mData;
+};
+
+
+void ResourceLoader::decode( QSharedPointer<AResourceData> & data )
+{
+	data->mDecodeFailed = !data->decode();
+	QMutexLocker locker( &sDecodedMutex );
+	sDecoded.enqueue( data );
+	// drop the worker's reference while locked, so the last reference is never released outside the render thread
+	data.clear();
+}
+
+
+QThreadPool * ResourceLoader::pool()
+{
+	if( !sPool )
+	{
+		sPool = new QThreadPool();
+		sPool->setMaxThreadCount( qMax( 1, QThread::idealThreadCount()-1 ) );
+	}
+	return sPool;
+}
+
+
+int ResourceLoader::workerThreads()
+{
+	return pool()->maxThreadCount();
+}
+
+
+void ResourceLoader::setWorkerThreads( int num )
+{
+	pool()->setMaxThreadCount( qMax( 1, num ) );
+}
+
+
+void ResourceLoader::enqueue( const QSharedPointer<AResourceData> & data )
+{
+	if( data->mPending )
+		return;
+	data->unload();
+	data->mPending = true;
+	sPending++;
+	pool()->start( new DecodeTask( data ) );
+}
+
+
+int ResourceLoader::processUploads()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	int uploaded = 0;
+	do {
+		QSharedPointer<AResourceData> data;
+		{
+			QMutexLocker locker( &sDecodedMutex );
+			if( sDecoded.isEmpty() )
+				break;
+			data = sDecoded.dequeue();
+		}
+
+		if( data->mDecodeFailed || !data->upload() )
+			qCritical() << "!!" << data.data() << "ResourceLoader" << data->uid() << "could not be loaded";
+		data->mPending = false;
+		sPending--;
+		uploaded++;
+	} while( timer.elapsed() < sUploadBudget );
+
+	return uploaded;
+}
+
+
+void ResourceLoader::finish()
+{
+	while( sPending > 0 )
+	{
+		if( !processUploads() )
+			pool()->waitForDone();
+	}
+}
+
+
+int ResourceLoader::pending()
+{
+	return sPending;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCE_RESOURCELOADER_INCLUDED
+#define RESOURCE_RESOURCELOADER_INCLUDED
+
+
+#include <QSharedPointer>
+#include <QQueue>
+#include <QMutex>
+
+
+class QThreadPool;
+class AResourceData;
+
+
+/// Asynchronous loader for resource data
+/**
+ * Resource data is decoded by a pool of worker threads (file I/O, image and audio decoding, parsing).\n
+ * Everything that needs the OpenGL or OpenAL context is queued back and uploaded by processUploads(),
+ * which is called once per frame by the render thread using a time budget.
+ * Resources stay pending (and draw using placeholders) until their upload is done.
+ */
+class ResourceLoader
+{
+	ResourceLoader() {}
+	~ResourceLoader() {}
+public:
+	/// Returns true if resources capable of asynchronous loading are decoded in background
+	static bool enabled() { return sEnabled; }
+	/// Enables or disables asynchronous loading - disabled loading decodes and uploads immediately
+	static void setEnabled( bool enable ) { sEnabled = enable; }
+
+	/// Returns the maximum number of worker threads used for decoding
+	static int workerThreads();
+	/// Sets the maximum number of worker threads used for decoding
+	static void setWorkerThreads( int num );
+
+	/// Returns the time in milliseconds the render thread may spend on uploads per frame
+	static int uploadBudget() { return sUploadBudget; }
+	/// Sets the time in milliseconds the render thread may spend on uploads per frame
+	static void setUploadBudget( int msecs ) { sUploadBudget = msecs; }
+
+	/// Queues the given data for decoding by a worker thread
+	static void enqueue( const QSharedPointer<AResourceData> & data );
+
+	/// Uploads decoded data until the upload budget is exhausted - must be called from the render thread
+	/**
+	 * At least one decoded resource is uploaded per call, so loading always progresses.
+	 * @return Number of resources uploaded.
+	 */
+	static int processUploads();
+
+	/// Blocks until all queued data is decoded and uploaded - must be called from the render thread
+	static void finish();
+
+	/// Returns the number of resources which are queued but not uploaded yet
+	static int pending();
+
+private:
+	class DecodeTask;
+
+	static QThreadPool * pool();
+	static void decode( QSharedPointer<AResourceData> & data );
+
+	static bool sEnabled;
+	static int sUploadBudget;
+	static int sPending;
+	static QThreadPool * sPool;
+	static QMutex sDecodedMutex;
+	static QQueue< QSharedPointer<AResourceData> > sDecoded;
+};
+
+
+#endif
@@ -22,15 +22,20 @@
  */
 
 #include "Shader.hpp"
+#include "ShaderBinaryCache.hpp"
 
 #include <GLWidget.hpp>
 
 #include <QGLShaderProgram>
+#include <QFile>
 #include <QDebug>
 
 
 RESOURCE_CACHE(ShaderData);
 
+QHash<QString,bool> ShaderData::sExists;
+QGLShaderProgram * Shader::sPlaceholderProgram = 0;
+
 
 ShaderData::ShaderData( GLWidget * glWidget, QString name ) :
 	AResourceData( name ),
@@ -60,21 +65,92 @@ void ShaderData::unload()
 }
 
 
-bool ShaderData::load()
+bool ShaderData::upload()
 {
-	unload();
-	qDebug() << "+" << this << "ShaderData" << uid();
+	delete mProgram;
+	mProgram = 0;
+
+	QFile vertexFile( baseDirectory()+mName+".vert" );
+	QFile fragmentFile( baseDirectory()+mName+".frag" );
+	if( !vertexFile.open( QIODevice::ReadOnly ) || !fragmentFile.open( QIODevice::ReadOnly ) )
+	{
+		qWarning() << "!" << this << "ShaderData" << uid() << "source not found";
+		return false;
+	}
+	QByteArray vertexSource = resolveIncludes( vertexFile.readAll() );
+	QByteArray fragmentSource = resolveIncludes( fragmentFile.readAll() );
 
 	mProgram = new QGLShaderProgram( mGLWidget );
-	mProgram->addShaderFromSourceFile( QGLShader::Vertex, baseDirectory()+mName+".vert" );
-	mProgram->addShaderFromSourceFile( QGLShader::Fragment, baseDirectory()+mName+".frag" );
+
+	QByteArray binaryKey;
+	if( ShaderBinaryCache::enabled() )
+	{
+		binaryKey = ShaderBinaryCache::key( vertexSource, fragmentSource );
+		// a program without attached shaders is taken as is by link() if the binary was accepted
+		if( ShaderBinaryCache::load( mProgram->programId(), mName, binaryKey ) && mProgram->link() )
+		{
+			qDebug() << "+" << this << "ShaderData" << uid() << "(cached binary)";
+			return AResourceData::upload();
+		}
+		ShaderBinaryCache::prepare( mProgram->programId() );
+	}
+
+	qDebug() << "+" << this << "ShaderData" << uid();
+
+	mProgram->addShaderFromSourceCode( QGLShader::Vertex, vertexSource );
+	mProgram->addShaderFromSourceCode( QGLShader::Fragment, fragmentSource );
 	if( !mProgram->link() )
 	{
 		qWarning() << mProgram->log();
+		delete mProgram;
+		mProgram = 0;
 		return false;
 	}
 
-	return AResourceData::load();
+	if( !binaryKey.isEmpty() )
+		ShaderBinaryCache::save( mProgram->programId(), mName, binaryKey );
+
+	return AResourceData::upload();
+}
+
+
+QByteArray ShaderData::resolveIncludes( const QByteArray & source )
+{
+	if( !source.contains( "#include" ) )
+		return source;
+
+	QByteArray resolved;
+	QList<QByteArray> lines = source.split( '\n' );
+	foreach( const QByteArray & line, lines )
+	{
+		QByteArray trimmed = line.trimmed();
+		if( !trimmed.startsWith( "#include" ) )
+		{
+			resolved += line + '\n';
+			continue;
+		}
+		QByteArray name = trimmed.mid( 8 ).trimmed();
+		name = name.mid( 1, name.size()-2 );	// strip the quotes
+		QFile includeFile( baseDirectory()+name );
+		if( !includeFile.open( QIODevice::ReadOnly ) )
+		{
+			qWarning() << "!" << "ShaderData" << "include" << name << "not found";
+			continue;
+		}
+		resolved += includeFile.readAll() + '\n';
+	}
+	return resolved;
+}
+
+
+bool ShaderData::exists( const QString & name )
+{
+	QHash<QString,bool>::const_iterator i = sExists.constFind( name );
+	if( i != sExists.constEnd() )
+		return i.value();
+	bool found = QFile::exists( baseDirectory()+name+".vert" ) && QFile::exists( baseDirectory()+name+".frag" );
+	sExists.insert( name, found );
+	return found;
 }
 
 
@@ -90,13 +166,23 @@ Shader::~Shader()
 }
 
 
+QGLShaderProgram * Shader::placeholderProgram()
+{
+	if( !sPlaceholderProgram )
+		sPlaceholderProgram = new QGLShaderProgram();
+	return sPlaceholderProgram;
+}
+
+
 void Shader::bind()
 {
-	data()->program()->bind();
+	if( data()->loaded() )
+		data()->program()->bind();
 }
 
 
 void Shader::release()
 {
-	data()->program()->release();
+	if( data()->loaded() )
+		data()->program()->release();
 }
@@ -29,6 +29,7 @@
 
 #include <GLWidget.hpp>
 
+#include <QHash>
 #include <QDebug>
 
 
@@ -48,16 +49,24 @@ public:
 	const QString & name() const { return mName; }
 
 	// Overrides:
-	virtual bool load();
+	virtual bool upload();
 	virtual void unload();
 
 	static QString baseDirectory() { return AResourceData::baseDirectory()+"shader/"; }
 
+	/// Returns true if the sources of the given shader exist - the result is remembered to avoid repeated file system lookups
+	static bool exists( const QString & name );
+
+	/// Replaces lines of the form #include "file" by the file's content from the shader directory
+	static QByteArray resolveIncludes( const QByteArray & source );
+
 private:
 	GLWidget * mGLWidget;
 	QString mName;
 
 	QGLShaderProgram * mProgram;
+
+	static QHash<QString,bool> sExists;
 };
 
 
@@ -68,10 +77,16 @@ public:
 	Shader( GLWidget * glWidget, QString name );
 	virtual ~Shader();
 
-	QGLShaderProgram * program() { return data()->program(); }
+	/// Returns the program - an empty placeholder if the shader could not be loaded, so setting uniforms does nothing
+	QGLShaderProgram * program() { return data()->loaded() ? data()->program() : placeholderProgram(); }
 
+	/// Binds the program - the bound program is left unchanged if the shader could not be loaded
 	void bind();
 	void release();
+
+private:
+	static QGLShaderProgram * placeholderProgram();
+	static QGLShaderProgram * sPlaceholderProgram;
 };
 
 
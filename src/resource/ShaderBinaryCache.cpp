@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ShaderBinaryCache.hpp"
+
+#include <QDesktopServices>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+
+bool ShaderBinaryCache::sEnabled = true;
+const quint32 ShaderBinaryCache::sMagic = 0x55755342;	// "UuSB"
+const quint32 ShaderBinaryCache::sVersion = 1;
+
+
+bool ShaderBinaryCache::supported()
+{
+	if( !GLEW_ARB_get_program_binary )
+		return false;
+	GLint formats = 0;
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+	return formats > 0;
+}
+
+
+QString ShaderBinaryCache::directory()
+{
+	return QDesktopServices::storageLocation( QDesktopServices::CacheLocation ) + "/shader/";
+}
+
+
+QByteArray ShaderBinaryCache::key( const QByteArray & vertexSource, const QByteArray & fragmentSource )
+{
+	QCryptographicHash hash( QCryptographicHash::Sha1 );
+	hash.addData( vertexSource );
+	hash.addData( "\0", 1 );
+	hash.addData( fragmentSource );
+	hash.addData( "\0", 1 );
+	hash.addData( reinterpret_cast<const char*>( glGetString( GL_VENDOR ) ) );
+	hash.addData( reinterpret_cast<const char*>( glGetString( GL_RENDERER ) ) );
+	hash.addData( reinterpret_cast<const char*>( glGetString( GL_VERSION ) ) );
+	return hash.result().toHex();
+}
+
+
+bool ShaderBinaryCache::load( GLuint program, const QString & name, const QByteArray & key )
+{
+	QFile file( directory() + name + ".bin" );
+	if( !file.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QDataStream stream( &file );
+	stream.setVersion( QDataStream::Qt_4_6 );
+	quint32 magic, version, format;
+	QByteArray storedKey, binary;
+	stream >> magic >> version >> storedKey >> format >> binary;
+	if( stream.status() != QDataStream::Ok || magic != sMagic || version != sVersion || storedKey != key )
+		return false;	// outdated - will be replaced after linking from source
+
+	glProgramBinary( program, format, binary.constData(), binary.size() );
+	GLint linked = GL_FALSE;
+	glGetProgramiv( program, GL_LINK_STATUS, &linked );
+	if( linked != GL_TRUE )
+	{
+		qWarning() << "! Cached shader binary" << file.fileName() << "rejected by driver";
+		return false;
+	}
+	return true;
+}
+
+
+void ShaderBinaryCache::prepare( GLuint program )
+{
+	glProgramParameteri( program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+}
+
+
+bool ShaderBinaryCache::save( GLuint program, const QString & name, const QByteArray & key )
+{
+	GLint length = 0;
+	glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+	if( length <= 0 )
+		return false;
+
+	QByteArray binary( length, 0 );
+	GLenum format = 0;
+	glGetProgramBinary( program, length, &length, &format, binary.data() );
+	binary.resize( length );
+
+	if( !QDir().mkpath( directory() ) )
+		return false;
+	QFile file( directory() + name + ".bin" );
+	if( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+	{
+		qWarning() << "! Could not write shader binary" << file.fileName();
+		return false;
+	}
+
+	QDataStream stream( &file );
+	stream.setVersion( QDataStream::Qt_4_6 );
+	stream << sMagic << sVersion << key << (quint32)format << binary;
+	return stream.status() == QDataStream::Ok;
+}
+
+
+int ShaderBinaryCache::clear()
+{
+	QDir dir( directory() );
+	QStringList files = dir.entryList( QStringList( "*.bin" ), QDir::Files );
+	int removed = 0;
+	foreach( const QString & file, files )
+	{
+		if( dir.remove( file ) )
+			++removed;
+	}
+	return removed;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCE_SHADERBINARYCACHE_INCLUDED
+#define RESOURCE_SHADERBINARYCACHE_INCLUDED
+
+
+#include <GLWidget.hpp>
+
+#include <QString>
+#include <QByteArray>
+
+
+/// Persistent cache for linked shader program binaries
+/**
+ * Uses GL_ARB_get_program_binary to store linked programs on disk, so they do not need to be compiled on the next run.\n
+ * Each cached binary is keyed on a hash of the program's source code and the driver's vendor, renderer and version,
+ * so any change to the shader or the driver invalidates it.
+ */
+class ShaderBinaryCache
+{
+	ShaderBinaryCache() {}
+	~ShaderBinaryCache() {}
+public:
+	/// Returns true if program binaries are loaded from and stored to the cache
+	static bool enabled() { return sEnabled && supported(); }
+	/// Enables or disables the cache
+	static void setEnabled( bool enable ) { sEnabled = enable; }
+
+	/// Returns true if the driver supports retrieving program binaries - requires a current context
+	static bool supported();
+
+	/// Returns the directory containing the cached binaries
+	static QString directory();
+
+	/// Returns the cache key for the given program sources - requires a current context
+	static QByteArray key( const QByteArray & vertexSource, const QByteArray & fragmentSource );
+
+	/// Loads a cached binary into the given (empty) program object
+	/**
+	 * @return True if a binary matching the key was found and accepted by the driver.
+	 */
+	static bool load( GLuint program, const QString & name, const QByteArray & key );
+
+	/// Marks the given program object as retrievable - must be called before linking
+	static void prepare( GLuint program );
+
+	/// Stores the binary of the given linked program object
+	static bool save( GLuint program, const QString & name, const QByteArray & key );
+
+	/// Removes all cached binaries
+	/**
+	 * @return Number of removed files.
+	 */
+	static int clear();
+
+private:
+	static bool sEnabled;
+	static const quint32 sMagic;
+	static const quint32 sVersion;
+};
+
+
+#endif
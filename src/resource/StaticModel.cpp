@@ -64,14 +64,12 @@ Face::Face( QStringList &fields, QString &material, QVector<QVector3D> *position
 }
 
 
-Part::Part( unsigned int current, unsigned int count, GLWidget * widget, QString & material )
+Part::Part( unsigned int current, unsigned int count, const QString & material )
 {
 	this->start = current - count;
 	this->count = count;
-	if( !material.isEmpty() )
-		this->material = new Material( widget, material );
-	else
-		this->material = NULL;
+	this->materialName = material;
+	this->material = NULL;
 }
 
 
@@ -84,6 +82,7 @@ StaticModelData::StaticModelData( GLWidget * glWidget, QString name ) :
 	mName( name )
 {
 	mMode = 0;
+	mMemoryUsage = 0;
 }
 
 
@@ -117,18 +116,36 @@ void StaticModelData::unload()
 	mIndexBuffer.release();
 	mIndexBuffer.destroy();
 
+	mMemoryUsage = 0;
+
 	AResourceData::unload();
 }
 
 
-bool StaticModelData::load()
+bool StaticModelData::decode()
+{
+	mMode = 0;
+	mParts.clear();
+	mVertices.clear();
+	mIndices.clear();
+
+	return parse();
+}
+
+
+bool StaticModelData::upload()
 {
-	unload();
 	qDebug() << "+" << this << "StaticModelData" << uid();
 
-	parse();
+	for( int i = 0; i < mParts.size(); ++i )
+	{
+		if( !mParts[i].materialName.isEmpty() )
+			mParts[i].material = new Material( mGLWidget, mParts[i].materialName );
+	}
+
+	generateBuffers();
 
-	return AResourceData::load();
+	return AResourceData::upload();
 }
 
 
@@ -213,7 +230,6 @@ bool StaticModelData::parse()
 	file.close();
 
 	generateParts( & faces );
-	generateBuffers();
 
 	return true;
 }
@@ -234,6 +250,8 @@ void StaticModelData::generateBuffers()
 	mIndexBuffer.setUsagePattern( QGLBuffer::StaticDraw );
 	mIndexBuffer.allocate( mIndices.constData(), mIndices.size() * sizeof( unsigned int ) );
 	mIndexBuffer.release();
+
+	mMemoryUsage = mVertices.size() * sizeof( VertexP3fN3fT2f ) + mIndices.size() * sizeof( unsigned int );
 }
 
 
@@ -270,7 +288,7 @@ void StaticModelData::generateParts( QVector<Face> * faces)
 
 		if( face.material != lastMat )
 		{
-			mParts.append( Part( current, count, mGLWidget, lastMat ) );
+			mParts.append( Part( current, count, lastMat ) );
 
 			lastMat = face.material;
 			count = 0;
@@ -291,7 +309,7 @@ void StaticModelData::generateParts( QVector<Face> * faces)
 		faceCount++;
 	}
 
-	mParts.append( Part( current, count, mGLWidget, faces->last().material ) );
+	mParts.append( Part( current, count, faces->last().material ) );
 }
 
 
@@ -323,8 +341,12 @@ StaticModel::~StaticModel()
 {
 }
 
-void StaticModel::draw( const QMatrix4x4 & viewMatrix, const QVector<QMatrix4x4> & instances )
+void StaticModel::draw( const QMatrix4x4 & viewMatrix, const QVector<QMatrix4x4> & instances, bool depthOnly )
 {
+	// models still loading in background are not drawn
+	if( !data()->loaded() )
+		return;
+
 	data()->vertexBuffer().bind();
 	data()->indexBuffer().bind();
 
@@ -338,7 +360,10 @@ void StaticModel::draw( const QMatrix4x4 & viewMatrix, const QVector<QMatrix4x4>
 	{
 		if( part.material )
 		{
-			part.material->bind();
+			if( depthOnly )
+				part.material->bindDepthOnly();
+			else
+				part.material->bind();
 		}
 
 		foreach( const QMatrix4x4 & instance, instances )
@@ -357,7 +382,10 @@ void StaticModel::draw( const QMatrix4x4 & viewMatrix, const QVector<QMatrix4x4>
 
 		if( part.material )
 		{
-			part.material->release();
+			if( depthOnly )
+				part.material->releaseDepthOnly();
+			else
+				part.material->release();
 		}
 	}
 
@@ -371,8 +399,11 @@ void StaticModel::draw( const QMatrix4x4 & viewMatrix, const QVector<QMatrix4x4>
 }
 
 
-void StaticModel::draw()
+void StaticModel::draw( bool depthOnly )
 {
+	if( !data()->loaded() )
+		return;
+
 	data()->vertexBuffer().bind();
 	data()->indexBuffer().bind();
 
@@ -386,7 +417,10 @@ void StaticModel::draw()
 	{
 		if( part.material )
 		{
-			part.material->bind();
+			if( depthOnly )
+				part.material->bindDepthOnly();
+			else
+				part.material->bind();
 		}
 
 		glDrawElements(
@@ -400,7 +434,10 @@ void StaticModel::draw()
 
 		if( part.material )
 		{
-			part.material->release();
+			if( depthOnly )
+				part.material->releaseDepthOnly();
+			else
+				part.material->release();
 		}
 	}
 
@@ -69,10 +69,11 @@ class Part
 {
 public:
 	Part() {}
-	Part( unsigned int current, unsigned int count, GLWidget * widget, QString & material );
+	Part( unsigned int current, unsigned int count, const QString & material );
 
 	unsigned int start;
 	unsigned int count;
+	QString materialName;
 	Material * material;
 };
 
@@ -92,7 +93,10 @@ public:
 	bool parse();
 
 	// Overrides:
-	virtual bool load();
+	virtual bool asyncCapable() const { return true; }
+	virtual qint64 memoryUsage() const { return mMemoryUsage; }
+	virtual bool decode();
+	virtual bool upload();
 	virtual void unload();
 
 	static QString baseDirectory() { return AResourceData::baseDirectory()+"model/"; }
@@ -106,6 +110,7 @@ protected:
 	QVector<unsigned int> mIndices;
 	QGLBuffer mVertexBuffer;
 	QGLBuffer mIndexBuffer;
+	qint64 mMemoryUsage;
 
 	void generateParts( QVector<Face> * faces );
 	void generateBuffers();
@@ -120,8 +125,10 @@ public:
 	StaticModel( GLWidget * glWidget, QString name );
 	virtual ~StaticModel();
 
-	void draw( const QMatrix4x4 & viewMatrix, const QVector<QMatrix4x4> & instances );
-	void draw();
+	/// Draws the model once per instance - binds only the materials' alpha test if depthOnly is set
+	void draw( const QMatrix4x4 & viewMatrix, const QVector<QMatrix4x4> & instances, bool depthOnly = false );
+	/// Draws the model - binds only the materials' alpha test if depthOnly is set
+	void draw( bool depthOnly = false );
 };
 
 
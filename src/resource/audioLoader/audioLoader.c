@@ -33,14 +33,31 @@
 #include <stdlib.h>
 
 
-int audioLoader( const char * filename, ALuint * buffer, ALsizei * frequency, ALenum * format )
+int audioDecoder( const char * filename, void ** data, ALsizei * size, ALsizei * frequency, ALenum * format )
 {
 	int ret = 0;
 
-	ret = audioLoader_riffWave( filename, buffer, frequency, format );
+	ret = audioDecoder_riffWave( filename, data, size, frequency, format );
 	if( ret == 0 )
 		return ret;
 
-	ret = audioLoader_oggVorbis( filename, buffer, frequency, format );
+	ret = audioDecoder_oggVorbis( filename, data, size, frequency, format );
 	return ret;
 }
+
+
+int audioLoader( const char * filename, ALuint * buffer, ALsizei * frequency, ALenum * format )
+{
+	void * data = 0;
+	ALsizei size = 0;
+
+	int ret = audioDecoder( filename, &data, &size, frequency, format );
+	if( ret != 0 )
+		return ret;
+
+	alGenBuffers( 1, buffer );
+	alBufferData( *buffer, *format, data, size, *frequency );
+
+	free( data );
+	return 0;
+}
@@ -56,6 +56,17 @@ extern "C" {
  */
 int audioLoader( const char * filename, ALuint * buffer, ALsizei * frequency, ALenum * format );
 
+/// Decodes the given audio file to memory and returns the samples and additional information
+/**
+ * Works like audioLoader() but does not touch OpenAL, so it may be called from any thread.
+ * @param filename The audio file to decode
+ * @param data Pointer for returning the decoded samples - must be released using free() if return value is 0
+ * @param size Pointer for returning the size of the decoded samples in bytes - only valid if return value is 0
+ * @param frequency Pointer for returning the sample's frequency - only valid if return value is 0
+ * @param format Pointer for returning the sample's format - only valid if return value is 0
+ */
+int audioDecoder( const char * filename, void ** data, ALsizei * size, ALsizei * frequency, ALenum * format );
+
 
 /**
  * @}
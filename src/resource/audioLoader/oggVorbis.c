@@ -37,7 +37,7 @@
 #endif
 
 
-int audioLoader_oggVorbis( const char * filename, ALuint * buffer, ALsizei * frequency, ALenum * format )
+int audioDecoder_oggVorbis( const char * filename, void ** data, ALsizei * size, ALsizei * frequency, ALenum * format )
 {
 
 	FILE * file = fopen( filename, "rb" );
@@ -73,20 +73,18 @@ int audioLoader_oggVorbis( const char * filename, ALuint * buffer, ALsizei * fre
 
 	int bitStream = 0;
 	long bytesRead = 0;
-	char * data = 0;
+	char * samples = 0;
 	long dataSize = 0;
 	do {
-		data = realloc( data, dataSize + RESOURCE_AUDIOLOADER_OGGVORBIS_CHUNKSIZE );
-		bytesRead = ov_read( &oggVorbisFile, data + dataSize, RESOURCE_AUDIOLOADER_OGGVORBIS_CHUNKSIZE, 0, 2, 1, &bitStream );
+		samples = realloc( samples, dataSize + RESOURCE_AUDIOLOADER_OGGVORBIS_CHUNKSIZE );
+		bytesRead = ov_read( &oggVorbisFile, samples + dataSize, RESOURCE_AUDIOLOADER_OGGVORBIS_CHUNKSIZE, 0, 2, 1, &bitStream );
 		dataSize += bytesRead;
 	} while( bytesRead > 0 );
-	data = realloc( data, dataSize );
+	samples = realloc( samples, dataSize );
 
 	ov_clear( &oggVorbisFile );
 
-	alGenBuffers( 1, buffer );
-	alBufferData( *buffer, *format, data, dataSize, *frequency );
-
-	free( data );
+	*data = samples;
+	*size = dataSize;
 	return 0;
 }
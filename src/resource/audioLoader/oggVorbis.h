@@ -39,8 +39,8 @@ extern "C" {
  **/
 
 
-/// OGG-Vorbis audio loader
-int audioLoader_oggVorbis( const char * filename, ALuint * buffer, ALsizei * frequency, ALenum * format );
+/// OGG-Vorbis audio decoder
+int audioDecoder_oggVorbis( const char * filename, void ** data, ALsizei * size, ALsizei * frequency, ALenum * format );
 
 
 /**
@@ -61,7 +61,7 @@ typedef struct
 } WAVEDataHeader;
 
 
-int audioLoader_riffWave( const char * filename, ALuint * buffer, ALsizei * frequency, ALenum * format )
+int audioDecoder_riffWave( const char * filename, void ** data, ALsizei * size, ALsizei * frequency, ALenum * format )
 {
 	FILE * file = fopen( filename, "rb" );
 	if( !file )
@@ -123,11 +123,11 @@ int audioLoader_riffWave( const char * filename, ALuint * buffer, ALsizei * freq
 
 	////////////////////////////////
 	// data
-	unsigned char * data = malloc( waveDataHeader.subChunkSize );
-	if( !fread( data, waveDataHeader.subChunkSize, 1, file ) )
+	unsigned char * samples = malloc( waveDataHeader.subChunkSize );
+	if( !fread( samples, waveDataHeader.subChunkSize, 1, file ) )
 	{
 		fclose( file );
-		free( data );
+		free( samples );
 		return -AUDIOLOADER_INVALIDFORMAT;
 	}
 	fclose( file );
@@ -155,12 +155,11 @@ int audioLoader_riffWave( const char * filename, ALuint * buffer, ALsizei * freq
 	}
 	if( !*format )
 	{
-		free( data );
+		free( samples );
 		return -AUDIOLOADER_INVALIDFORMAT;
 	}
 
-	alGenBuffers( 1, buffer );
-	alBufferData( *buffer, *format, (void*)data, waveDataHeader.subChunkSize, *frequency );
-	free( data );
+	*data = samples;
+	*size = waveDataHeader.subChunkSize;
 	return 0;
 }
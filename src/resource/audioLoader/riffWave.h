@@ -39,8 +39,8 @@ extern "C" {
  **/
 
 
-/// RIFF/Wave audio loader
-int audioLoader_riffWave( const char * filename, ALuint * buffer, ALsizei * frequency, ALenum * format );
+/// RIFF/Wave audio decoder
+int audioDecoder_riffWave( const char * filename, void ** data, ALsizei * size, ALsizei * frequency, ALenum * format );
 
 
 /**
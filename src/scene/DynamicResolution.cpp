@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DynamicResolution.hpp"
+
+#include <math.h>
+
+
+bool DynamicResolution::sEnabled = true;
+float DynamicResolution::sTargetTime = 14.0f;
+float DynamicResolution::sMinimumScale = 0.5f;
+
+
+bool DynamicResolution::supported()
+{
+	return GLEW_ARB_timer_query || GLEW_EXT_timer_query;
+}
+
+
+DynamicResolution::DynamicResolution() :
+	mNextQuery( 0 ),
+	mMeasuring( false ),
+	mGPUTime( 0.0f ),
+	mHasTime( false ),
+	mLevel( levels ),
+	mReduction( 0 ),
+	mFramesSinceChange( 0 )
+{
+	glGenQueries( ringSize, mQueries );
+	for( int i = 0; i < ringSize; ++i )
+		mPending[i] = false;
+}
+
+
+DynamicResolution::~DynamicResolution()
+{
+	glDeleteQueries( ringSize, mQueries );
+}
+
+
+void DynamicResolution::update()
+{
+	// oldest first, so the newest available time has the most weight
+	for( int i = 0; i < ringSize; ++i )
+	{
+		int q = ( mNextQuery + i ) % ringSize;
+		if( !mPending[q] )
+			continue;
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv( mQueries[q], GL_QUERY_RESULT_AVAILABLE, &available );
+		if( !available )
+			continue;
+		GLuint nanoseconds = 0;
+		glGetQueryObjectuiv( mQueries[q], GL_QUERY_RESULT, &nanoseconds );
+		float milliseconds = (float)nanoseconds / 1000000.0f;
+		mGPUTime = mHasTime ? mGPUTime * 0.8f + milliseconds * 0.2f : milliseconds;
+		mHasTime = true;
+		mPending[q] = false;
+	}
+
+	++mFramesSinceChange;
+	if( !sEnabled )
+	{
+		if( mLevel != levels || mReduction != 0 )
+			mFramesSinceChange = 0;
+		mLevel = levels;
+		mReduction = 0;
+		return;
+	}
+	if( !mHasTime || mGPUTime <= 0.0f || mFramesSinceChange < settleFrames )
+		return;
+
+	// the time spent per frame grows with the pixels - the square of the scale
+	float ideal = scale() * sqrtf( sTargetTime / mGPUTime );
+	int minimumLevel = (int)ceilf( sMinimumScale * levels );
+	int level = qBound( minimumLevel, (int)floorf( ideal * levels ), levels );
+	if( level < mLevel )
+	{
+		mLevel = level;
+		mFramesSinceChange = 0;
+	}
+	else if( mLevel == minimumLevel && mGPUTime > sTargetTime && mReduction < maximumReduction )
+	{
+		// the scale can not go any lower
+		++mReduction;
+		mFramesSinceChange = 0;
+	}
+	else if( mGPUTime < sTargetTime * 0.85f && ( mReduction > 0 || level > mLevel ) )
+	{
+		// restore the detail before the scale
+		if( mReduction > 0 )
+			--mReduction;
+		else
+			++mLevel;
+		mFramesSinceChange = 0;
+	}
+}
+
+
+void DynamicResolution::begin()
+{
+	// measured frames are skipped while all queries of the ring are pending
+	mMeasuring = !mPending[mNextQuery];
+	if( mMeasuring )
+		glBeginQuery( GL_TIME_ELAPSED_EXT, mQueries[mNextQuery] );
+}
+
+
+void DynamicResolution::end()
+{
+	if( !mMeasuring )
+		return;
+	glEndQuery( GL_TIME_ELAPSED_EXT );
+	mPending[mNextQuery] = true;
+	mNextQuery = ( mNextQuery + 1 ) % ringSize;
+	mMeasuring = false;
+}
+
+
+QSize DynamicResolution::scaled( const QSize & size ) const
+{
+	if( mLevel >= levels )
+		return size;
+	return QSize( qMax( 1, size.width() * mLevel / levels ), qMax( 1, size.height() * mLevel / levels ) );
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCENE_DYNAMICRESOLUTION_INCLUDED
+#define SCENE_DYNAMICRESOLUTION_INCLUDED
+
+
+#include <GLWidget.hpp>
+
+#include <QSize>
+
+
+/// Scales the scene's resolution to hold a target GPU frame time
+/**
+ * The GPU time of each frame is measured between begin() and end() with timer queries.
+ * The queries form a ring polled for GL_QUERY_RESULT_AVAILABLE, so reading them never waits for the GPU.\n
+ * Since the cost of a frame grows with its pixels, update() picks the scale whose square brings the smoothed time to the target.
+ * Scales are rounded to steps of 1/16 and lowered at once but raised one step at a time with some headroom,
+ * so the scene's render targets change size rarely.\n
+ * Once the scale reached its minimum, further detail such as the water's reflection is reduced step by step.
+ * Recovering restores the detail before the scale, so one controller decides on all of it.
+ */
+class DynamicResolution
+{
+public:
+	DynamicResolution();
+	~DynamicResolution();
+
+	/// Fetches finished measurements and adjusts the scale - call once per frame before begin()
+	void update();
+	/// Starts measuring the frame's GPU time
+	void begin();
+	/// Stops measuring
+	void end();
+
+	/// Returns true if the last update() changed the scale or the reduction
+	bool changed() const { return mFramesSinceChange == 0; }
+	/// Scale of both edges of the scene, from minimumScale() to 1
+	float scale() const { return (float)mLevel / (float)levels; }
+	/// Returns the size scaled by the current scale
+	QSize scaled( const QSize & size ) const;
+	/// Steps detail is reduced by beyond the minimum scale, from 0 to maximumReduction
+	int reduction() const { return mReduction; }
+	/// Smoothed GPU time of the measured frames in milliseconds
+	float gpuTime() const { return mGPUTime; }
+
+	/// Returns true if timer queries are available
+	static bool supported();
+
+	static bool enabled() { return sEnabled; }
+	static void setEnabled( bool enable ) { sEnabled = enable; }
+	/// GPU time per frame in milliseconds the scale is adjusted to.
+	static float targetTime() { return sTargetTime; }
+	static void setTargetTime( float milliseconds ) { sTargetTime = qMax( 1.0f, milliseconds ); }
+	static float minimumScale() { return sMinimumScale; }
+	static void setMinimumScale( float scale ) { sMinimumScale = qBound( 1.0f/levels, scale, 1.0f ); }
+
+	static const int maximumReduction = 3;
+
+private:
+	static const int levels = 16;
+	static const int ringSize = 4;
+	static const int settleFrames = 15;	///< Frames to wait after a change until measurements reflect it
+
+	GLuint mQueries[ringSize];
+	bool mPending[ringSize];
+	int mNextQuery;
+	bool mMeasuring;
+	float mGPUTime;
+	bool mHasTime;
+	int mLevel;
+	int mReduction;
+	int mFramesSinceChange;
+
+	static bool sEnabled;
+	static float sTargetTime;
+	static float sMinimumScale;
+};
+
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HiZBuffer.hpp"
+
+#include "TextureRenderer.hpp"
+#include "object/AObject.hpp"
+#include "object/Eye.hpp"
+
+#include <math.h>
+
+
+bool HiZBuffer::supported()
+{
+	return GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object;
+}
+
+
+HiZBuffer::HiZBuffer( GLWidget * glWidget, const QSize & size ) :
+	mSize( size )
+{
+	mRenderer = new TextureRenderer( glWidget, size, true );
+
+	glGenBuffers( 2, mPixelBuffers );
+	for( int i = 0; i < 2; ++i )
+	{
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, mPixelBuffers[i] );
+		glBufferData( GL_PIXEL_PACK_BUFFER, size.width()*size.height()*sizeof(GLfloat), NULL, GL_STREAM_READ );
+		mPending[i] = false;
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+	mNextBuffer = 0;
+	mRowMaxima.resize( size.width()*size.height() );
+
+	QSize levelSize = size;
+	while( true )
+	{
+		mLevelSizes.append( levelSize );
+		mLevels.append( QVector<float>( levelSize.width()*levelSize.height(), 1.0f ) );
+		if( levelSize.width() == 1 && levelSize.height() == 1 )
+			break;
+		levelSize = QSize( qMax( 1, (levelSize.width()+1)/2 ), qMax( 1, (levelSize.height()+1)/2 ) );
+	}
+	mValid = false;
+}
+
+
+HiZBuffer::~HiZBuffer()
+{
+	glDeleteBuffers( 2, mPixelBuffers );
+	delete mRenderer;
+}
+
+
+void HiZBuffer::update( AObject * root, const Eye * eye )
+{
+	readBack();
+	render( root, eye );
+}
+
+
+void HiZBuffer::readBack()
+{
+	// the buffer written last frame - the other one is written next
+	int last = 1 - mNextBuffer;
+	if( !mPending[last] )
+		return;
+	mPending[last] = false;
+
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, mPixelBuffers[last] );
+	const GLfloat * depth = reinterpret_cast<const GLfloat*>( glMapBuffer( GL_PIXEL_PACK_BUFFER, GL_READ_ONLY ) );
+	if( depth )
+	{
+		dilate( depth );
+		glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+		mMatrix = mPendingMatrices[last];
+		buildLevels();
+		mValid = true;
+	}
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+}
+
+
+void HiZBuffer::render( AObject * root, const Eye * eye )
+{
+	mRenderer->bind();
+	glPushAttrib( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT );
+	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+	glEnable( GL_DEPTH_TEST );
+	glDepthMask( GL_TRUE );
+	glDisable( GL_LIGHTING );
+	glDisable( GL_TEXTURE_2D );
+	glDisable( GL_BLEND );
+	glClear( GL_DEPTH_BUFFER_BIT );
+
+	root->drawOccluders();
+
+	// read back asynchronously - mapped by the next frame
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, mPixelBuffers[mNextBuffer] );
+	glReadPixels( 0, 0, mSize.width(), mSize.height(), GL_DEPTH_COMPONENT, GL_FLOAT, 0 );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	glPopAttrib();
+	mRenderer->release();
+
+	mPendingMatrices[mNextBuffer] = eye->projectionMatrix() * eye->viewMatrix();
+	mPending[mNextBuffer] = true;
+	mNextBuffer = 1 - mNextBuffer;
+}
+
+
+void HiZBuffer::dilate( const GLfloat * depth )
+{
+	// occluders were only sampled at texel centers, so an occluder edge may end anywhere within the neighbouring texels
+	const int width = mSize.width();
+	const int height = mSize.height();
+	for( int y = 0; y < height; ++y )
+	{
+		const GLfloat * row = depth + y*width;
+		float * target = mRowMaxima.data() + y*width;
+		for( int x = 0; x < width; ++x )
+			target[x] = qMax( row[x], qMax( row[qMax( x-1, 0 )], row[qMin( x+1, width-1 )] ) );
+	}
+	QVector<float> & level = mLevels[0];
+	for( int y = 0; y < height; ++y )
+	{
+		const float * below = mRowMaxima.constData() + qMax( y-1, 0 )*width;
+		const float * row = mRowMaxima.constData() + y*width;
+		const float * above = mRowMaxima.constData() + qMin( y+1, height-1 )*width;
+		for( int x = 0; x < width; ++x )
+			level[y*width+x] = qMax( row[x], qMax( below[x], above[x] ) );
+	}
+}
+
+
+void HiZBuffer::buildLevels()
+{
+	for( int l = 1; l < mLevels.size(); ++l )
+	{
+		const QVector<float> & source = mLevels[l-1];
+		const QSize & sourceSize = mLevelSizes[l-1];
+		QVector<float> & target = mLevels[l];
+		const QSize & targetSize = mLevelSizes[l];
+		for( int y = 0; y < targetSize.height(); ++y )
+		{
+			int y0 = qMin( y*2, sourceSize.height()-1 ) * sourceSize.width();
+			int y1 = qMin( y*2+1, sourceSize.height()-1 ) * sourceSize.width();
+			for( int x = 0; x < targetSize.width(); ++x )
+			{
+				int x0 = qMin( x*2, sourceSize.width()-1 );
+				int x1 = qMin( x*2+1, sourceSize.width()-1 );
+				target[y*targetSize.width()+x] = qMax(
+					qMax( source[y0+x0], source[y0+x1] ),
+					qMax( source[y1+x0], source[y1+x1] ) );
+			}
+		}
+	}
+}
+
+
+bool HiZBuffer::isSphereOccluded( const QVector3D & center, const float & radius ) const
+{
+	if( !mValid )
+		return false;
+
+	// screen rectangle and nearest depth of the sphere's bounding box
+	float minX = 1.0f, minY = 1.0f, minZ = 1.0f;
+	float maxX = -1.0f, maxY = -1.0f;
+	for( int i = 0; i < 8; ++i )
+	{
+		QVector4D corner = mMatrix * QVector4D(
+			center.x() + ( (i&1) ? radius : -radius ),
+			center.y() + ( (i&2) ? radius : -radius ),
+			center.z() + ( (i&4) ? radius : -radius ),
+			1.0f );
+		if( corner.w() <= 0.0f )
+			return false;	// reaches behind the eye
+		minX = qMin( minX, corner.x() / corner.w() );
+		maxX = qMax( maxX, corner.x() / corner.w() );
+		minY = qMin( minY, corner.y() / corner.w() );
+		maxY = qMax( maxY, corner.y() / corner.w() );
+		minZ = qMin( minZ, corner.z() / corner.w() );
+	}
+	if( minZ < -1.0f || maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f )
+		return false;	// crosses the near plane or is outside of last frame's view
+	float nearest = minZ * 0.5f + 0.5f;
+
+	// pick the level where the rectangle covers at most 3x3 texels
+	float left = ( qMax( minX, -1.0f ) * 0.5f + 0.5f ) * mSize.width();
+	float right = ( qMin( maxX, 1.0f ) * 0.5f + 0.5f ) * mSize.width();
+	float bottom = ( qMax( minY, -1.0f ) * 0.5f + 0.5f ) * mSize.height();
+	float top = ( qMin( maxY, 1.0f ) * 0.5f + 0.5f ) * mSize.height();
+	float extent = qMax( right - left, top - bottom );
+	int level = extent > 2.0f ? (int)ceilf( log2f( extent * 0.5f ) ) : 0;
+	level = qMin( level, mLevels.size()-1 );
+
+	const QVector<float> & depth = mLevels[level];
+	const QSize & levelSize = mLevelSizes[level];
+	float scale = 1.0f / (float)( 1 << level );
+	int fromX = qBound( 0, (int)( left * scale ), levelSize.width()-1 );
+	int toX = qBound( 0, (int)( right * scale ), levelSize.width()-1 );
+	int fromY = qBound( 0, (int)( bottom * scale ), levelSize.height()-1 );
+	int toY = qBound( 0, (int)( top * scale ), levelSize.height()-1 );
+	for( int y = fromY; y <= toY; ++y )
+	{
+		for( int x = fromX; x <= toX; ++x )
+		{
+			if( nearest <= depth[y*levelSize.width()+x] )
+				return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCENE_HIZBUFFER_INCLUDED
+#define SCENE_HIZBUFFER_INCLUDED
+
+
+#include <GLWidget.hpp>
+
+#include <QVector>
+#include <QSize>
+#include <QMatrix4x4>
+
+
+class TextureRenderer;
+class AObject;
+class Eye;
+
+
+/// Hierarchical depth buffer for occlusion culling
+/**
+ * Each frame the occluders of the scene (see AObject::drawOccluders()) are drawn into a small depth buffer,
+ * which is read back asynchronously through a pixel buffer object.
+ * The following frame maps it and widens each texel to the farthest depth of its 3x3 neighbourhood,
+ * since the occluders were rasterized at texel centers only and might not cover the whole texel.
+ * Then it builds a chain of levels, each holding the farthest depth of 2x2 texels of the previous one.\n
+ * Bounding spheres are tested against the level where they cover at most 3x3 texels -
+ * a sphere is occluded if its nearest depth is behind the farthest depth there.
+ * Results lag one frame behind, so the pipeline never waits for the read back.
+ */
+class HiZBuffer
+{
+public:
+	HiZBuffer( GLWidget * glWidget, const QSize & size = QSize( 256, 128 ) );
+	~HiZBuffer();
+
+	/// Maps last frame's depth and draws the occluders of this frame from the eye - expects the eye's matrices to be applied
+	void update( AObject * root, const Eye * eye );
+	/// Returns true if the sphere in world coordinates was completely hidden in last frame's occluder depth
+	bool isSphereOccluded( const QVector3D & center, const float & radius ) const;
+
+	const QSize & size() const { return mSize; }
+
+	/// Returns true if pixel buffer objects are available
+	static bool supported();
+
+private:
+	void readBack();
+	void render( AObject * root, const Eye * eye );
+	/// Fills level 0 with the farthest depth of each texel's 3x3 neighbourhood
+	void dilate( const GLfloat * depth );
+	void buildLevels();
+
+	QSize mSize;
+	TextureRenderer * mRenderer;
+	GLuint mPixelBuffers[2];
+	QMatrix4x4 mPendingMatrices[2];
+	bool mPending[2];
+	int mNextBuffer;
+	QVector<float> mRowMaxima;	///< Farthest depth of each texel and its horizontal neighbours
+
+	QMatrix4x4 mMatrix;	///< View projection the levels were drawn with
+	QVector< QVector<float> > mLevels;
+	QVector< QSize > mLevelSizes;
+	bool mValid;
+};
+
+
+#endif
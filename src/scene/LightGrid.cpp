@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LightGrid.hpp"
+
+#include <QGLShaderProgram>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+
+const LightGrid * LightGrid::sCurrent = NULL;
+int LightGrid::sTileSize = 32;
+int LightGrid::sMaxLights = 128;
+
+
+bool LightGrid::supported()
+{
+	return GLEW_ARB_texture_float;
+}
+
+
+LightGrid::LightGrid() :
+	mLightMapWidth( sMaxLights ),
+	mTilesX( 0 ),
+	mTilesY( 0 )
+{
+	glGenTextures( 1, &mLightMap );
+	glBindTexture( GL_TEXTURE_2D, mLightMap );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	// one column per light: position and radius, color, attenuation
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, mLightMapWidth, 3, 0, GL_RGBA, GL_FLOAT, NULL );
+
+	glGenTextures( 1, &mTileMap );
+	glBindTexture( GL_TEXTURE_2D, mTileMap );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+
+LightGrid::~LightGrid()
+{
+	if( sCurrent == this )
+		sCurrent = NULL;
+	glDeleteTextures( 1, &mTileMap );
+	glDeleteTextures( 1, &mLightMap );
+}
+
+
+void LightGrid::clear()
+{
+	mWorldPosition.clear();
+	mRadius.clear();
+	mColor.clear();
+	mAttenuation.clear();
+}
+
+
+void LightGrid::addPointLight( const QVector3D & position, float radius, const QVector4D & color, const QVector3D & attenuation )
+{
+	if( mWorldPosition.size() >= qMin( sMaxLights, mLightMapWidth ) )
+		return;
+	mWorldPosition.append( position );
+	mRadius.append( radius );
+	mColor.append( color );
+	mAttenuation.append( attenuation );
+}
+
+
+void LightGrid::build( const QMatrix4x4 & projection, const QMatrix4x4 & view, const QRect & viewport )
+{
+	mViewport = viewport;
+	mTilesX = ( viewport.width() + sTileSize - 1 ) / sTileSize;
+	mTilesY = ( viewport.height() + sTileSize - 1 ) / sTileSize;
+
+	const int count = mWorldPosition.size();
+	mPositionX.resize( count );
+	mPositionY.resize( count );
+	mPositionZ.resize( count );
+	for( int i = 0; i < count; ++i )
+	{
+		QVector3D p = view.map( mWorldPosition[i] );
+		mPositionX[i] = p.x();
+		mPositionY[i] = p.y();
+		mPositionZ[i] = p.z();
+	}
+
+	// near and far plane from the projection matrix
+	float nearPlane = projection(2,3) / ( projection(2,2) - 1.0f );
+	float farPlane = projection(2,3) / ( projection(2,2) + 1.0f );
+
+	mTileCounts.fill( 0, mTilesX * mTilesY );
+	mTiles.fill( 0, mTilesX * mTilesY * maxLightsPerTile );
+	cull( projection, nearPlane, farPlane );
+	upload();
+}
+
+
+void LightGrid::cull( const QMatrix4x4 & projection, float nearPlane, float farPlane )
+{
+	// screen space bounds of each light's sphere - taking the sphere's extent at its nearest and farthest depth is conservative
+	const float p00 = projection(0,0);
+	const float p02 = projection(0,2);
+	const float p11 = projection(1,1);
+	const float p12 = projection(1,2);
+	const int count = lightCount();
+	const int layerSize = mTilesX * mTilesY;
+	float bounds[4][4];	// min x, max x, min y, max y of four lights in normalized device coordinates
+
+	int i = 0;
+	while( i < count )
+	{
+		int visible = 0;
+		int group = qMin( 4, count - i );
+#ifdef __SSE__
+		if( group == 4 )
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps( 1.0f );
+			const __m128 nearV = _mm_set1_ps( nearPlane );
+			const __m128 farV = _mm_set1_ps( farPlane );
+			__m128 x = _mm_loadu_ps( mPositionX.constData()+i );
+			__m128 y = _mm_loadu_ps( mPositionY.constData()+i );
+			__m128 r = _mm_loadu_ps( mRadius.constData()+i );
+			__m128 depth = _mm_sub_ps( zero, _mm_loadu_ps( mPositionZ.constData()+i ) );
+			__m128 invNear = _mm_div_ps( one, _mm_max_ps( _mm_sub_ps( depth, r ), nearV ) );
+			__m128 invFar = _mm_div_ps( one, _mm_max_ps( _mm_add_ps( depth, r ), nearV ) );
+			__m128 xl = _mm_sub_ps( x, r );
+			__m128 xh = _mm_add_ps( x, r );
+			__m128 yl = _mm_sub_ps( y, r );
+			__m128 yh = _mm_add_ps( y, r );
+			__m128 p00V = _mm_set1_ps( p00 );
+			__m128 p02V = _mm_set1_ps( p02 );
+			__m128 p11V = _mm_set1_ps( p11 );
+			__m128 p12V = _mm_set1_ps( p12 );
+			_mm_storeu_ps( bounds[0], _mm_sub_ps( _mm_mul_ps( _mm_min_ps( _mm_mul_ps( xl, invNear ), _mm_mul_ps( xl, invFar ) ), p00V ), p02V ) );
+			_mm_storeu_ps( bounds[1], _mm_sub_ps( _mm_mul_ps( _mm_max_ps( _mm_mul_ps( xh, invNear ), _mm_mul_ps( xh, invFar ) ), p00V ), p02V ) );
+			_mm_storeu_ps( bounds[2], _mm_sub_ps( _mm_mul_ps( _mm_min_ps( _mm_mul_ps( yl, invNear ), _mm_mul_ps( yl, invFar ) ), p11V ), p12V ) );
+			_mm_storeu_ps( bounds[3], _mm_sub_ps( _mm_mul_ps( _mm_max_ps( _mm_mul_ps( yh, invNear ), _mm_mul_ps( yh, invFar ) ), p11V ), p12V ) );
+			visible = _mm_movemask_ps( _mm_and_ps(
+				_mm_cmpgt_ps( _mm_add_ps( depth, r ), nearV ),
+				_mm_cmplt_ps( _mm_sub_ps( depth, r ), farV ) ) );
+		}
+		else
+#endif
+		{
+			for( int k = 0; k < group; ++k )
+			{
+				float x = mPositionX[i+k];
+				float y = mPositionY[i+k];
+				float r = mRadius[i+k];
+				float depth = -mPositionZ[i+k];
+				float invNear = 1.0f / qMax( depth - r, nearPlane );
+				float invFar = 1.0f / qMax( depth + r, nearPlane );
+				bounds[0][k] = qMin( (x-r)*invNear, (x-r)*invFar ) * p00 - p02;
+				bounds[1][k] = qMax( (x+r)*invNear, (x+r)*invFar ) * p00 - p02;
+				bounds[2][k] = qMin( (y-r)*invNear, (y-r)*invFar ) * p11 - p12;
+				bounds[3][k] = qMax( (y+r)*invNear, (y+r)*invFar ) * p11 - p12;
+				if( depth + r > nearPlane && depth - r < farPlane )
+					visible |= 1 << k;
+			}
+		}
+
+		for( int k = 0; k < group; ++k )
+		{
+			if( !( visible & ( 1 << k ) ) )
+				continue;
+			if( bounds[0][k] > 1.0f || bounds[1][k] < -1.0f || bounds[2][k] > 1.0f || bounds[3][k] < -1.0f )
+				continue;
+			int x0 = qBound( 0, (int)floorf( ( bounds[0][k]*0.5f+0.5f ) * mViewport.width() / sTileSize ), mTilesX-1 );
+			int x1 = qBound( 0, (int)floorf( ( bounds[1][k]*0.5f+0.5f ) * mViewport.width() / sTileSize ), mTilesX-1 );
+			int y0 = qBound( 0, (int)floorf( ( bounds[2][k]*0.5f+0.5f ) * mViewport.height() / sTileSize ), mTilesY-1 );
+			int y1 = qBound( 0, (int)floorf( ( bounds[3][k]*0.5f+0.5f ) * mViewport.height() / sTileSize ), mTilesY-1 );
+			for( int ty = y0; ty <= y1; ++ty )
+			{
+				for( int tx = x0; tx <= x1; ++tx )
+				{
+					int tile = tx + ty * mTilesX;
+					int & slot = mTileCounts[tile];
+					if( slot >= maxLightsPerTile )
+						continue;
+					// four slots per texel, one layer of texels per four slots
+					mTiles[ ( tile + ( slot / 4 ) * layerSize ) * 4 + slot % 4 ] = (unsigned char)( i + k + 1 );
+					++slot;
+				}
+			}
+		}
+		i += group;
+	}
+}
+
+
+void LightGrid::upload()
+{
+	const int count = lightCount();
+	if( count > 0 )
+	{
+		QVector<GLfloat> data( count * 3 * 4 );
+		for( int i = 0; i < count; ++i )
+		{
+			GLfloat * position = data.data() + i*4;
+			GLfloat * color = data.data() + ( count + i )*4;
+			GLfloat * attenuation = data.data() + ( 2*count + i )*4;
+			position[0] = mPositionX[i];
+			position[1] = mPositionY[i];
+			position[2] = mPositionZ[i];
+			position[3] = mRadius[i];
+			color[0] = mColor[i].x();
+			color[1] = mColor[i].y();
+			color[2] = mColor[i].z();
+			color[3] = mColor[i].w();
+			attenuation[0] = mAttenuation[i].x();
+			attenuation[1] = mAttenuation[i].y();
+			attenuation[2] = mAttenuation[i].z();
+			attenuation[3] = 0.0f;
+		}
+		glBindTexture( GL_TEXTURE_2D, mLightMap );
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, count, 3, GL_RGBA, GL_FLOAT, data.constData() );
+	}
+
+	QSize tileMapSize( mTilesX, mTilesY * maxLightsPerTile/4 );
+	glBindTexture( GL_TEXTURE_2D, mTileMap );
+	if( tileMapSize != mTileMapSize )
+	{
+		mTileMapSize = tileMapSize;
+		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, tileMapSize.width(), tileMapSize.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, mTiles.constData() );
+	}
+	else
+	{
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, tileMapSize.width(), tileMapSize.height(), GL_RGBA, GL_UNSIGNED_BYTE, mTiles.constData() );
+	}
+	glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+
+int LightGrid::bind( QGLShaderProgram * program, int texUnit ) const
+{
+	glActiveTexture( GL_TEXTURE0 + texUnit );
+	glBindTexture( GL_TEXTURE_2D, mLightMap );
+	glActiveTexture( GL_TEXTURE0 + texUnit + 1 );
+	glBindTexture( GL_TEXTURE_2D, mTileMap );
+	glActiveTexture( GL_TEXTURE0 );
+	program->setUniformValue( "lightGridEnabled", (GLint)( lightCount() > 0 ) );
+	program->setUniformValue( "lightGridLightMap", texUnit );
+	program->setUniformValue( "lightGridTileMap", texUnit + 1 );
+	program->setUniformValue( "lightGridViewport", QVector4D( mViewport.x(), mViewport.y(), mViewport.width(), mViewport.height() ) );
+	program->setUniformValue( "lightGridSize", QVector4D( mTilesX, mTilesY, sTileSize, mLightMapWidth ) );
+	return texUnit + 2;
+}
+
+
+int LightGrid::bindCurrent( QGLShaderProgram * program, int texUnit )
+{
+	if( sCurrent )
+		return sCurrent->bind( program, texUnit );
+	// samplers still need units of their own, sharing one with a sampler of another type is invalid
+	program->setUniformValue( "lightGridEnabled", (GLint)false );
+	program->setUniformValue( "lightGridLightMap", texUnit );
+	program->setUniformValue( "lightGridTileMap", texUnit + 1 );
+	return texUnit + 2;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCENE_LIGHTGRID_INCLUDED
+#define SCENE_LIGHTGRID_INCLUDED
+
+
+#include <GLWidget.hpp>
+
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+#include <QMatrix4x4>
+#include <QRect>
+
+
+class QGLShaderProgram;
+
+
+/// Screen space tile grid of point lights for forward+ shading
+/**
+ * Point lights are collected each view, culled against screen tiles on the CPU and uploaded to two textures:
+ * the light map holds the lights' view space position, radius, color and attenuation,
+ * the tile map holds the indices of up to maxLightsPerTile lights affecting each tile.\n
+ * Material shaders include lightGrid.glsl and evaluate the lights of their fragment's tile,
+ * so the cost per fragment is bounded no matter how many lights are in the scene.
+ */
+class LightGrid
+{
+public:
+	/// Lights per tile, stored as 4 indices per tile map layer
+	static const int maxLightsPerTile = 8;
+
+	LightGrid();
+	~LightGrid();
+
+	/// Removes all lights
+	void clear();
+	/// Adds a point light in world coordinates - it has no effect beyond radius
+	void addPointLight( const QVector3D & position, float radius, const QVector4D & color, const QVector3D & attenuation );
+	/// Culls the lights against the tiles of the viewport and uploads them
+	void build( const QMatrix4x4 & projection, const QMatrix4x4 & view, const QRect & viewport );
+
+	int lightCount() const { return mWorldPosition.size(); }
+
+	/// Binds the light and tile map to the given texture units and sets the shader's lightGrid uniforms - returns the next free unit
+	int bind( QGLShaderProgram * program, int texUnit ) const;
+
+	/// The grid shaders read from - NULL disables the grid's lights
+	static const LightGrid * current() { return sCurrent; }
+	static void setCurrent( const LightGrid * grid ) { sCurrent = grid; }
+	/// Binds the current grid to the shader or disables its lights there - returns the next free texture unit
+	static int bindCurrent( QGLShaderProgram * program, int texUnit );
+
+	/// Edge length of a tile in pixels.
+	static int tileSize() { return sTileSize; }
+	static void setTileSize( int size ) { sTileSize = qMax( 8, size ); }
+	/// Lights beyond this number are dropped.
+	static int maxLights() { return sMaxLights; }
+	static void setMaxLights( int lights ) { sMaxLights = qBound( 1, lights, 255 ); }
+
+	/// Returns true if float textures are available
+	static bool supported();
+
+private:
+	void cull( const QMatrix4x4 & projection, float nearPlane, float farPlane );
+	void upload();
+
+	GLuint mLightMap;
+	GLuint mTileMap;
+	int mLightMapWidth;
+	QSize mTileMapSize;
+	QRect mViewport;
+	int mTilesX;
+	int mTilesY;
+
+	// lights in view space as structure of arrays for culling four at once
+	QVector<float> mPositionX;
+	QVector<float> mPositionY;
+	QVector<float> mPositionZ;
+	QVector<float> mRadius;
+	QVector<QVector4D> mColor;
+	QVector<QVector3D> mAttenuation;
+	QVector<QVector3D> mWorldPosition;
+
+	QVector<int> mTileCounts;
+	QVector<unsigned char> mTiles;	///< Light index + 1 per slot - 0 marks the end of a tile's lights
+
+	static const LightGrid * sCurrent;
+	static int sTileSize;
+	static int sMaxLights;
+};
+
+
+#endif
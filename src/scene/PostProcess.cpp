@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PostProcess.hpp"
+
+#include "RenderTargetPool.hpp"
+#include "TextureRenderer.hpp"
+
+#include <resource/Shader.hpp>
+
+#include <QGLShaderProgram>
+#include <QVector2D>
+
+
+const GLint PostProcess::sceneFormat;
+int PostProcess::sBloomDivisor = 2;
+bool PostProcess::sBloom = true;
+float PostProcess::sBloomThreshold = 0.8f;
+float PostProcess::sBloomStrength = 0.3f;
+float PostProcess::sExposure = 1.0f;
+bool PostProcess::sFXAA = true;
+
+
+bool PostProcess::supported()
+{
+	return GLEW_ARB_texture_float;
+}
+
+
+PostProcess::PostProcess( GLWidget * glWidget, RenderTargetPool * pool ) :
+	mPool( pool ),
+	mSceneTarget( NULL )
+{
+	mBrightShader = new Shader( glWidget, "postProc.bright" );
+	mBlurShader = new Shader( glWidget, "postProc.blur" );
+	mToneMapShader = new Shader( glWidget, "postProc.toneMap" );
+	mFXAAShader = new Shader( glWidget, "postProc.fxaa" );
+}
+
+
+PostProcess::~PostProcess()
+{
+	delete mFXAAShader;
+	delete mToneMapShader;
+	delete mBlurShader;
+	delete mBrightShader;
+}
+
+
+void PostProcess::begin( const QSize & size )
+{
+	mSize = size;
+	mSceneTarget = mPool->acquire( size, sceneFormat, true );
+	mSceneTarget->bind();
+	glClear( GL_COLOR_BUFFER_BIT );
+}
+
+
+void PostProcess::end()
+{
+	mSceneTarget->release();
+
+	glPushAttrib( GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_CURRENT_BIT );
+	glDisable( GL_DEPTH_TEST );
+	glDepthMask( GL_FALSE );
+	glDisable( GL_BLEND );
+	glDisable( GL_LIGHTING );
+	glDisable( GL_CULL_FACE );
+	glDisable( GL_FOG );
+	glColor4f( 1, 1, 1, 1 );
+	glMatrixMode( GL_PROJECTION );	glPushMatrix();	glLoadIdentity();
+	glMatrixMode( GL_MODELVIEW );	glPushMatrix();	glLoadIdentity();
+
+	TextureRenderer * bloomTarget = sBloom ? drawBloom() : NULL;
+
+	// FXAA reads the tone mapped colors with their luma in alpha
+	TextureRenderer * toneMapTarget = NULL;
+	if( sFXAA )
+	{
+		toneMapTarget = mPool->acquire( mSize, GL_RGBA8, false );
+		toneMapTarget->bind();
+	}
+	mToneMapShader->bind();
+	mToneMapShader->program()->setUniformValue( "sceneMap", 0 );
+	mToneMapShader->program()->setUniformValue( "bloomMap", 1 );
+	mToneMapShader->program()->setUniformValue( "bloomEnabled", (GLint)( bloomTarget != NULL ) );
+	mToneMapShader->program()->setUniformValue( "bloomStrength", sBloomStrength );
+	mToneMapShader->program()->setUniformValue( "exposure", sExposure );
+	glActiveTexture( GL_TEXTURE1 );	glBindTexture( GL_TEXTURE_2D, bloomTarget ? bloomTarget->texID() : 0 );
+	glActiveTexture( GL_TEXTURE0 );	glBindTexture( GL_TEXTURE_2D, mSceneTarget->texID() );
+	drawQuad();
+	mToneMapShader->release();
+	glActiveTexture( GL_TEXTURE1 );	glBindTexture( GL_TEXTURE_2D, 0 );
+	glActiveTexture( GL_TEXTURE0 );
+
+	if( toneMapTarget )
+	{
+		toneMapTarget->release();
+		mFXAAShader->bind();
+		mFXAAShader->program()->setUniformValue( "sourceMap", 0 );
+		mFXAAShader->program()->setUniformValue( "texelSize", QVector2D( 1.0f / mSize.width(), 1.0f / mSize.height() ) );
+		glBindTexture( GL_TEXTURE_2D, toneMapTarget->texID() );
+		drawQuad();
+		mFXAAShader->release();
+	}
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	glMatrixMode( GL_PROJECTION );	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW );	glPopMatrix();
+	glPopAttrib();
+
+	mPool->release( toneMapTarget );
+	mPool->release( bloomTarget );
+	mPool->release( mSceneTarget );
+	mSceneTarget = NULL;
+}
+
+
+TextureRenderer * PostProcess::drawBloom()
+{
+	QSize size( qMax( 1, mSize.width() / sBloomDivisor ), qMax( 1, mSize.height() / sBloomDivisor ) );
+	TextureRenderer * bloomTarget = mPool->acquire( size, sceneFormat, false );
+	TextureRenderer * blurTarget = mPool->acquire( size, sceneFormat, false );
+
+	// bright pass - four bilinear taps cover the texels merged into one
+	bloomTarget->bind();
+	mBrightShader->bind();
+	mBrightShader->program()->setUniformValue( "sourceMap", 0 );
+	mBrightShader->program()->setUniformValue( "threshold", sBloomThreshold );
+	mBrightShader->program()->setUniformValue( "texelSize", QVector2D( 1.0f / mSize.width(), 1.0f / mSize.height() ) * ( sBloomDivisor / 2 ) );
+	glBindTexture( GL_TEXTURE_2D, mSceneTarget->texID() );
+	drawQuad();
+	mBrightShader->release();
+	bloomTarget->release();
+
+	// separable gaussian blur - horizontally into the second target and vertically back
+	mBlurShader->bind();
+	mBlurShader->program()->setUniformValue( "sourceMap", 0 );
+	blurTarget->bind();
+	mBlurShader->program()->setUniformValue( "direction", QVector2D( 1.0f / size.width(), 0.0f ) );
+	glBindTexture( GL_TEXTURE_2D, bloomTarget->texID() );
+	drawQuad();
+	blurTarget->release();
+	bloomTarget->bind();
+	mBlurShader->program()->setUniformValue( "direction", QVector2D( 0.0f, 1.0f / size.height() ) );
+	glBindTexture( GL_TEXTURE_2D, blurTarget->texID() );
+	drawQuad();
+	bloomTarget->release();
+	mBlurShader->release();
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	mPool->release( blurTarget );
+	return bloomTarget;
+}
+
+
+void PostProcess::drawQuad()
+{
+	glBegin( GL_QUADS );
+	glTexCoord2f( 0, 0 );	glVertex2f( -1, -1 );
+	glTexCoord2f( 1, 0 );	glVertex2f( 1, -1 );
+	glTexCoord2f( 1, 1 );	glVertex2f( 1, 1 );
+	glTexCoord2f( 0, 1 );	glVertex2f( -1, 1 );
+	glEnd();
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCENE_POSTPROCESS_INCLUDED
+#define SCENE_POSTPROCESS_INCLUDED
+
+
+#include <GLWidget.hpp>
+
+#include <QSize>
+
+
+class RenderTargetPool;
+class TextureRenderer;
+class Shader;
+
+
+/// HDR post processing chain
+/**
+ * The scene is drawn into a floating point target between begin() and end().
+ * end() extracts the bright parts into a bloom target at half or quarter resolution and blurs them,
+ * tone maps scene and bloom and smooths edges with FXAA when enabled.\n
+ * All intermediate targets come from the pool and are handed back by end(), so they are shared with other passes.
+ */
+class PostProcess
+{
+public:
+	/// Color format of the target the scene is drawn into.
+	static const GLint sceneFormat = GL_RGBA16F_ARB;
+
+	PostProcess( GLWidget * glWidget, RenderTargetPool * pool );
+	~PostProcess();
+
+	/// Binds a HDR target of the given size - the scene drawn until end() is processed
+	void begin( const QSize & size );
+	/// Draws the processed scene into the frame buffer bound before begin()
+	void end();
+
+	/// Returns true if floating point textures are available
+	static bool supported();
+
+	/// Bloom resolution is the scene's divided by this - 2 or 4.
+	static int bloomDivisor() { return sBloomDivisor; }
+	static void setBloomDivisor( int divisor ) { sBloomDivisor = divisor > 2 ? 4 : 2; }
+	static bool bloom() { return sBloom; }
+	static void setBloom( bool enable ) { sBloom = enable; }
+	/// Brightness above which colors bloom.
+	static float bloomThreshold() { return sBloomThreshold; }
+	static void setBloomThreshold( float threshold ) { sBloomThreshold = threshold; }
+	static float bloomStrength() { return sBloomStrength; }
+	static void setBloomStrength( float strength ) { sBloomStrength = strength; }
+	static float exposure() { return sExposure; }
+	static void setExposure( float exposure ) { sExposure = exposure; }
+	static bool fxaa() { return sFXAA; }
+	static void setFXAA( bool enable ) { sFXAA = enable; }
+
+private:
+	RenderTargetPool * mPool;
+	Shader * mBrightShader;
+	Shader * mBlurShader;
+	Shader * mToneMapShader;
+	Shader * mFXAAShader;
+	TextureRenderer * mSceneTarget;
+	QSize mSize;
+
+	TextureRenderer * drawBloom();
+	static void drawQuad();
+
+	static int sBloomDivisor;
+	static bool sBloom;
+	static float sBloomThreshold;
+	static float sBloomStrength;
+	static float sExposure;
+	static bool sFXAA;
+};
+
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RenderTargetPool.hpp"
+
+#include "TextureRenderer.hpp"
+
+#include <QDebug>
+
+
+int RenderTargetPool::sIdleFrames = 120;
+
+
+RenderTargetPool::RenderTargetPool( GLWidget * glWidget ) :
+	mGLWidget( glWidget )
+{
+}
+
+
+RenderTargetPool::~RenderTargetPool()
+{
+	foreach( const Target & target, mTargets )
+	{
+		if( target.acquired )
+			qWarning() << "!" << target.renderer << "Render target still acquired";
+		delete target.renderer;
+	}
+}
+
+
+TextureRenderer * RenderTargetPool::acquire( const QSize & size, GLint format, bool depthBuffer )
+{
+	for( QList<Target>::iterator i = mTargets.begin(); i != mTargets.end(); ++i )
+	{
+		if( i->acquired || i->renderer->size() != size || i->renderer->format() != format || i->renderer->hasDepthBuffer() != depthBuffer )
+			continue;
+		i->acquired = true;
+		i->idle = 0;
+		return i->renderer;
+	}
+
+	// creating a renderer unbinds the current frame buffer
+	GLint frameBuffer;
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &frameBuffer );
+	Target target;
+	target.renderer = new TextureRenderer( mGLWidget, size, depthBuffer, format );
+	target.acquired = true;
+	target.idle = 0;
+	mTargets.append( target );
+	glBindFramebuffer( GL_FRAMEBUFFER, frameBuffer );
+	qDebug() << "+" << target.renderer << "RenderTarget" << size << format << ( depthBuffer ? "+depth" : "" )
+		<< "-" << memoryUsage()/1024/1024 << "MiB pooled";
+	return target.renderer;
+}
+
+
+void RenderTargetPool::release( TextureRenderer * target )
+{
+	if( !target )
+		return;
+	for( QList<Target>::iterator i = mTargets.begin(); i != mTargets.end(); ++i )
+	{
+		if( i->renderer == target )
+		{
+			i->acquired = false;
+			return;
+		}
+	}
+	qWarning() << "!" << target << "Render target not from this pool";
+}
+
+
+void RenderTargetPool::discard( TextureRenderer * target )
+{
+	if( !target )
+		return;
+	for( QList<Target>::iterator i = mTargets.begin(); i != mTargets.end(); ++i )
+	{
+		if( i->renderer == target )
+		{
+			qDebug() << "-" << i->renderer << "RenderTarget";
+			delete i->renderer;
+			mTargets.erase( i );
+			return;
+		}
+	}
+	qWarning() << "!" << target << "Render target not from this pool";
+}
+
+
+void RenderTargetPool::nextFrame()
+{
+	QList<Target>::iterator i = mTargets.begin();
+	while( i != mTargets.end() )
+	{
+		if( i->acquired || ++i->idle < sIdleFrames )
+		{
+			++i;
+			continue;
+		}
+		qDebug() << "-" << i->renderer << "RenderTarget";
+		delete i->renderer;
+		i = mTargets.erase( i );
+	}
+}
+
+
+void RenderTargetPool::evictUnused()
+{
+	QList<Target>::iterator i = mTargets.begin();
+	while( i != mTargets.end() )
+	{
+		if( i->acquired )
+		{
+			++i;
+			continue;
+		}
+		qDebug() << "-" << i->renderer << "RenderTarget";
+		delete i->renderer;
+		i = mTargets.erase( i );
+	}
+}
+
+
+qint64 RenderTargetPool::memoryUsage() const
+{
+	qint64 usage = 0;
+	foreach( const Target & target, mTargets )
+		usage += memoryUsage( target.renderer );
+	return usage;
+}
+
+
+qint64 RenderTargetPool::memoryUsage( const TextureRenderer * renderer )
+{
+	qint64 bytesPerPixel;
+	switch( renderer->format() )
+	{
+	case GL_RGBA16F_ARB:
+	case GL_RGB16F_ARB:
+		bytesPerPixel = 8;
+		break;
+	case GL_RGBA32F_ARB:
+	case GL_RGB32F_ARB:
+		bytesPerPixel = 16;
+		break;
+	default:
+		bytesPerPixel = 4;	// 8 bit formats are padded to 32 bit
+		break;
+	}
+	if( renderer->hasDepthBuffer() )
+		bytesPerPixel += 4;
+	return bytesPerPixel * renderer->size().width() * renderer->size().height();
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCENE_RENDERTARGETPOOL_INCLUDED
+#define SCENE_RENDERTARGETPOOL_INCLUDED
+
+
+#include <GLWidget.hpp>
+
+#include <QSize>
+#include <QList>
+
+
+class TextureRenderer;
+
+
+/// Shares texture renderers between passes
+/**
+ * Targets are looked up by size, color format and whether they have depth.
+ * A target given back with release() is handed out to the next acquire() of the same kind, even within the same frame,
+ * so passes drawn one after another share their memory instead of each keeping its own.
+ * Targets nobody acquired for a while are deleted by nextFrame().
+ */
+class RenderTargetPool
+{
+public:
+	RenderTargetPool( GLWidget * glWidget );
+	~RenderTargetPool();
+
+	/// Returns a target nobody else holds - creating one keeps the current frame buffer bound
+	TextureRenderer * acquire( const QSize & size, GLint format = GL_RGB8, bool depthBuffer = true );
+	/// Hands a target back - its content is undefined once another pass acquired it
+	void release( TextureRenderer * target );
+	/// Deletes a held target at once - for targets whose size is not going to be acquired again
+	void discard( TextureRenderer * target );
+	/// Deletes targets not acquired for idleFrames() frames
+	void nextFrame();
+	/// Deletes all targets nobody holds - for when the sizes the passes draw at changed
+	void evictUnused();
+	/// Estimated video memory taken by all targets in bytes
+	qint64 memoryUsage() const;
+
+	/// Frames an unused target is kept for.
+	static int idleFrames() { return sIdleFrames; }
+	static void setIdleFrames( int frames ) { sIdleFrames = qMax( 1, frames ); }
+
+private:
+	struct Target
+	{
+		TextureRenderer * renderer;
+		bool acquired;
+		int idle;	///< Frames since it was acquired last
+	};
+
+	GLWidget * mGLWidget;
+	QList<Target> mTargets;
+
+	static qint64 memoryUsage( const TextureRenderer * renderer );
+	static int sIdleFrames;
+};
+
+
+#endif
@@ -28,11 +28,20 @@
 #include "StartMenuWindow.hpp"
 
 #include "TextureRenderer.hpp"
+#include "HiZBuffer.hpp"
+#include "LightGrid.hpp"
+#include "ShadowMap.hpp"
+#include "RenderTargetPool.hpp"
+#include "PostProcess.hpp"
+#include "DynamicResolution.hpp"
 #include "AMouseListener.hpp"
 #include "AKeyListener.hpp"
 #include <GLWidget.hpp>
 #include <resource/Material.hpp>
 #include <resource/Shader.hpp>
+#include <resource/ResourceLoader.hpp>
+#include <geometry/ParticleSystem.hpp>
+#include <utility/OcclusionTest.hpp>
 #include <utility/glWrappers.hpp>
 #include <utility/alWrappers.hpp>
 
@@ -78,11 +87,13 @@ Scene::Scene( GLWidget * glWidget, QObject * parent ) :
 	mGLWidget( glWidget ),
 	mEye( NULL ),
 	mLeftTextureRenderer( NULL ),
-	mRightTextureRenderer( NULL )
+	mRightTextureRenderer( NULL ),
+	mRenderTargets( new RenderTargetPool( glWidget ) )
 {
 	QSettings settings;
 
 	mRoot = 0;
+	mRenderPass = AObject::MAIN_PASS;
 	mFrameCountSecond = 0;
 	mFramesPerSecond = 0;
 	mPaused = false;
@@ -102,14 +113,34 @@ Scene::Scene( GLWidget * glWidget, QObject * parent ) :
 	}
 
 	mStereo = settings.value( "stereo", false ).toBool();
-	if( mStereo )
-		resizeStereoFrameBuffers( QSize(400,600) );
+
+	mPostProcess = NULL;
+	if( settings.value( "postProcess", true ).toBool() && PostProcess::supported() )
+		mPostProcess = new PostProcess( glWidget, mRenderTargets );
+
+	mDynamicResolution = NULL;
+	if( DynamicResolution::supported() )
+		mDynamicResolution = new DynamicResolution();
 
 	mMultiSample = settings.value( "sampleBuffers", false ).toBool();
 
 	mEye = new Eye( this );
 	mEye->setFarPlane( settings.value( "farPlane", 500.0f ).toFloat() );
 
+	mHiZBuffer = NULL;
+	mHiZBufferUpdated = false;
+	if( settings.value( "occlusionCulling", true ).toBool() && HiZBuffer::supported() )
+		mHiZBuffer = new HiZBuffer( glWidget );
+
+	mLightGrid = NULL;
+	if( settings.value( "lightGrid", true ).toBool() && LightGrid::supported() )
+		mLightGrid = new LightGrid();
+
+	mShadowMap = NULL;
+	mShadowMapUpdated = false;
+	if( ShadowMap::supported() )
+		mShadowMap = new ShadowMap( glWidget );
+
 	mFont = QFont( "Xolonium", 12, QFont::Normal );
 	mBlinkingState = false;
 
@@ -175,8 +206,12 @@ Scene::~Scene()
 	delete mOVRShader;
 #endif
 	delete mEye;
-	delete mLeftTextureRenderer;
-	delete mRightTextureRenderer;
+	delete mHiZBuffer;
+	delete mLightGrid;
+	delete mShadowMap;
+	delete mPostProcess;
+	delete mDynamicResolution;
+	delete mRenderTargets;
 }
 
 
@@ -265,8 +300,80 @@ void Scene::updateObjects( const double & delta )
 void Scene::drawObjects()
 {
 	mEye->applyGL();
+	if( mHiZBuffer && !mHiZBufferUpdated )
+	{
+		mHiZBuffer->update( mRoot, mEye );
+		mHiZBufferUpdated = true;
+	}
+	if( mShadowMap && !mShadowMapUpdated )
+	{
+		mShadowMap->update( mRoot, mEye );
+		mShadowMapUpdated = true;
+	}
+	drawRoot();
+}
+
+
+GLint Scene::colorFormat() const
+{
+	return mPostProcess ? PostProcess::sceneFormat : GL_RGB8;
+}
+
+
+void Scene::drawView( const QSize & size )
+{
+	pushAllGL();
+		applyDefaultStatesGL();
+		if( mPostProcess )
+			mPostProcess->begin( size );
+		glClear( GL_DEPTH_BUFFER_BIT );
+		drawObjects();
+		if( mPostProcess )
+			mPostProcess->end();
+	popAllGL();
+}
+
+
+void Scene::drawRoot()
+{
+	GLuint lastDepthMap = ParticleSystem::sceneDepthMap();
+	QRect lastViewport = ParticleSystem::sceneViewport();
+	const LightGrid * lastLightGrid = LightGrid::current();
+	const ShadowMap * lastShadowMap = ShadowMap::current();
+
+	// nested passes (e.g. the water's reflection) assign the fixed function lights their own way
+	glPushAttrib( GL_LIGHTING_BIT );
+	ParticleSystem::setSceneDepth( 0, QRect() );
+	LightGrid::setCurrent( NULL );
+	ShadowMap::setCurrent( NULL );
 	mRoot->draw();
+
+	// particles are only drawn in the main pass
+	TextureRenderer * depthRenderer = NULL;
+	if( ParticleSystem::softness() > 0.0f && mRenderPass == AObject::MAIN_PASS )
+	{
+		GLint viewport[4];
+		glGetIntegerv( GL_VIEWPORT, viewport );
+		QSize size( viewport[2], viewport[3] );
+		depthRenderer = mRenderTargets->acquire( size );
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, depthRenderer->depthID() );
+		glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], size.width(), size.height() );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+		ParticleSystem::setSceneDepth( depthRenderer->depthID(), QRect( viewport[0], viewport[1], viewport[2], viewport[3] ) );
+	}
+
 	mRoot->draw2();
+
+	// flare tests queued while drawing are submitted in one batch against the complete depth
+	if( mRenderPass == AObject::MAIN_PASS )
+		OcclusionTest::submitAll();
+
+	LightGrid::setCurrent( lastLightGrid );
+	ShadowMap::setCurrent( lastShadowMap );
+	ParticleSystem::setSceneDepth( lastDepthMap, lastViewport );
+	mRenderTargets->release( depthRenderer );
+	glPopAttrib();
 }
 
 
@@ -334,6 +441,33 @@ void Scene::drawStereoFrameBuffers()
 }
 
 
+void Scene::drawFrameBuffer( TextureRenderer * renderer )
+{
+	sQuadVertexBuffer.bind();
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 5*sizeof(GLfloat), (void*)0 );
+	glTexCoordPointer( 2, GL_FLOAT, 5*sizeof(GLfloat), (void*)(3*sizeof(GLfloat)) );
+
+	glDisable( GL_BLEND );
+	glEnable( GL_TEXTURE_2D );
+	glDisable( GL_DEPTH_TEST );
+	glDisable( GL_CULL_FACE );
+	glDisable( GL_LIGHTING );
+	glColor4f( 1, 1, 1, 1 );
+	glActiveTexture( GL_TEXTURE0 );
+	glClientActiveTexture( GL_TEXTURE0 );
+
+	glBindTexture( GL_TEXTURE_2D, renderer->texID() );
+	glDrawArrays( GL_QUADS, 0, 4 );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	sQuadVertexBuffer.release();
+}
+
+
 void Scene::drawBackground( QPainter * painter, const QRectF & rect )
 {
 	mGLWidget->setUpdatesEnabled( false );
@@ -344,11 +478,32 @@ void Scene::drawBackground( QPainter * painter, const QRectF & rect )
 		delta = 1;
 	mDelta = (double)delta/1000000000.0;
 
+	ResourceLoader::processUploads();
+	mRenderTargets->nextFrame();
+	OcclusionTest::nextFrame();
+
 	if( !mPaused )
 		updateObjects( mDelta );
+	mHiZBufferUpdated = false;
+	mShadowMapUpdated = false;
+
+	if( mDynamicResolution )
+	{
+		mDynamicResolution->update();
+		// targets of the previous scale would otherwise stay pooled until they idle out
+		if( mDynamicResolution->changed() )
+			mRenderTargets->evictUnused();
+		mDynamicResolution->begin();
+	}
 
 	if( mStereo )
 	{
+		// the post processing chain draws into these, so they need no depth of their own
+		QSize eyeSize( qMax( 1, (int)width()/2 ), qMax( 1, (int)height() ) );
+		if( mDynamicResolution )
+			eyeSize = mDynamicResolution->scaled( eyeSize );
+		mLeftTextureRenderer = mRenderTargets->acquire( eyeSize, GL_RGB8, !mPostProcess );
+		mRightTextureRenderer = mRenderTargets->acquire( eyeSize, GL_RGB8, !mPostProcess );
 #ifdef OVR_ENABLED
 		if( mStereoUseOVR )
 		{
@@ -369,21 +524,13 @@ void Scene::drawBackground( QPainter * painter, const QRectF & rect )
 			mEye->setPerspectiveOffset( QVector3D(-projectionCenterOffset,0,0) );
 			mEye->setViewOffset( QVector3D(-halfIPD,0,0) );
 			mLeftTextureRenderer->bind();
-			pushAllGL();
-				applyDefaultStatesGL();
-				glClear( GL_DEPTH_BUFFER_BIT );
-				drawObjects();
-			popAllGL();
+			drawView( mLeftTextureRenderer->size() );
 			mLeftTextureRenderer->release();
 
 			mEye->setPerspectiveOffset( QVector3D(projectionCenterOffset,0,0) );
 			mEye->setViewOffset( QVector3D(halfIPD,0,0) );
 			mRightTextureRenderer->bind();
-			pushAllGL();
-				applyDefaultStatesGL();
-				glClear( GL_DEPTH_BUFFER_BIT );
-				drawObjects();
-			popAllGL();
+			drawView( mRightTextureRenderer->size() );
 			mRightTextureRenderer->release();
 		}
 		else
@@ -395,21 +542,13 @@ void Scene::drawBackground( QPainter * painter, const QRectF & rect )
 			mEye->setViewOffset( QVector3D(-mStereoEyeDistance/2.0f,0,0) );
 			mEye->setAspect( (float)mLeftTextureRenderer->size().width()/mLeftTextureRenderer->size().height() );
 			mLeftTextureRenderer->bind();
-			pushAllGL();
-				applyDefaultStatesGL();
-				glClear( GL_DEPTH_BUFFER_BIT );
-				drawObjects();
-			popAllGL();
+			drawView( mLeftTextureRenderer->size() );
 			mLeftTextureRenderer->release();
 
 			mEye->setViewOffset( QVector3D(mStereoEyeDistance/2.0f,0,0) );
 			mEye->setAspect( (float)mRightTextureRenderer->size().width()/mRightTextureRenderer->size().height() );
 			mRightTextureRenderer->bind();
-			pushAllGL();
-				applyDefaultStatesGL();
-				glClear( GL_DEPTH_BUFFER_BIT );
-				drawObjects();
-			popAllGL();
+			drawView( mRightTextureRenderer->size() );
 			mRightTextureRenderer->release();
 #ifdef OVR_ENABLED
 		}
@@ -417,6 +556,10 @@ void Scene::drawBackground( QPainter * painter, const QRectF & rect )
 		pushAllGL();
 			drawStereoFrameBuffers();
 		popAllGL();
+		mRenderTargets->release( mLeftTextureRenderer );
+		mRenderTargets->release( mRightTextureRenderer );
+		mLeftTextureRenderer = NULL;
+		mRightTextureRenderer = NULL;
 	}
 	else
 	{
@@ -424,13 +567,29 @@ void Scene::drawBackground( QPainter * painter, const QRectF & rect )
 		mEye->setPerspectiveOffset( QVector3D(0,0,0) );
 		mEye->setViewOffset( QVector3D(0,0,0) );
 		mEye->setAspect( (float)width()/height() );
-		pushAllGL();
-			applyDefaultStatesGL();
-			glClear( GL_DEPTH_BUFFER_BIT );
-			drawObjects();
-		popAllGL();
+		QSize size( (int)width(), (int)height() );
+		QSize sceneSize = mDynamicResolution ? mDynamicResolution->scaled( size ) : size;
+		if( sceneSize == size )
+		{
+			drawView( size );
+		}
+		else
+		{
+			// drawn at the reduced resolution and stretched over the window before the HUD is painted
+			TextureRenderer * sceneRenderer = mRenderTargets->acquire( sceneSize, GL_RGB8, !mPostProcess );
+			sceneRenderer->bind();
+			drawView( sceneSize );
+			sceneRenderer->release();
+			pushAllGL();
+				drawFrameBuffer( sceneRenderer );
+			popAllGL();
+			mRenderTargets->release( sceneRenderer );
+		}
 	}
 
+	if( mDynamicResolution )
+		mDynamicResolution->end();
+
 	mFrameCountSecond++;
 	drawFPS( painter, rect );
 	drawHUD( painter, rect );
@@ -451,7 +610,10 @@ void Scene::drawFPS( QPainter * painter, const QRectF & rect )
 {
 	painter->setPen( QColor(255,255,255) );
 	painter->setFont( mFont );
-	painter->drawText( rect, Qt::AlignTop | Qt::AlignRight, QString( tr("(%2s) %1 FPS") ).arg(mFramesPerSecond).arg(mDelta) );
+	QString text = QString( tr("(%2s) %1 FPS") ).arg(mFramesPerSecond).arg(mDelta);
+	if( mDynamicResolution && mDynamicResolution->scale() < 1.0f )
+		text += QString( tr(" @ %1%") ).arg( (int)( mDynamicResolution->scale() * 100.0f ) );
+	painter->drawText( rect, Qt::AlignTop | Qt::AlignRight, text );
 }
 
 
@@ -780,7 +942,6 @@ void Scene::keyReleaseEvent( QKeyEvent * event )
 void Scene::setSceneRect( const QRectF & rect )
 {
 	QGraphicsScene::setSceneRect( rect );
-	resizeStereoFrameBuffers( rect.size().toSize() );
 
 	static const float menuBorderFactor = 0.2f;
 	QSizeF menuBorderSize = menuBorderFactor * rect.size() * 0.5f;
@@ -789,23 +950,3 @@ void Scene::setSceneRect( const QRectF & rect )
 	QRect menuRect( menuPosition.toPoint(), menuSize.toSize() );
 	mStartMenuWindow->setGeometry( menuRect );
 }
-
-
-void Scene::resizeStereoFrameBuffers( const QSize & screenSize )
-{
-	delete mLeftTextureRenderer;
-	delete mRightTextureRenderer;
-	mLeftTextureRenderer = NULL;
-	mRightTextureRenderer = NULL;
-
-	if( mStereo )
-	{
-		QSize textureRendererSize = QSize( screenSize.width()/2, screenSize.height() );
-		if( textureRendererSize.width() < 1 )
-			textureRendererSize.setWidth( 1 );
-		if( textureRendererSize.height() < 1 )
-			textureRendererSize.setHeight( 1 );
-		mLeftTextureRenderer = new TextureRenderer( mGLWidget, textureRendererSize, true );
-		mRightTextureRenderer = new TextureRenderer( mGLWidget, textureRendererSize, true );
-	}
-}
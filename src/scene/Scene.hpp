@@ -32,6 +32,7 @@
 #include <QElapsedTimer>
 #include <QRectF>
 #include <QGLBuffer>
+#include <QVector>
 
 #ifdef OVR_ENABLED
 #include "OVR.h"
@@ -53,6 +54,12 @@ class StartMenuWindow;
 class AMouseListener;
 class AKeyListener;
 class TextureRenderer;
+class HiZBuffer;
+class LightGrid;
+class ShadowMap;
+class RenderTargetPool;
+class PostProcess;
+class DynamicResolution;
 class Shader;
 
 
@@ -77,6 +84,27 @@ public:
 
 	AObject * root() const { return mRoot; }
 	void setRoot( AObject * root ) { mRoot = root; }
+	/// Draws both passes of the root object - the depth of the first pass is copied for soft particles in the second
+	void drawRoot();
+
+	/// The pass objects are currently drawn in - objects are skipped if it is not in their render mask
+	const AObject::RenderPass & renderPass() const { return mRenderPass; }
+	void setRenderPass( const AObject::RenderPass & pass ) { mRenderPass = pass; }
+	/// Objects whose bounding sphere is completely behind this plane are skipped - a null vector disables culling
+	const QVector4D & cullPlane() const { return mCullPlane; }
+	void setCullPlane( const QVector4D & plane = QVector4D(0,0,0,0) ) { mCullPlane = plane; }
+	/// Occluder depth of the last frame for occlusion culling in the main pass - NULL if disabled
+	const HiZBuffer * hiZBuffer() const { return mHiZBuffer; }
+	/// Point lights of the main pass evaluated per fragment - NULL if disabled
+	LightGrid * lightGrid() const { return mLightGrid; }
+	/// Cascaded shadow map of the sun - NULL if unsupported
+	ShadowMap * shadowMap() const { return mShadowMap; }
+	/// Texture renderers shared by all passes
+	RenderTargetPool * renderTargets() const { return mRenderTargets; }
+	/// Color format of the frame buffer the main pass draws into
+	GLint colorFormat() const;
+	/// Measures the GPU frame time and scales the main pass - NULL if timer queries are unsupported
+	const DynamicResolution * dynamicResolution() const { return mDynamicResolution; }
 
 	Eye * eye() const { return mEye; }
 	void setEye( Eye * eye ) { mEye = eye; }
@@ -95,7 +123,7 @@ public:
 	bool wireFrame() const { return mWireFrame; }
 	void setMultiSample( bool enable ) { mMultiSample = enable; }
 	bool multiSample() const { return mMultiSample; }
-	void setStereo( bool enable ) { mStereo = enable; resizeStereoFrameBuffers(QSize(width(),height())); }
+	void setStereo( bool enable ) { mStereo = enable; }
 	bool stereo() const { return mStereo; }
 	void setStereoEyeDistance( float distance ) { mStereoEyeDistance = distance; }
 	float stereoEyeDistance() const { return mStereoEyeDistance; }
@@ -181,9 +209,22 @@ private:
 
 	TextureRenderer * mLeftTextureRenderer;
 	TextureRenderer * mRightTextureRenderer;
+	AObject::RenderPass mRenderPass;
+	QVector4D mCullPlane;
+	HiZBuffer * mHiZBuffer;
+	bool mHiZBufferUpdated;	///< Stereo views share the occluders drawn for the first one
+	LightGrid * mLightGrid;
+	ShadowMap * mShadowMap;
+	bool mShadowMapUpdated;	///< Stereo views share the cascades drawn for the first one
+	RenderTargetPool * mRenderTargets;
+	PostProcess * mPostProcess;
+	DynamicResolution * mDynamicResolution;
 
-	void resizeStereoFrameBuffers( const QSize & screenSize );
 	void drawStereoFrameBuffers();
+	/// Stretches the renderer's color over the bound frame buffer
+	void drawFrameBuffer( TextureRenderer * renderer );
+	/// Draws the objects into the bound frame buffer of the given size - through the post processing chain if enabled
+	void drawView( const QSize & size );
 	void drawFPS( QPainter * painter, const QRectF & rect );
 	void drawHUD( QPainter * painter, const QRectF & rect );
 	void applyDefaultStatesGL();
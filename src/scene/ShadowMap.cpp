@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ShadowMap.hpp"
+
+#include "TextureRenderer.hpp"
+#include "object/AObject.hpp"
+#include "object/Eye.hpp"
+
+#include <QGLShaderProgram>
+#include <QVector2D>
+#include <QDebug>
+#include <math.h>
+
+
+const ShadowMap * ShadowMap::sCurrent = NULL;
+int ShadowMap::sQuality = 2;
+int ShadowMap::sSize = 1024;
+float ShadowMap::sDistance = 300.0f;
+int ShadowMap::sVegetationBudget = 256;
+
+
+bool ShadowMap::supported()
+{
+	return GLEW_VERSION_1_4 || GLEW_ARB_shadow;
+}
+
+
+ShadowMap::ShadowMap( GLWidget * glWidget ) :
+	mGLWidget( glWidget ),
+	mRenderer( 0 ),
+	mCascades( 0 ),
+	mRendererSize( 0 ),
+	mLightDirection( 0, 1, 0 ),
+	mFrame( 0 ),
+	mValid( false ),
+	mVegetationCasters( 0 )
+{
+	for( int i = 0; i < maxCascades; ++i )
+	{
+		mCascade[i].radius = 0.0f;
+		mCascade[i].drawn = false;
+	}
+	qDebug() << "+" << this << "ShadowMap";
+}
+
+
+ShadowMap::~ShadowMap()
+{
+	qDebug() << "-" << this << "ShadowMap";
+	if( sCurrent == this )
+		sCurrent = NULL;
+	delete mRenderer;
+}
+
+
+QRect ShadowMap::tile( int cascade ) const
+{
+	int columns = mCascades > 1 ? 2 : 1;
+	return QRect( ( cascade % columns ) * mRendererSize, ( cascade / columns ) * mRendererSize, mRendererSize, mRendererSize );
+}
+
+
+void ShadowMap::update( AObject * root, const Eye * eye )
+{
+	++mFrame;
+	int cascades = sQuality > 0 ? sQuality + 1 : 0;
+	if( cascades != mCascades || sSize != mRendererSize )
+	{
+		// creating a renderer unbinds the current frame buffer
+		GLint frameBuffer;
+		glGetIntegerv( GL_FRAMEBUFFER_BINDING, &frameBuffer );
+		delete mRenderer;
+		mRenderer = 0;
+		mCascades = cascades;
+		mRendererSize = sSize;
+		if( mCascades > 0 )
+		{
+			int columns = mCascades > 1 ? 2 : 1;
+			int rows = ( mCascades + 1 ) / 2;
+			mRenderer = new TextureRenderer( mGLWidget, QSize( columns * mRendererSize, rows * mRendererSize ), true, GL_NONE );
+			glBindTexture( GL_TEXTURE_2D, mRenderer->depthID() );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+			glBindTexture( GL_TEXTURE_2D, 0 );
+		}
+		glBindFramebuffer( GL_FRAMEBUFFER, frameBuffer );
+		for( int i = 0; i < maxCascades; ++i )
+			mCascade[i].drawn = false;
+		mValid = false;
+	}
+	if( !mCascades )
+		return;
+	mEyePosition = eye->viewMatrixInverse().column( 3 ).toVector3D();
+
+	// practical split scheme - blends logarithmic and uniform splits
+	float nearPlane = eye->nearPlane();
+	float farPlane = qMax( nearPlane + 1.0f, qMin( eye->farPlane(), sDistance ) );
+	float splits[maxCascades+1];
+	for( int i = 0; i <= mCascades; ++i )
+	{
+		float f = (float)i / (float)mCascades;
+		float logSplit = nearPlane * powf( farPlane / nearPlane, f );
+		float uniformSplit = nearPlane + ( farPlane - nearPlane ) * f;
+		splits[i] = 0.75f * logSplit + 0.25f * uniformSplit;
+	}
+
+	bool rendererBound = false;
+	for( int i = 0; i < mCascades; ++i )
+	{
+		Cascade & c = mCascade[i];
+		QVector3D center;
+		float radius;
+		fit( eye, splits[i], splits[i+1], center, radius );
+
+		// cascade n is due every 2^n frames - the slots of far cascades never coincide
+		bool due = i == 0 || ( mFrame % ( 1u << i ) ) == ( 1u << ( i-1 ) );
+		float drift = ( center - c.center ).length();
+		float margin = radius * 0.1f;
+		bool stale = !c.drawn || c.radius != radius || drift > margin;
+		bool changed = i == 0 || drift > margin * 0.5f ||
+			QVector3D::dotProduct( c.lightDirection, mLightDirection ) < 0.99998f;
+		if( !stale && !( due && changed ) )
+			continue;
+
+		if( !rendererBound )
+		{
+			mRenderer->bind();
+			glPushAttrib( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT | GL_POLYGON_BIT | GL_SCISSOR_BIT );
+			glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+			glEnable( GL_DEPTH_TEST );
+			glDepthMask( GL_TRUE );
+			glDisable( GL_LIGHTING );
+			glDisable( GL_TEXTURE_2D );
+			glDisable( GL_BLEND );
+			glDisable( GL_CULL_FACE );
+			glEnable( GL_POLYGON_OFFSET_FILL );
+			glPolygonOffset( 1.1f, 4.0f );
+			glEnable( GL_SCISSOR_TEST );
+			glMatrixMode( GL_PROJECTION );	glPushMatrix();
+			glMatrixMode( GL_MODELVIEW );	glPushMatrix();
+			rendererBound = true;
+		}
+		draw( root, i, center, radius );
+	}
+
+	if( rendererBound )
+	{
+		glMatrixMode( GL_PROJECTION );	glPopMatrix();
+		glMatrixMode( GL_MODELVIEW );	glPopMatrix();
+		glPopAttrib();
+		mRenderer->release();
+	}
+	mValid = true;
+}
+
+
+void ShadowMap::fit( const Eye * eye, float nearDistance, float farDistance, QVector3D & center, float & radius ) const
+{
+	// corners of the view frustum's slice in world coordinates
+	const QMatrix4x4 & projection = eye->projectionMatrix();
+	QMatrix4x4 inverse = ( projection * eye->viewMatrix() ).inverted();
+	QVector3D corners[8];
+	for( int i = 0; i < 8; ++i )
+	{
+		float depth = ( i & 4 ) ? farDistance : nearDistance;
+		float z = ( projection(2,3) - projection(2,2) * depth ) / depth;
+		corners[i] = inverse.map( QVector3D( ( i & 1 ) ? 1.0f : -1.0f, ( i & 2 ) ? 1.0f : -1.0f, z ) );
+	}
+
+	// a bounding sphere keeps the cascade's size while the eye turns
+	center = QVector3D( 0, 0, 0 );
+	for( int i = 0; i < 8; ++i )
+		center += corners[i];
+	center /= 8.0f;
+	radius = 0.0f;
+	for( int i = 0; i < 8; ++i )
+		radius = qMax( radius, ( corners[i] - center ).length() );
+	// leave room for the eye to move until the cascade is drawn again
+	radius = ceilf( radius * 1.1f );
+
+	// move in steps of whole texels to keep the edges of shadows from flickering
+	QVector3D up = fabsf( mLightDirection.y() ) > 0.99f ? QVector3D( 0, 0, 1 ) : QVector3D( 0, 1, 0 );
+	QMatrix4x4 rotation;
+	rotation.lookAt( QVector3D( 0, 0, 0 ), -mLightDirection, up );
+	float texel = 2.0f * radius / (float)mRendererSize;
+	QVector3D snapped = rotation.map( center );
+	snapped.setX( floorf( snapped.x() / texel ) * texel );
+	snapped.setY( floorf( snapped.y() / texel ) * texel );
+	center = rotation.inverted().map( snapped );
+}
+
+
+void ShadowMap::draw( AObject * root, int cascade, const QVector3D & center, float radius )
+{
+	Cascade & c = mCascade[cascade];
+
+	// casters up to this distance behind the slice throw shadows into it
+	float casterDistance = radius + sDistance * 0.5f;
+	QVector3D up = fabsf( mLightDirection.y() ) > 0.99f ? QVector3D( 0, 0, 1 ) : QVector3D( 0, 1, 0 );
+	QMatrix4x4 view;
+	view.lookAt( center + mLightDirection * casterDistance, center, up );
+	QMatrix4x4 projection;
+	projection.ortho( -radius, radius, -radius, radius, 0.0f, casterDistance + radius );
+
+	QRect rect = tile( cascade );
+	glViewport( rect.x(), rect.y(), rect.width(), rect.height() );
+	glScissor( rect.x(), rect.y(), rect.width(), rect.height() );
+	glClear( GL_DEPTH_BUFFER_BIT );
+	glMatrixMode( GL_PROJECTION );
+	glLoadMatrix( projection );
+	glMatrixMode( GL_MODELVIEW );
+
+	mDrawView = view;
+	mDrawFrustum.sync( projection, view );
+	mVegetationCasters = sVegetationBudget;
+	root->drawShadowCasters( *this );
+
+	QMatrix4x4 bias;
+	bias.translate( 0.5f, 0.5f, 0.5f );
+	bias.scale( 0.5f );
+	c.matrix = bias * projection * view;
+	c.center = center;
+	c.radius = radius;
+	c.lightDirection = mLightDirection;
+	c.drawn = true;
+}
+
+
+int ShadowMap::bind( QGLShaderProgram * program, int texUnit ) const
+{
+	QMatrix4x4 matrices[maxCascades];
+	QVector4D tiles[maxCascades];
+	QSizeF size = mRenderer->size();
+	for( int i = 0; i < mCascades; ++i )
+	{
+		matrices[i] = mCascade[i].matrix * mViewInverse;
+		QRect rect = tile( i );
+		tiles[i] = QVector4D( rect.x() / size.width(), rect.y() / size.height(),
+			rect.width() / size.width(), rect.height() / size.height() );
+	}
+
+	glActiveTexture( GL_TEXTURE0 + texUnit );
+	glBindTexture( GL_TEXTURE_2D, mRenderer->depthID() );
+	glActiveTexture( GL_TEXTURE0 );
+	program->setUniformValue( "shadowEnabled", (GLint)true );
+	program->setUniformValue( "shadowMap", texUnit );
+	program->setUniformValueArray( "shadowMatrix", matrices, mCascades );
+	program->setUniformValueArray( "shadowTiles", tiles, mCascades );
+	program->setUniformValue( "shadowCascades", (GLint)mCascades );
+	program->setUniformValue( "shadowFilter", (GLint)( sQuality >= 2 ) );
+	program->setUniformValue( "shadowTexelSize", QVector2D( 1.0f / size.width(), 1.0f / size.height() ) );
+	return texUnit + 1;
+}
+
+
+int ShadowMap::bindCurrent( QGLShaderProgram * program, int texUnit )
+{
+	if( sCurrent && sCurrent->valid() )
+		return sCurrent->bind( program, texUnit );
+	// the shadow sampler still needs a unit of its own, sharing one with a sampler of another type is invalid
+	program->setUniformValue( "shadowEnabled", (GLint)false );
+	program->setUniformValue( "shadowMap", texUnit );
+	return texUnit + 1;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2013
+ * Branimir Djordjevic <branimir.djordjevic@gmail.com>
+ * Tobias Himmer <provisorisch@online.de>
+ * Michael Wydler <michael.wydler@gmail.com>
+ * Karl-Heinz Zimmermann <karlzimmermann3787@gmail.com>
+ *
+ * This file is part of Ununoctium.
+ *
+ * Ununoctium is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * Ununoctium is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ununoctium. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCENE_SHADOWMAP_INCLUDED
+#define SCENE_SHADOWMAP_INCLUDED
+
+
+#include <GLWidget.hpp>
+#include <utility/FrustumTest.hpp>
+
+#include <QVector3D>
+#include <QVector4D>
+#include <QMatrix4x4>
+#include <QRect>
+
+
+class QGLShaderProgram;
+class TextureRenderer;
+class AObject;
+class Eye;
+
+
+/// Cascaded shadow maps for a directional light
+/**
+ * The range from the eye's near plane to the shadow distance is split into cascades,
+ * each covering its slice of the view frustum with an orthographic projection along the light.
+ * All cascades are drawn into tiles of one depth texture.\n
+ * The first cascade is drawn every frame, cascade n every 2^n frames, so at most two cascades are drawn per frame.
+ * Far cascades are kept if neither the light nor their fit changed noticeably since they were drawn.
+ * Shadow casters are culled per cascade (see AObject::drawShadowCasters()) and vegetation is drawn up to a budget per cascade.
+ */
+class ShadowMap
+{
+public:
+	static const int maxCascades = 4;
+
+	ShadowMap( GLWidget * glWidget );
+	~ShadowMap();
+
+	/// Sets the direction pointing to the light
+	void setLightDirection( const QVector3D & direction ) { mLightDirection = direction.normalized(); }
+	/// Draws the cascades due this frame from the root's shadow casters
+	void update( AObject * root, const Eye * eye );
+	/// Returns false if the quality disables shadows or nothing was drawn yet
+	bool valid() const { return mCascades > 0 && mValid; }
+	/// Sets the inverse view matrix of the view shaders look up the shadows from
+	void setViewInverse( const QMatrix4x4 & viewInverse ) { mViewInverse = viewInverse; }
+
+	/// Light view matrix of the cascade being drawn
+	const QMatrix4x4 & viewMatrix() const { return mDrawView; }
+	/// Returns true if the sphere in world coordinates lies within the cascade being drawn
+	bool isSphereInCascade( const QVector3D & center, float radius ) const { return mDrawFrustum.isSphereInFrustum( center, radius ); }
+	/// Takes up to the wanted number of instances from the vegetation budget of the cascade being drawn and returns how many were granted
+	int grantVegetationCasters( int wanted ) { int granted = qBound( 0, wanted, mVegetationCasters ); mVegetationCasters -= granted; return granted; }
+	/// Position of the eye the cascades are fit to in world coordinates
+	const QVector3D & eyePosition() const { return mEyePosition; }
+
+	/// Binds the depth texture to the given unit and sets the shader's shadow uniforms - returns the next free unit
+	int bind( QGLShaderProgram * program, int texUnit ) const;
+
+	/// The shadow map shaders read from - NULL disables shadows
+	static const ShadowMap * current() { return sCurrent; }
+	static void setCurrent( const ShadowMap * shadowMap ) { sCurrent = shadowMap; }
+	/// Binds the current shadow map to the shader or disables shadows there - returns the next free texture unit
+	static int bindCurrent( QGLShaderProgram * program, int texUnit );
+
+	/// 0 disables shadows, 1 to 3 use 2 to 4 cascades - filtered from 2 on.
+	static int quality() { return sQuality; }
+	static void setQuality( int quality ) { sQuality = qBound( 0, quality, 3 ); }
+	/// Edge length of a cascade's tile in texels.
+	static int size() { return sSize; }
+	static void setSize( int size ) { sSize = qMax( 128, size ); }
+	/// Shadows end at this distance or the eye's far plane.
+	static float distance() { return sDistance; }
+	static void setDistance( float distance ) { sDistance = distance; }
+	/// Vegetation instances drawn per cascade.
+	static int vegetationBudget() { return sVegetationBudget; }
+	static void setVegetationBudget( int budget ) { sVegetationBudget = qMax( 0, budget ); }
+
+	/// Returns true if depth textures with comparison are available
+	static bool supported();
+
+private:
+	struct Cascade
+	{
+		QMatrix4x4 matrix;	///< World to tile coordinates of the last drawn depth
+		QVector3D center;
+		float radius;
+		QVector3D lightDirection;
+		bool drawn;
+	};
+
+	GLWidget * mGLWidget;
+	TextureRenderer * mRenderer;
+	int mCascades;
+	int mRendererSize;
+	Cascade mCascade[maxCascades];
+	QVector3D mLightDirection;
+	QMatrix4x4 mViewInverse;
+	QVector3D mEyePosition;
+	unsigned int mFrame;
+	bool mValid;
+
+	QMatrix4x4 mDrawView;
+	FrustumTest mDrawFrustum;
+	int mVegetationCasters;
+
+	void fit( const Eye * eye, float nearDistance, float farDistance, QVector3D & center, float & radius ) const;
+	void draw( AObject * root, int cascade, const QVector3D & center, float radius );
+	QRect tile( int cascade ) const;
+
+	static const ShadowMap * sCurrent;
+	static int sQuality;
+	static int sSize;
+	static float sDistance;
+	static int sVegetationBudget;
+};
+
+
+#endif
@@ -27,36 +27,41 @@
 #include <QDebug>
 
 
-TextureRenderer::TextureRenderer( GLWidget * glWidget, const QSize & size, bool depthBuffer ) :
+TextureRenderer::TextureRenderer( GLWidget * glWidget, const QSize & size, bool depthBuffer, GLint format ) :
 	mLastFrameBuffer( 0 ),
-	mLastRenderBuffer( 0 ),
 	mFrameBuffer( 0 ),
-	mDepthBuffer( 0 ),
 	mTex( 0 ),
 	mDepth( 0 ),
 	mGLWidget( glWidget ),
 	mHasDepthBuffer( depthBuffer ),
-	mSize( size )
+	mSize( size ),
+	mFormat( format )
 {
-	glGenTextures( 1, &mTex );
-	glBindTexture( GL_TEXTURE_2D, mTex );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-	glTexImage2D( GL_TEXTURE_2D, 0, 3, mSize.width(), mSize.height(), 0, GL_RGB, GL_UNSIGNED_BYTE, NULL );
-
 	glGenFramebuffers( 1, &mFrameBuffer );
 	glBindFramebuffer( GL_FRAMEBUFFER, mFrameBuffer );
-	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTex, 0 );
 
-	if( mHasDepthBuffer )
+	if( mFormat != GL_NONE )
+	{
+		glGenTextures( 1, &mTex );
+		glBindTexture( GL_TEXTURE_2D, mTex );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glTexImage2D( GL_TEXTURE_2D, 0, mFormat, mSize.width(), mSize.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTex, 0 );
+	}
+	else
 	{
-		glGenRenderbuffers( 1, &mDepthBuffer );
-		glBindRenderbuffer( GL_RENDERBUFFER, mDepthBuffer );
-		glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mSize.width(), mSize.height() );
-		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthBuffer );
+		// frame buffers without color attachment are only complete if they neither draw nor read color
+		glDrawBuffer( GL_NONE );
+		glReadBuffer( GL_NONE );
+	}
 
+	if( mHasDepthBuffer )
+	{
+		// the depth texture is attached directly - a render buffer in addition would only take up memory
 		glGenTextures( 1, &mDepth );
 		glBindTexture( GL_TEXTURE_2D, mDepth );
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
@@ -74,7 +79,6 @@ TextureRenderer::TextureRenderer( GLWidget * glWidget, const QSize & size, bool
 		qFatal( "Could not create FBO (%dx%d%s): %s\n", mSize.width(), mSize.height(), (mHasDepthBuffer?"+depth":""), qPrintable(glGetFrameBufferStatusString(status)) );
 	}
 	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
 	glBindTexture( GL_TEXTURE_2D, 0 );
 }
 
@@ -83,8 +87,6 @@ TextureRenderer::~TextureRenderer()
 {
 	if( mFrameBuffer )
 		glDeleteFramebuffers( 1,&mFrameBuffer );
-	if( mDepthBuffer )
-		glDeleteRenderbuffers( 1,&mDepthBuffer );
 	if( mTex )
 		glDeleteTextures( 1, &mTex );
 	if( mDepth )
@@ -95,9 +97,7 @@ TextureRenderer::~TextureRenderer()
 void TextureRenderer::bind()
 {
 	glGetIntegerv( GL_FRAMEBUFFER_BINDING, (GLint*)&mLastFrameBuffer );
-	glGetIntegerv( GL_RENDERBUFFER_BINDING, (GLint*)&mLastRenderBuffer );
 	glBindFramebuffer( GL_FRAMEBUFFER, mFrameBuffer );
-	glBindRenderbuffer( GL_RENDERBUFFER, mDepthBuffer );
 	glPushAttrib( GL_VIEWPORT_BIT );
 	glViewport( 0, 0, size().width(), size().height() );
 }
@@ -107,5 +107,4 @@ void TextureRenderer::release()
 {
 	glPopAttrib();
 	glBindFramebuffer( GL_FRAMEBUFFER, mLastFrameBuffer );
-	glBindRenderbuffer( GL_RENDERBUFFER, mLastRenderBuffer );
 }
@@ -33,17 +33,18 @@ class TextureRenderer
 {
 	private:
 		GLuint mLastFrameBuffer;
-		GLuint mLastRenderBuffer;
 		GLuint mFrameBuffer;
-		GLuint mDepthBuffer;
 		GLuint mTex;
 		GLuint mDepth;
 		GLWidget * mGLWidget;
 		bool mHasDepthBuffer;
 		QSize mSize;
+		GLint mFormat;
 
 	public:
-		TextureRenderer( GLWidget * glWidget, const QSize & size, bool depthBuffer );
+		/// Creates a color texture of the given internal format and a depth texture if depthBuffer is set
+		/** A format of GL_NONE creates no color texture - depth only renderers still need the depth buffer. */
+		TextureRenderer( GLWidget * glWidget, const QSize & size, bool depthBuffer, GLint format = GL_RGB8 );
 		~TextureRenderer();
 
 		void bind();
@@ -53,6 +54,7 @@ class TextureRenderer
 		GLuint depthID() const { return mDepth; }
 		bool hasDepthBuffer() const { return mHasDepthBuffer; }
 		const QSize & size() const { return mSize; }
+		GLint format() const { return mFormat; }
 };
 
 
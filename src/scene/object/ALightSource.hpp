@@ -23,6 +23,7 @@
 
 
 class Scene;
+class LightGrid;
 
 
 /// Abstract base class for light sources
@@ -30,6 +31,11 @@ class ALightSource
 {
 public:
 	virtual void updateLightSource( GLenum light ) = 0;
+	/// Adds the source's point lights to a grid evaluated per fragment
+	/**
+	 * @return False if the source can only be lit through a fixed function light, which updateLightSource() sets instead.
+	 */
+	virtual bool addLights( LightGrid & grid ) { Q_UNUSED( grid ); return false; }
 };
 
 
@@ -24,6 +24,8 @@
 #include "AObject.hpp"
 
 #include <scene/Scene.hpp>
+#include <scene/HiZBuffer.hpp>
+#include <scene/ShadowMap.hpp>
 #include <GLWidget.hpp>
 
 #include <float.h>
@@ -35,6 +37,7 @@ AObject::AObject( Scene * scene, float boundingSphereRadius ) :
 	mPosition( 0, 0, 0 ),
 	mRotation(),
 	mBoundingSphereRadius( boundingSphereRadius ),
+	mRenderMask( ALL_PASSES ),
 	mSubNodes(),
 	mModelMatrix(),
 	mModelMatrixNeedsUpdate( true )
@@ -48,6 +51,7 @@ AObject::AObject( const AObject & other ) :
 	mPosition( other.mPosition ),
 	mRotation( other.mRotation ),
 	mBoundingSphereRadius( other.mBoundingSphereRadius ),
+	mRenderMask( other.mRenderMask ),
 	mSubNodes( other.mSubNodes ),
 	mModelMatrix( other.mModelMatrix ),
 	mModelMatrixNeedsUpdate( other.mModelMatrixNeedsUpdate )
@@ -69,6 +73,7 @@ AObject & AObject::operator=( const AObject & other )
 	mPosition = other.mPosition;
 	mRotation = other.mRotation;
 	mBoundingSphereRadius = other.mBoundingSphereRadius;
+	mRenderMask = other.mRenderMask;
 	mSubNodes = other.mSubNodes;
 	mModelMatrixNeedsUpdate = other.mModelMatrixNeedsUpdate;
 	return *this;
@@ -128,9 +133,11 @@ void AObject::draw()
 	QList< QSharedPointer<AObject> >::iterator i;
 	for( i = mSubNodes.begin(); i != mSubNodes.end(); ++i )
 	{
+		if( !(*i)->isInRenderPass() )
+			continue;
 		if( (*i)->boundingSphereRadius() > FLT_EPSILON )	// nonzero radius -> do frustum culling
 		{
-			if( mFrustumTest.isSphereInFrustum( (*i)->position(), (*i)->boundingSphereRadius() ) )
+			if( mFrustumTest.isSphereInFrustum( (*i)->position(), (*i)->boundingSphereRadius() ) && !(*i)->isOccluded() )
 			{
 				(*i)->draw();
 			}
@@ -155,9 +162,11 @@ void AObject::draw2()
 	QList< QSharedPointer<AObject> >::iterator i;
 	for( i = mSubNodes.begin(); i != mSubNodes.end(); ++i )
 	{
+		if( !(*i)->isInRenderPass() )
+			continue;
 		if( (*i)->boundingSphereRadius() > FLT_EPSILON )	// nonzero radius -> do frustum culling
 		{
-			if( mFrustumTest.isSphereInFrustum( (*i)->position(), (*i)->boundingSphereRadius() ) )
+			if( mFrustumTest.isSphereInFrustum( (*i)->position(), (*i)->boundingSphereRadius() ) && !(*i)->isOccluded() )
 			{
 				(*i)->draw2();
 			}
@@ -171,6 +180,48 @@ void AObject::draw2()
 }
 
 
+bool AObject::isInRenderPass() const
+{
+	if( !( mRenderMask & mScene->renderPass() ) )
+		return false;
+	const QVector4D & plane = mScene->cullPlane();
+	if( mBoundingSphereRadius > FLT_EPSILON && !plane.isNull() )
+		return QVector4D::dotProduct( plane, QVector4D( worldPosition(), 1.0f ) ) > -mBoundingSphereRadius;
+	return true;
+}
+
+
+bool AObject::isOccluded() const
+{
+	return mScene->renderPass() == MAIN_PASS && mScene->hiZBuffer() &&
+		mScene->hiZBuffer()->isSphereOccluded( worldPosition(), mBoundingSphereRadius );
+}
+
+
+void AObject::drawOccluders()
+{
+	glLoadMatrix( mScene->eye()->viewMatrix() * modelMatrix() );
+	drawOccluderSelf();
+	QList< QSharedPointer<AObject> >::iterator i;
+	for( i = mSubNodes.begin(); i != mSubNodes.end(); ++i )
+		(*i)->drawOccluders();
+}
+
+
+void AObject::drawShadowCasters( ShadowMap & shadowMap )
+{
+	glLoadMatrix( shadowMap.viewMatrix() * modelMatrix() );
+	drawShadowCasterSelf( shadowMap );
+	QList< QSharedPointer<AObject> >::iterator i;
+	for( i = mSubNodes.begin(); i != mSubNodes.end(); ++i )
+	{
+		if( (*i)->boundingSphereRadius() > FLT_EPSILON && !shadowMap.isSphereInCascade( (*i)->worldPosition(), (*i)->boundingSphereRadius() ) )
+			continue;
+		(*i)->drawShadowCasters( shadowMap );
+	}
+}
+
+
 void AObject::add( QSharedPointer<AObject> other )
 {
 	if( other->parent() )
@@ -236,4 +287,12 @@ QVector<const AObject*> AObject::collideSphere( const AObject * exclude, const f
 }
 
 
+void AObject::addColliders( ColliderGrid & grid ) const
+{
+	QList< QSharedPointer<AObject> >::const_iterator i;
+	for( i = mSubNodes.constBegin(); i != mSubNodes.constEnd(); ++i )
+		(*i)->addColliders( grid );
+}
+
+
 bool AObject::sDebugBoundingSpheres = false;
@@ -37,6 +37,8 @@
 
 
 class Scene;
+class ColliderGrid;
+class ShadowMap;
 
 
 /// Abstract object in a scene
@@ -151,6 +153,17 @@ public:
 	/// Returns the bounding sphere
 	const float & boundingSphereRadius() const { return mBoundingSphereRadius; }
 
+	/// Passes of the scene an object can be drawn in
+	enum RenderPass
+	{
+		MAIN_PASS	= 1,	///< The eye's view
+		REFLECTION_PASS	= 2,	///< The mirrored view for water reflections
+		ALL_PASSES	= MAIN_PASS | REFLECTION_PASS
+	};
+	/// Passes this object and its subordinates are drawn in - see Scene::renderPass()
+	const int & renderMask() const { return mRenderMask; }
+	void setRenderMask( const int & mask ) { mRenderMask = mask; }
+
 	/// Recursively intersect a line with an object and the object's objects
 	/**
 	 * @param exclude Exclude this object and all subordinates - NULL to disable exclusion.
@@ -173,6 +186,12 @@ public:
 	virtual QVector<const AObject*> collideSphere( const AObject * exclude, const float & radius,
 		QVector3D & center, QVector3D * normal = NULL ) const;
 
+	/// Recursively adds static colliders of an object and the object's objects to a grid - for particle collision
+	/**
+	 * Only objects which never move should add colliders, as the grid is built once.
+	 */
+	virtual void addColliders( ColliderGrid & grid ) const;
+
 	/// Updates this object and all of it's sub-objects
 	void update( const double & delta );
 	/// Abstract method for updating this object
@@ -201,6 +220,16 @@ public:
 	/// Executed after all sub-objects are drawn (second pass)
 	virtual void draw2SelfPost() {}
 
+	/// Draws the depth of this object's and all of it's sub-objects' occluders - for occlusion culling
+	void drawOccluders();
+	/// Draws large, cheap geometry hiding other objects - only depth is written, materials are not needed
+	virtual void drawOccluderSelf() {}
+
+	/// Draws the depth of this object's and all of it's sub-objects' shadow casters into the shadow map's current cascade
+	void drawShadowCasters( ShadowMap & shadowMap );
+	/// Draws geometry casting the sun's shadow - only depth is written, materials are not needed
+	virtual void drawShadowCasterSelf( ShadowMap & shadowMap ) { Q_UNUSED( shadowMap ); }
+
 	/// Causes all objects to draw the bounding sphere
 	static void setGlobalDebugBoundingSpheres( bool enable ) { sDebugBoundingSpheres = enable; }
 
@@ -217,6 +246,7 @@ private:
 	QVector3D mPosition;
 	QQuaternion mRotation;
 	float mBoundingSphereRadius;
+	int mRenderMask;
 	QList< QSharedPointer<AObject> > mSubNodes;
 	FrustumTest mFrustumTest;
 	QMatrix4x4 mModelViewMatrix;
@@ -231,6 +261,10 @@ private:
 	void validateMatrix() const { if( mModelMatrixNeedsUpdate ) { syncMatrix(); mModelMatrixNeedsUpdate = false; } }
 
 	void setParent( AObject * parent ) { mParent = parent; }
+	/// Returns false if the scene's current pass is not in this object's render mask or if the object is behind the scene's cull plane
+	bool isInRenderPass() const;
+	/// Returns true if the scene's occlusion culling found this object hidden in the main pass
+	bool isOccluded() const;
 };
 
 
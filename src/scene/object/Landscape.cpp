@@ -30,7 +30,12 @@
 
 #include <scene/Scene.hpp>
 #include <scene/TextureRenderer.hpp>
+#include <scene/RenderTargetPool.hpp>
+#include <scene/LightGrid.hpp>
+#include <scene/ShadowMap.hpp>
+#include <scene/DynamicResolution.hpp>
 #include <geometry/Terrain.hpp>
+#include <geometry/ParticleSystem.hpp>
 
 #include <resource/Material.hpp>
 #include <resource/Shader.hpp>
@@ -41,6 +46,10 @@
 
 
 int Landscape::Blob::sQuality = 0;
+bool Landscape::sSinglePassTerrain = true;
+float Landscape::sReflectionScale = 0.5f;
+int Landscape::sReflectionInterval = 2;
+bool Landscape::sScreenSpaceReflection = false;
 
 
 Landscape::Landscape( World * world, QString name ) :
@@ -48,7 +57,6 @@ Landscape::Landscape( World * world, QString name ) :
 {
 	mName = name;
 	mDrawingReflection = false;
-	mDrawingRefraction = false;
 
 	QSettings s( "./data/landscape/"+name+"/landscape.ini", QSettings::IniFormat );
 
@@ -86,8 +94,13 @@ Landscape::Landscape( World * world, QString name ) :
 		qFatal( "\"%s\" not found!", qPrintable("./data/landscape/"+name+'/'+"water.png") );
 	}
 	mWaterMap = scene()->glWidget()->bindTexture( waterImage );
-	mReflectionRenderer = new TextureRenderer( scene()->glWidget(), QSize(512,512), true );
-	mRefractionRenderer = new TextureRenderer( scene()->glWidget(), QSize(512,512), true );
+	mSplatterMap = 0;
+	// both are taken from the scene's render targets when the viewport size is known
+	mReflectionRenderer = NULL;
+	mReflectionAge = 0;
+	mReflectionAbove = true;
+	mReflectionLevel = 0;
+	mRefractionRenderer = NULL;
 
 	int blobNum = s.beginReadArray( "Blob" );
 		for( int i=0; i<blobNum; i++ )
@@ -106,6 +119,7 @@ Landscape::Landscape( World * world, QString name ) :
 			mBlobs.append( b );
 		}
 	s.endArray();
+	mSplatMap = new SplatMap( this, terrainMaterial, mTerrainMaterialScale );
 
 	int vegeNum = s.beginReadArray( "Vegetation" );
 		for( int i=0; i<vegeNum; i++ )
@@ -163,9 +177,9 @@ Landscape::~Landscape()
 	}
 	delete mTerrain;
 	delete mTerrainFilter;
+	delete mSplatMap;
 	delete mTerrainMaterial;
-	delete mReflectionRenderer;
-	delete mRefractionRenderer;
+	scene()->renderTargets()->release( mReflectionRenderer );
 	delete mWaterShader;
 }
 
@@ -173,6 +187,10 @@ Landscape::~Landscape()
 void Landscape::updateSelf( const double & delta )
 {
 	mTerrainFilter->update();
+	++mReflectionAge;
+	// the dynamic resolution only reduces detail once its scale is at the minimum
+	const DynamicResolution * timing = scene()->dynamicResolution();
+	mReflectionLevel = timing ? timing->reduction() : 0;
 }
 
 
@@ -191,6 +209,21 @@ void Landscape::drawSelfPost()
 }
 
 
+void Landscape::drawOccluderSelf()
+{
+	// hills hide vegetation, creatures and power ups behind them
+	mTerrainFilter->draw( true );
+}
+
+
+void Landscape::drawShadowCasterSelf( ShadowMap & shadowMap )
+{
+	Q_UNUSED( shadowMap );
+	// the filter culls its patches against the cascade's matrices
+	mTerrainFilter->draw( true );
+}
+
+
 void Landscape::drawInfinitePlane( const float & height )
 {
 	QVector2D groundPlaneFrom
@@ -220,8 +253,48 @@ void Landscape::drawInfinitePlane( const float & height )
 }
 
 
+bool Landscape::waterVisible()
+{
+	// the water plane is visible if it splits the view frustum
+	const Eye * eye = scene()->eye();
+	QMatrix4x4 clipToWorld = ( eye->projectionMatrix() * eye->viewMatrix() ).inverted();
+	bool above = false;
+	bool below = false;
+	for( int i = 0; i < 8; ++i )
+	{
+		QVector4D corner = clipToWorld * QVector4D( (i&1) ? 1.0f : -1.0f, (i&2) ? 1.0f : -1.0f, (i&4) ? 1.0f : -1.0f, 1.0f );
+		if( corner.y() / corner.w() > mWaterHeight )
+			above = true;
+		else
+			below = true;
+	}
+	return above && below;
+}
+
+
 void Landscape::renderReflection()
 {
+	GLint viewport[4];
+	glGetIntegerv( GL_VIEWPORT, viewport );
+	float scale = sReflectionScale / (float)( 1 << ( mReflectionLevel / 2 ) );
+	int interval = sReflectionInterval << ( ( mReflectionLevel + 1 ) / 2 );
+	QSize size( qMax( 64, (int)( viewport[2] * scale ) ), qMax( 64, (int)( viewport[3] * scale ) ) );
+	bool above = scene()->eye()->position().y() > mWaterHeight;
+	if( mReflectionRenderer && mReflectionRenderer->size() == size && mReflectionAge < interval && mReflectionAbove == above )
+		return;	// still recent enough to be reprojected
+	if( !mReflectionRenderer || mReflectionRenderer->size() != size )
+	{
+		// kept across frames for reprojection - the refraction's target is only held while the water is drawn
+		// the old size is only used again if the viewport or the reflection level changes back
+		scene()->renderTargets()->discard( mReflectionRenderer );
+		mReflectionRenderer = scene()->renderTargets()->acquire( size );
+	}
+	mReflectionAge = 0;
+	mReflectionAbove = above;
+	mReflectionMatrix = scene()->eye()->projectionMatrix() * scene()->eye()->viewMatrix();
+
+	MaterialQuality::Type defaultQuality = MaterialQuality::maximum();
+	MaterialQuality::setMaximum( MaterialQuality::LOW );
 	mDrawingReflection = true;
 	mReflectionRenderer->bind();
 	glClear( GL_DEPTH_BUFFER_BIT );
@@ -238,64 +311,72 @@ void Landscape::renderReflection()
 	mirroredEye.setRotation( r );
 	mirroredEye.setPositionY( -mirroredEye.position().y() + 2*mWaterHeight);
 	mirroredEye.setScale( QVector3D( 1,-1, 1 ) );
-	if( scene()->eye()->position().y()>mWaterHeight )
+	if( above )
 		mirroredEye.setClippingPlane( 0, QVector4D(0,1,0, -mWaterHeight+mWaterClippingPlaneOffset) );
 	else
 		mirroredEye.setClippingPlane( 0, QVector4D(0,-1,0, mWaterHeight+mWaterClippingPlaneOffset) );
 	scene()->setEye( &mirroredEye );
 
+	// objects on the other side of the water, small vegetation and particles are not reflected
+	scene()->setRenderPass( REFLECTION_PASS );
+	if( above )
+		scene()->setCullPlane( QVector4D( 0, 1, 0, -mWaterHeight ) );
+	else
+		scene()->setCullPlane( QVector4D( 0, -1, 0, mWaterHeight ) );
+
 	glFrontFace( GL_CW );
 	scene()->eye()->applyGL();
 	scene()->eye()->enableClippingPlanes();
-	scene()->root()->draw();
-	scene()->root()->draw2();
+	scene()->drawRoot();
 	glFrontFace( GL_CCW );
 	scene()->eye()->setClippingPlane( 0 );
 
+	scene()->setCullPlane();
+	scene()->setRenderPass( MAIN_PASS );
 	scene()->setEye( sceneEye );
 
 	glMatrixMode( GL_PROJECTION ); glPopMatrix();
 	glMatrixMode( GL_MODELVIEW ); glPopMatrix();
 	mReflectionRenderer->release();
 	mDrawingReflection = false;
+	MaterialQuality::setMaximum( defaultQuality );
 }
 
 
-void Landscape::renderRefraction()
+void Landscape::copyRefraction()
 {
-	mDrawingRefraction = true;
-	mRefractionRenderer->bind();
-	glClear( GL_DEPTH_BUFFER_BIT );
-	glMatrixMode( GL_PROJECTION );	glPushMatrix();	glLoadIdentity();
-	glMatrixMode( GL_MODELVIEW );	glPushMatrix();	glLoadIdentity();
-	if( scene()->eye()->position().y()>mWaterHeight )
-		scene()->eye()->setClippingPlane( 0, QVector4D(0,-1,0, mWaterHeight+mWaterClippingPlaneOffset) );
+	// everything below the water has already been drawn in the main pass - its color and depth are copied instead of rendering it again
+	GLint viewport[4];
+	glGetIntegerv( GL_VIEWPORT, viewport );
+	QSize size( viewport[2], viewport[3] );
+	mRefractionRenderer = scene()->renderTargets()->acquire( size, scene()->colorFormat() );
+	glActiveTexture( GL_TEXTURE1 );
+	glBindTexture( GL_TEXTURE_2D, mRefractionRenderer->texID() );
+	glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], size.width(), size.height() );
+
+	// soft particles may have copied the depth already
+	glActiveTexture( GL_TEXTURE3 );
+	if( ParticleSystem::sceneDepthMap() && ParticleSystem::sceneViewport() == QRect( viewport[0], viewport[1], viewport[2], viewport[3] ) )
+	{
+		glBindTexture( GL_TEXTURE_2D, ParticleSystem::sceneDepthMap() );
+	}
 	else
-		scene()->eye()->setClippingPlane( 0, QVector4D(0,1,0, -mWaterHeight+mWaterClippingPlaneOffset) );
-
-	scene()->eye()->applyGL();
-	scene()->eye()->enableClippingPlanes();
-	scene()->root()->draw();
-	scene()->root()->draw2();
-	scene()->eye()->setClippingPlane( 0 );
-
-	glMatrixMode( GL_PROJECTION );	glPopMatrix();
-	glMatrixMode( GL_MODELVIEW );	glPopMatrix();
-	mRefractionRenderer->release();
-	mDrawingRefraction = false;
+	{
+		glBindTexture( GL_TEXTURE_2D, mRefractionRenderer->depthID() );
+		glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], size.width(), size.height() );
+	}
+	glActiveTexture( GL_TEXTURE0 );
 }
 
 
 void Landscape::draw2SelfPost()
 {
-	if( mDrawingReflection || mDrawingRefraction )
+	if( mDrawingReflection || !waterVisible() )
 		return;
 
-	MaterialQuality::Type defaultQuality = MaterialQuality::maximum();
-	MaterialQuality::setMaximum( MaterialQuality::LOW );
-	renderReflection();
-	renderRefraction();
-	MaterialQuality::setMaximum( defaultQuality );
+	if( !sScreenSpaceReflection )
+		renderReflection();
+	copyRefraction();
 
 	glDisable( GL_CULL_FACE );
 	mWaterShader->bind();
@@ -304,21 +385,36 @@ void Landscape::draw2SelfPost()
 	mWaterShader->program()->setUniformValue( "reflectionMap", 0 );
 	mWaterShader->program()->setUniformValue( "refractionMap", 1 );
 	mWaterShader->program()->setUniformValue( "waterMap", 2 );
+	mWaterShader->program()->setUniformValue( "sceneDepthMap", 3 );
+	mWaterShader->program()->setUniformValue( "reflectionMatrix", mReflectionMatrix * modelMatrix() );
+	mWaterShader->program()->setUniformValue( "screenSpaceReflection", (GLint)sScreenSpaceReflection );
+	mWaterShader->program()->setUniformValue( "skyColor", world()->sky()->baseColor().toVector3D() );
 	mWaterShader->program()->setUniformValue( "time", world()->sky()->timeOfDay() );
 	glActiveTexture( GL_TEXTURE2 );	glBindTexture( GL_TEXTURE_2D, mWaterMap );
-	glActiveTexture( GL_TEXTURE1 );	glBindTexture( GL_TEXTURE_2D, mRefractionRenderer->texID() );
-	glActiveTexture( GL_TEXTURE0 );	glBindTexture( GL_TEXTURE_2D, mReflectionRenderer->texID() );
+	glActiveTexture( GL_TEXTURE0 );	glBindTexture( GL_TEXTURE_2D, mReflectionRenderer ? mReflectionRenderer->texID() : 0 );
 	drawInfinitePlane( mWaterHeight );
 	mWaterShader->release();
+	glActiveTexture( GL_TEXTURE3 );	glBindTexture( GL_TEXTURE_2D, 0 );
 	glActiveTexture( GL_TEXTURE2 );	glBindTexture( GL_TEXTURE_2D, 0 );
 	glActiveTexture( GL_TEXTURE1 );	glBindTexture( GL_TEXTURE_2D, 0 );
 	glActiveTexture( GL_TEXTURE0 );	glBindTexture( GL_TEXTURE_2D, 0 );
 	glEnable( GL_CULL_FACE );
+
+	scene()->renderTargets()->release( mRefractionRenderer );
+	mRefractionRenderer = NULL;
 }
 
 
 void Landscape::drawPatch( const QRectF & rect )
 {
+	if( sSinglePassTerrain && mSplatMap->isValid() && mSplatMap->ready() )
+	{
+		mSplatMap->bind();
+		mTerrain->drawPatch( rect );
+		mSplatMap->release();
+		return;
+	}
+
 	mTerrainMaterial->bind();
 	glMatrixMode( GL_TEXTURE );	glActiveTexture( GL_TEXTURE0 );	glPushMatrix();
 		glScalef( mTerrainMaterialScale.x(), -mTerrainMaterialScale.y(), 1.0f );
@@ -335,6 +431,30 @@ void Landscape::drawPatch( const QRectF & rect )
 	{
 		mBlobs[i]->drawPatch( rect );
 	}
+
+	if( mSplatterMap )
+	{
+		// multiply the splatter map onto the shaded terrain - fogged in white, so distant splatters fade out with the terrain
+		glPushAttrib( GL_ENABLE_BIT | GL_FOG_BIT | GL_CURRENT_BIT | GL_TEXTURE_BIT );
+		glDisable( GL_LIGHTING );
+		glEnable( GL_TEXTURE_2D );
+		glEnable( GL_FOG );
+		glFogi( GL_FOG_MODE, GL_LINEAR );
+		glFog( GL_FOG_COLOR, QVector4D( 1.0f, 1.0f, 1.0f, 1.0f ) );
+		glColor4f( 1.0f, 1.0f, 1.0f, 1.0f );
+		glActiveTexture( GL_TEXTURE0 );
+		glBindTexture( GL_TEXTURE_2D, mSplatterMap );
+		glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE );
+		glBlendFunc( GL_DST_COLOR, GL_ZERO );
+		glMatrixMode( GL_TEXTURE );	glPushMatrix();	glLoadIdentity();
+			glScalef( 1.0f/mTerrain->mapSize().width(), 1.0f/mTerrain->mapSize().height(), 1.0f );
+			glMatrixMode( GL_MODELVIEW );
+			mTerrain->drawPatch( rect );
+		glMatrixMode( GL_TEXTURE );	glPopMatrix();
+		glMatrixMode( GL_MODELVIEW );
+		glBindTexture( GL_TEXTURE_2D, 0 );
+		glPopAttrib();
+	}
 	glDisable( GL_BLEND );
 	glDepthMask( GL_TRUE );
 }
@@ -391,7 +511,9 @@ Landscape::Blob::Blob( Landscape * landscape, QRect rect, QString materialName,
 	mGLWidget = landscape->scene()->glWidget();
 	mLandscape = landscape;
 	mRect = rect;
+	mMaterialName = materialName;
 	mMaterialScale = materialScale;
+	mBlobMapPath = blobMapPath;
 	mMaterial = new Material( mGLWidget, materialName, MaterialShaderVariant::BLOBBING );
 	QImage blobMap = QImage( blobMapPath );
 	if( blobMap.isNull() )
@@ -413,7 +535,7 @@ Landscape::Blob::~Blob()
 
 void Landscape::Blob::drawPatchMap( const QRect & visible )
 {
-	if( mPriority >= 99-sQuality)
+	if( visible() )
 	{
 		QRect rectToDraw = mRect.intersected( visible );
 		if( rectToDraw.width() <= 1 || rectToDraw.height() <= 1 )
@@ -443,6 +565,293 @@ void Landscape::Blob::drawPatchMap( const QRect & visible )
 
 
 
+////////////////////////////////////////////////////////////////
+// SplatMap
+
+
+Landscape::SplatMap::SplatMap( Landscape * landscape, const QString & baseMaterialName, const QVector2D & baseScale ) :
+	mLandscape( landscape ),
+	mShader( NULL ),
+	mBaseScale( baseScale ),
+	mDiffuseLayers( 0 ),
+	mSpecularLayers( 0 ),
+	mNormalLayers( 0 ),
+	mValid( false ),
+	mLayersFilled( false )
+{
+	for( int i = 0; i < maxBlobs/4; ++i )
+		mWeightMaps[i] = 0;
+
+	const QVector<Blob*> & blobs = mLandscape->mBlobs;
+	if( !GLEW_EXT_texture_array )
+	{
+		qWarning() << "! Texture arrays not supported - terrain blobs will be drawn in multiple passes";
+		return;
+	}
+	if( blobs.size() > maxBlobs )
+	{
+		qWarning() << "! Landscape has more than" << maxBlobs << "blobs - terrain blobs will be drawn in multiple passes";
+		return;
+	}
+	GLint maxUnits;
+	glGetIntegerv( GL_MAX_TEXTURE_IMAGE_UNITS, &maxUnits );
+	if( maxUnits < textureUnits )
+	{
+		qWarning() << "! Only" << maxUnits << "texture image units - terrain blobs will be drawn in multiple passes";
+		return;
+	}
+
+	QStringList materialNames( baseMaterialName );
+	mLayerMaterials.append( mLandscape->mTerrainMaterial );
+	for( int i = 0; i < blobs.size(); ++i )
+	{
+		int layer = materialNames.indexOf( blobs[i]->materialName() );
+		if( layer < 0 )
+		{
+			layer = materialNames.size();
+			materialNames.append( blobs[i]->materialName() );
+			mLayerMaterials.append( blobs[i]->material() );
+		}
+		mBlobLayers.append( layer );
+	}
+
+	mDiffuseLayers = createLayers();
+	mSpecularLayers = createLayers();
+	mNormalLayers = createLayers();
+	for( int i = 0; i < maxBlobs/4; ++i )
+		mWeightMaps[i] = createWeightMap( i*4 );
+
+	mShader = new Shader( mLandscape->scene()->glWidget(), "terrainSplat" );
+	mValid = mShader->constData()->loaded();
+}
+
+
+Landscape::SplatMap::~SplatMap()
+{
+	delete mShader;
+	glDeleteTextures( maxBlobs/4, mWeightMaps );
+	glDeleteTextures( 1, &mNormalLayers );
+	glDeleteTextures( 1, &mSpecularLayers );
+	glDeleteTextures( 1, &mDiffuseLayers );
+}
+
+
+GLuint Landscape::SplatMap::createLayers()
+{
+	int levels = 1;
+	for( int size = layerSize; size > 1; size /= 2 )
+		++levels;
+
+	GLuint texture;
+	glGenTextures( 1, &texture );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, texture );
+	for( int level = 0; level < levels; ++level )
+	{
+		int size = qMax( 1, layerSize >> level );
+		glTexImage3D( GL_TEXTURE_2D_ARRAY_EXT, level, GL_RGBA8, size, size, mLayerMaterials.size(), 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL );
+	}
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_S, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	if( GLEW_EXT_texture_filter_anisotropic )
+		glTexParameterf( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAX_ANISOTROPY_EXT, Material::filterAnisotropy() );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+	return texture;
+}
+
+
+bool Landscape::SplatMap::ready()
+{
+	if( mLayersFilled )
+		return true;
+	foreach( Material * material, mLayerMaterials )
+	{
+		if( material->constData()->pending() )
+			return false;
+	}
+	if( !mLandscape->mTerrainMaterial->constData()->loaded() )
+		return false;
+
+	// the same defaults the multi pass shaders assume for maps a material does not have
+	fillLayers( mDiffuseLayers, "diffuseMap", QColor( 255, 255, 255, 255 ) );
+	fillLayers( mSpecularLayers, "specularMap", QColor( 255, 255, 255, 255 ) );
+	fillLayers( mNormalLayers, "normalMap", QColor( 128, 128, 255, 255 ) );
+	mLayersFilled = true;
+	qDebug() << "+ Packed" << mLayerMaterials.size() << "terrain materials for single pass shading";
+	return true;
+}
+
+
+void Landscape::SplatMap::fillLayers( GLuint texture, const QString & key, const QColor & fallback )
+{
+	// draws each material's texture into its layer - this works for compressed textures as well
+	GLint frameBuffer;
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &frameBuffer );
+	GLuint layerFrameBuffer;
+	glGenFramebuffers( 1, &layerFrameBuffer );
+	glBindFramebuffer( GL_FRAMEBUFFER, layerFrameBuffer );
+
+	glPushAttrib( GL_ALL_ATTRIB_BITS );
+	glViewport( 0, 0, layerSize, layerSize );
+	glDisable( GL_BLEND );
+	glDisable( GL_DEPTH_TEST );
+	glDisable( GL_CULL_FACE );
+	glDisable( GL_LIGHTING );
+	glDisable( GL_ALPHA_TEST );
+	glDisable( GL_FOG );
+	glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+	glActiveTexture( GL_TEXTURE0 );
+	glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE );
+	glMatrixMode( GL_TEXTURE );	glPushMatrix();	glLoadIdentity();
+	glMatrixMode( GL_PROJECTION );	glPushMatrix();	glLoadIdentity();
+	glMatrixMode( GL_MODELVIEW );	glPushMatrix();	glLoadIdentity();
+
+	for( int layer = 0; layer < mLayerMaterials.size(); ++layer )
+	{
+		glFramebufferTextureLayerEXT( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, layer );
+
+		const QSharedPointer<MaterialData> & material = mLayerMaterials[layer]->constData();
+		GLuint source = material->loaded() ? material->textures().value( key, 0 ) : 0;
+		if( !source )
+		{
+			glClearColor( fallback.redF(), fallback.greenF(), fallback.blueF(), fallback.alphaF() );
+			glClear( GL_COLOR_BUFFER_BIT );
+			continue;
+		}
+
+		glEnable( GL_TEXTURE_2D );
+		glBindTexture( GL_TEXTURE_2D, source );
+		glBegin( GL_QUADS );
+		glTexCoord2f( 0, 0 );	glVertex2f( -1, -1 );
+		glTexCoord2f( 1, 0 );	glVertex2f( 1, -1 );
+		glTexCoord2f( 1, 1 );	glVertex2f( 1, 1 );
+		glTexCoord2f( 0, 1 );	glVertex2f( -1, 1 );
+		glEnd();
+		glBindTexture( GL_TEXTURE_2D, 0 );
+	}
+
+	glMatrixMode( GL_TEXTURE );	glPopMatrix();
+	glMatrixMode( GL_PROJECTION );	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW );	glPopMatrix();
+	glPopAttrib();
+
+	glBindFramebuffer( GL_FRAMEBUFFER, frameBuffer );
+	glDeleteFramebuffers( 1, &layerFrameBuffer );
+
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, texture );
+	glGenerateMipmap( GL_TEXTURE_2D_ARRAY_EXT );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+}
+
+
+GLuint Landscape::SplatMap::createWeightMap( int first )
+{
+	const QVector<Blob*> & blobs = mLandscape->mBlobs;
+	const QSize & mapSize = mLandscape->terrain()->mapSize();
+	QImage weights( mapSize, QImage::Format_ARGB32 );
+	weights.fill( 0 );
+
+	static const int channelShift[4] = { 16, 8, 0, 24 };	// r, g, b, a
+	for( int i = first; i < first+4 && i < blobs.size(); ++i )
+	{
+		const QRect & rect = blobs[i]->rect();
+		QImage mask( blobs[i]->blobMapPath() );
+		if( mask.isNull() || rect.width() <= 0 || rect.height() <= 0 )
+			continue;
+		mask = mask.scaled( rect.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation ).convertToFormat( QImage::Format_ARGB32 );
+
+		// the blob mask's rows run along the map's y axis - see Blob::drawPatchMap
+		QRect target = rect.intersected( QRect( QPoint( 0, 0 ), mapSize ) );
+		for( int y = target.top(); y <= target.bottom(); ++y )
+		{
+			const QRgb * maskLine = reinterpret_cast<const QRgb*>( mask.constScanLine( y - rect.y() ) );
+			QRgb * weightLine = reinterpret_cast<QRgb*>( weights.scanLine( y ) );
+			for( int x = target.left(); x <= target.right(); ++x )
+			{
+				weightLine[x] |= (QRgb)qRed( maskLine[x - rect.x()] ) << channelShift[i%4];
+			}
+		}
+	}
+
+	GLuint texture;
+	glGenTextures( 1, &texture );
+	glBindTexture( GL_TEXTURE_2D, texture );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, weights.width(), weights.height(), 0, GL_BGRA, GL_UNSIGNED_BYTE, weights.bits() );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	return texture;
+}
+
+
+void Landscape::SplatMap::bind()
+{
+	const QSharedPointer<MaterialData> & material = mLandscape->mTerrainMaterial->constData();
+	const QVector<Blob*> & blobs = mLandscape->mBlobs;
+
+	glPushAttrib( GL_LIGHTING_BIT | GL_ENABLE_BIT );
+	glMaterial( GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient() );
+	glMaterial( GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse() );
+	glMaterial( GL_FRONT_AND_BACK, GL_SPECULAR, material->specular() );
+	glMaterial( GL_FRONT_AND_BACK, GL_EMISSION, material->emission() );
+	glMaterial( GL_FRONT_AND_BACK, GL_SHININESS, material->shininess() );
+
+	mShader->bind();
+	QGLShaderProgram * program = mShader->program();
+
+	QVector2D blobScales[maxBlobs];
+	GLfloat blobLayers[maxBlobs];
+	GLfloat blobEnabled[maxBlobs];
+	for( int i = 0; i < maxBlobs; ++i )
+	{
+		bool used = i < blobs.size();
+		blobScales[i] = used ? blobs[i]->materialScale() : QVector2D( 1.0f, 1.0f );
+		blobLayers[i] = used ? mBlobLayers[i] : 0.0f;
+		blobEnabled[i] = ( used && blobs[i]->visible() ) ? 1.0f : 0.0f;
+	}
+	program->setUniformValue( "mapSize", QSizeF( mLandscape->terrain()->mapSize() ) );
+	program->setUniformValue( "baseScale", mBaseScale );
+	program->setUniformValueArray( "blobScale", blobScales, maxBlobs );
+	program->setUniformValueArray( "blobLayer", blobLayers, maxBlobs, 1 );
+	program->setUniformValue( "blobEnabled0", blobEnabled[0], blobEnabled[1], blobEnabled[2], blobEnabled[3] );
+	program->setUniformValue( "blobEnabled1", blobEnabled[4], blobEnabled[5], blobEnabled[6], blobEnabled[7] );
+
+	program->setUniformValue( "diffuseLayers", 0 );
+	program->setUniformValue( "specularLayers", 1 );
+	program->setUniformValue( "normalLayers", 2 );
+	program->setUniformValue( "weightMap0", 3 );
+	program->setUniformValue( "weightMap1", 4 );
+	program->setUniformValue( "splatterMap", 5 );
+	program->setUniformValue( "splatterEnabled", (GLint)( mLandscape->mSplatterMap != 0 ) );
+	LightGrid::bindCurrent( program, 6 );
+	ShadowMap::bindCurrent( program, 8 );
+	glActiveTexture( GL_TEXTURE5 );	glBindTexture( GL_TEXTURE_2D, mLandscape->mSplatterMap );
+	glActiveTexture( GL_TEXTURE4 );	glBindTexture( GL_TEXTURE_2D, mWeightMaps[1] );
+	glActiveTexture( GL_TEXTURE3 );	glBindTexture( GL_TEXTURE_2D, mWeightMaps[0] );
+	glActiveTexture( GL_TEXTURE2 );	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, mNormalLayers );
+	glActiveTexture( GL_TEXTURE1 );	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, mSpecularLayers );
+	glActiveTexture( GL_TEXTURE0 );	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, mDiffuseLayers );
+}
+
+
+void Landscape::SplatMap::release()
+{
+	mShader->release();
+	glActiveTexture( GL_TEXTURE5 );	glBindTexture( GL_TEXTURE_2D, 0 );
+	glActiveTexture( GL_TEXTURE4 );	glBindTexture( GL_TEXTURE_2D, 0 );
+	glActiveTexture( GL_TEXTURE3 );	glBindTexture( GL_TEXTURE_2D, 0 );
+	glActiveTexture( GL_TEXTURE2 );	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+	glActiveTexture( GL_TEXTURE1 );	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+	glActiveTexture( GL_TEXTURE0 );	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+	glPopAttrib();
+}
+
+
+
+
 ////////////////////////////////////////////////////////////////
 // Filter
 
@@ -509,7 +918,7 @@ void Landscape::Filter::update()
 }
 
 
-void Landscape::Filter::draw()
+void Landscape::Filter::draw( bool depthOnly )
 {
 	FrustumTest frustumTest;
 	frustumTest.sync();
@@ -550,7 +959,10 @@ void Landscape::Filter::draw()
 		}
 		if( !mergedRect.isNull() )
 		{
-			mLandscape->drawPatch( mergedRect );
+			if( depthOnly )
+				mLandscape->terrain()->drawPatch( mergedRect );
+			else
+				mLandscape->drawPatch( mergedRect );
 		}
 	}
 }
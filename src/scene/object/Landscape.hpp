@@ -28,6 +28,8 @@
 #include <geometry/Terrain.hpp>
 
 #include <QString>
+#include <QStringList>
+#include <QColor>
 #include <QRect>
 #include <QSizeF>
 #include <QVector2D>
@@ -54,6 +56,8 @@ public:
 	virtual void drawSelf();
 	virtual void drawSelfPost();
 	virtual void draw2SelfPost();
+	virtual void drawOccluderSelf();
+	virtual void drawShadowCasterSelf( ShadowMap & shadowMap );
 
 	virtual const AObject * intersectLine( const AObject * exclude, const QVector3D & origin, const QVector3D & direction,
 		float & length, QVector3D * normal = NULL ) const;
@@ -69,7 +73,24 @@ public:
 	const Terrain * terrain() const { return mTerrain; }
 	const float & waterHeight() const { return mWaterHeight; }
 	const bool & drawingReflection() const { return mDrawingReflection; }
-	const bool & drawingRefraction() const { return mDrawingRefraction; }
+
+	/// Texture in heightmap space whose color is multiplied with the terrain's - 0 disables it.
+	GLuint splatterMap() const { return mSplatterMap; }
+	void setSplatterMap( GLuint texture ) { mSplatterMap = texture; }
+
+	/// Shades the terrain and all of its blobs in a single pass if supported.
+	static bool singlePassTerrain() { return sSinglePassTerrain; }
+	static void setSinglePassTerrain( bool enable ) { sSinglePassTerrain = enable; }
+
+	/// Size of the water reflection relative to the viewport - halved if the frame time exceeds its target at the minimum dynamic resolution.
+	static float reflectionScale() { return sReflectionScale; }
+	static void setReflectionScale( float scale ) { sReflectionScale = scale; }
+	/// The water reflection is rendered every this many frames and reprojected in between - up to four times as long if the frame time exceeds its target at the minimum dynamic resolution.
+	static int reflectionInterval() { return sReflectionInterval; }
+	static void setReflectionInterval( int frames ) { sReflectionInterval = qMax( 1, frames ); }
+	/// Reflects the main pass' color and depth in the water instead of rendering a mirrored scene - misses show the sky's color.
+	static bool screenSpaceReflection() { return sScreenSpaceReflection; }
+	static void setScreenSpaceReflection( bool enable ) { sScreenSpaceReflection = enable; }
 
 	/// Draws a part of the Terrain using another Material.
 	class Blob
@@ -77,6 +98,7 @@ public:
 		GLWidget * mGLWidget;
 		Landscape * mLandscape;
 		Material * mMaterial;
+		QString mMaterialName;
 		QVector2D mMaterialScale;
 		QString mBlobMapPath;
 		GLuint mBlobMap;
@@ -91,6 +113,13 @@ public:
 		void drawPatch( const QRectF & visible )
 			{ drawPatchMap( mLandscape->terrain()->toMap(visible) ); }
 
+		const QRect & rect() const { return mRect; }
+		const QString & materialName() const { return mMaterialName; }
+		Material * material() const { return mMaterial; }
+		const QVector2D & materialScale() const { return mMaterialScale; }
+		const QString & blobMapPath() const { return mBlobMapPath; }
+		bool visible() const { return mPriority >= 99-sQuality; }
+
 		static int quality() { return sQuality; }
 		static void setQuality( int quality ) { sQuality = quality; }
 	};
@@ -103,7 +132,8 @@ private:
 		Filter( Landscape * landscape, QSize filterSize );
 		~Filter();
 		void update();
-		void draw();
+		/// Draws the visible patches - only their geometry if depthOnly is set
+		void draw( bool depthOnly = false );
 	private:
 		class Patch
 		{
@@ -125,6 +155,45 @@ private:
 		QVector<Patch> mPatches;
 	};
 
+	/// Packs the terrain's and the blobs' materials into texture arrays and the blob masks into RGBA weight maps.
+	/**
+	 * Layer 0 of each array holds the terrain's base material, the following layers hold the blob materials.
+	 * Blob i is weighted by channel i%4 of weight map i/4.
+	 * The layers are copied from the materials' textures once all of them are loaded.
+	 */
+	class SplatMap
+	{
+	public:
+		SplatMap( Landscape * landscape, const QString & baseMaterialName, const QVector2D & baseScale );
+		~SplatMap();
+		bool isValid() const { return mValid; }
+		/// Fills the layers as soon as all materials are loaded and returns true once they are filled
+		bool ready();
+		void bind();
+		void release();
+
+		static const int maxBlobs = 8;
+		static const int layerSize = 512;
+		/// Image units used by the terrainSplat shader - 6 for the maps, 2 for the light grid and 1 for the shadow map
+		static const int textureUnits = 9;
+	private:
+		Landscape * mLandscape;
+		Shader * mShader;
+		QVector2D mBaseScale;
+		GLuint mDiffuseLayers;
+		GLuint mSpecularLayers;
+		GLuint mNormalLayers;
+		GLuint mWeightMaps[maxBlobs/4];
+		QVector<float> mBlobLayers;
+		QVector<Material*> mLayerMaterials;
+		bool mValid;
+		bool mLayersFilled;
+
+		GLuint createLayers();
+		void fillLayers( GLuint texture, const QString & key, const QColor & fallback );
+		GLuint createWeightMap( int first );
+	};
+
 	QString mName;
 	QVector<Blob*> mBlobs;
 	QVector< QSharedPointer<AObject> > mVegetation;
@@ -133,21 +202,32 @@ private:
 	Terrain * mTerrain;
 	Filter * mTerrainFilter;
 	Material * mTerrainMaterial;
+	SplatMap * mSplatMap;
 	QVector3D mTerrainSize;
 	QVector3D mTerrainOffset;
 	QVector2D mTerrainMaterialScale;
 	float mWaterHeight;
 	Shader * mWaterShader;
 	TextureRenderer * mReflectionRenderer;
-	TextureRenderer * mRefractionRenderer;
+	QMatrix4x4 mReflectionMatrix;	///< View projection the reflection was rendered for
+	int mReflectionAge;		///< Frames since the reflection was rendered
+	bool mReflectionAbove;		///< Whether the reflection was rendered from above the water
+	int mReflectionLevel;		///< Steps the reflection's rate and size are lowered by - alternately doubling the interval and halving the size
+	TextureRenderer * mRefractionRenderer;	///< Holds copies of the main pass' color and depth while the water is drawn
 	float mWaterClippingPlaneOffset;
 	bool mDrawingReflection;
-	bool mDrawingRefraction;
 	GLuint mWaterMap;
+	GLuint mSplatterMap;
 
 	void drawInfinitePlane( const float & height );
+	bool waterVisible();
 	void renderReflection();
-	void renderRefraction();
+	void copyRefraction();
+
+	static bool sSinglePassTerrain;
+	static float sReflectionScale;
+	static int sReflectionInterval;
+	static bool sScreenSpaceReflection;
 };
 
 
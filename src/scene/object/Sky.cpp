@@ -29,6 +29,7 @@
 #include <resource/Material.hpp>
 #include <scene/TextureRenderer.hpp>
 #include <scene/Scene.hpp>
+#include <scene/ShadowMap.hpp>
 
 #include <QGLShaderProgram>
 #include <QSettings>
@@ -79,6 +80,10 @@ const GLushort Sky::sCubeIndices[] =
 QGLBuffer Sky::sCubeIndexBuffer;
 
 
+int Sky::sCacheSize = 512;
+float Sky::sCacheTolerance = 0.002f;
+
+
 void Sky::drawCube( bool texCoords )
 {
 	sCubeVertexBuffer.bind();
@@ -259,13 +264,35 @@ Sky::Sky( World * world, QString name ) :
 	mDomeShader_sunSpotPower = mDomeShader->program()->uniformLocation( "sunSpotPower" );
 	mDomeShader_diffuseMap = mDomeShader->program()->uniformLocation( "diffuseMap" );
 
-	mDomeImage = QImage( skyDomePath );
-	if( mDomeImage.isNull() )
+	QImage domeImage( skyDomePath );
+	if( domeImage.isNull() )
 	{
 		qFatal( "\"%s\" not found!", skyDomePath.toLocal8Bit().constData() );
 	}
 
-	mDomeMap = scene()->glWidget()->bindTexture( mDomeImage );
+	mLightTable.resize( sLightTableSize );
+	for( int i = 0; i < sLightTableSize; ++i )
+		mLightTable[i] = sampleLight( domeImage, (float)i / (float)sLightTableSize );
+
+	QVector<QVector4D> lightTexels( sLightTableSize*4 );
+	for( int i = 0; i < sLightTableSize; ++i )
+	{
+		lightTexels[i] = mLightTable[i].baseColor;
+		lightTexels[i+sLightTableSize] = mLightTable[i].ambient;
+		lightTexels[i+sLightTableSize*2] = mLightTable[i].diffuse;
+		lightTexels[i+sLightTableSize*3] = mLightTable[i].specular;
+	}
+	glGenTextures( 1, &mLightTableMap );
+	glBindTexture( GL_TEXTURE_1D, mLightTableMap );
+	glTexParameteri( GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	// light factors may exceed one - clamped if float textures are not supported
+	glTexImage1D( GL_TEXTURE_1D, 0, GLEW_ARB_texture_float ? GL_RGBA16F_ARB : GL_RGBA8, lightTexels.size(), 0,
+		GL_RGBA, GL_FLOAT, lightTexels.constData() );
+	glBindTexture( GL_TEXTURE_1D, 0 );
+
+	mDomeMap = scene()->glWidget()->bindTexture( domeImage );
 	if( mDomeMap >= 0 )
 	{
 		glActiveTexture( GL_TEXTURE0 );
@@ -291,6 +318,42 @@ Sky::Sky( World * world, QString name ) :
 	TexImage( scene()->glWidget(), GL_TEXTURE_CUBE_MAP_POSITIVE_Z, starMapPathPZ );
 	TexImage( scene()->glWidget(), GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, starMapPathNZ );
 
+	mCacheMap = 0;
+	mCacheFrameBuffer = 0;
+	for( int i = 0; i < 6; ++i )
+		mCacheFaceTime[i] = -1.0f;
+	mCacheNextFace = 0;
+	mCacheUpdated = false;
+	if( sCacheSize > 0 )
+	{
+		glGenTextures( 1, &mCacheMap );
+		glBindTexture( GL_TEXTURE_CUBE_MAP, mCacheMap );
+		glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		for( int i = 0; i < 6; ++i )
+			glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, 0, GL_RGBA8, sCacheSize, sCacheSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+		glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
+
+		GLint frameBuffer;
+		glGetIntegerv( GL_FRAMEBUFFER_BINDING, &frameBuffer );
+		glGenFramebuffers( 1, &mCacheFrameBuffer );
+		glBindFramebuffer( GL_FRAMEBUFFER, mCacheFrameBuffer );
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, mCacheMap, 0 );
+		GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+		glBindFramebuffer( GL_FRAMEBUFFER, frameBuffer );
+		if( status != GL_FRAMEBUFFER_COMPLETE )
+		{
+			qWarning( "! Sky cache not supported (%s) - drawing the sky directly", qPrintable(glGetFrameBufferStatusString(status)) );
+			glDeleteFramebuffers( 1, &mCacheFrameBuffer );
+			glDeleteTextures( 1, &mCacheMap );
+			mCacheFrameBuffer = 0;
+			mCacheMap = 0;
+		}
+	}
+
 	mSunFlareMaterial = new Material( scene()->glWidget(), "Flare" );
 
 	world->addLightSource( this );
@@ -301,6 +364,11 @@ Sky::~Sky()
 {
 	scene()->glWidget()->deleteTexture( mDomeMap );
 	scene()->glWidget()->deleteTexture( mStarCubeMap );
+	glDeleteTextures( 1, &mLightTableMap );
+	if( mCacheFrameBuffer )
+		glDeleteFramebuffers( 1, &mCacheFrameBuffer );
+	if( mCacheMap )
+		glDeleteTextures( 1, &mCacheMap );
 	delete mSunFlareMaterial;
 	delete mDomeShader;
 	delete mStarCubeShader;
@@ -326,46 +394,78 @@ void Sky::setTimeOfDay( const float & timeOfDay )
 
 void Sky::updateSelf( const double & delta )
 {
-	float angle = mTimeOfDay*(M_PI*2.0f);
+	mCacheUpdated = false;
+
+	mSunDirection = sunDirectionAt( mTimeOfDay );
+	if( scene()->shadowMap() )
+		scene()->shadowMap()->setLightDirection( mSunDirection.toVector3D() );
+
+	float tablePos = mTimeOfDay * (float)sLightTableSize;
+	int iA = (int)floorf( tablePos );
+	float weight = tablePos - (float)iA;
+	iA %= sLightTableSize;
+	if( iA < 0 )
+		iA += sLightTableSize;
+	int iB = ( iA + 1 ) % sLightTableSize;
+	const LightSample & a = mLightTable[iA];
+	const LightSample & b = mLightTable[iB];
+	mBaseColor = Interpolation::linear( a.baseColor, b.baseColor, weight );
+	mAmbient = Interpolation::linear( a.ambient, b.ambient, weight );
+	mDiffuse = Interpolation::linear( a.diffuse, b.diffuse, weight );
+	mSpecular = Interpolation::linear( a.specular, b.specular, weight );
+}
+
+
+QVector3D Sky::sunDirectionAt( float timeOfDay ) const
+{
+	float angle = timeOfDay*(M_PI*2.0f);
 	QMatrix4x4 m;
 	m.setToIdentity();
 	m.rotate( angle*(180.0/M_PI), mAxis );
-	mSunDirection = m.map( mSunInitialDir );
+	return m.map( mSunInitialDir );
+}
+
 
-	float skyMapTime = mTimeOfDay * (float)mDomeImage.width() - 0.5f;
+Sky::LightSample Sky::sampleLight( const QImage & domeImage, float timeOfDay ) const
+{
+	LightSample sample;
+	QVector3D sunDirection = sunDirectionAt( timeOfDay );
+
+	float skyMapTime = timeOfDay * (float)domeImage.width() - 0.5f;
 
 	int xA = (int)floorf( skyMapTime );
 	if( xA < 0 )
-		xA += mDomeImage.width();
-	QRgb colorA = mDomeImage.pixel( xA, mDomeImage.height()-1 );
+		xA += domeImage.width();
+	QRgb colorA = domeImage.pixel( xA, domeImage.height()-1 );
 
 	int xB = xA + 1;
-	if( xB >= mDomeImage.width() )
-		xB -= mDomeImage.width();
-	QRgb colorB = mDomeImage.pixel( xB, mDomeImage.height()-1 );
+	if( xB >= domeImage.width() )
+		xB -= domeImage.width();
+	QRgb colorB = domeImage.pixel( xB, domeImage.height()-1 );
 
 	QVector4D colorAF( qRed(colorA), qGreen(colorA), qBlue(colorA), qAlpha(colorA) );
 	colorAF /= 255.0f;
 	QVector4D colorBF( qRed(colorB), qGreen(colorB), qBlue(colorB), qAlpha(colorB) );
 	colorBF /= 255.0f;
 
-	mBaseColor = Interpolation::linear( colorAF, colorBF, skyMapTime-floorf( skyMapTime ) );
+	sample.baseColor = Interpolation::linear( colorAF, colorBF, skyMapTime-floorf( skyMapTime ) );
 
-	float diffuseFactor = Interpolation::linear( mDiffuseFactorDay, mDiffuseFactorNight, (float)((sunDirection().y()+1.0f)*0.5f) );
+	float diffuseFactor = Interpolation::linear( mDiffuseFactorDay, mDiffuseFactorNight, (float)((sunDirection.y()+1.0f)*0.5f) );
 	if( diffuseFactor > mDiffuseFactorMax )
 		diffuseFactor = mDiffuseFactorMax;
 
-	float specularFactor = Interpolation::linear( mSpecularFactorDay, mSpecularFactorNight, (float)((sunDirection().y()+1.0f)*0.5f) );
+	float specularFactor = Interpolation::linear( mSpecularFactorDay, mSpecularFactorNight, (float)((sunDirection.y()+1.0f)*0.5f) );
 	if( diffuseFactor > mSpecularFactorMax )
 		diffuseFactor = mSpecularFactorMax;
 
-	float ambientFactor = Interpolation::linear( mAmbientFactorDay, mAmbientFactorNight, (float)((sunDirection().y()+1.0f)*0.5f) );
+	float ambientFactor = Interpolation::linear( mAmbientFactorDay, mAmbientFactorNight, (float)((sunDirection.y()+1.0f)*0.5f) );
 	if( ambientFactor > mAmbientFactorMax )
 		ambientFactor = mAmbientFactorMax;
 
-	mDiffuse = mBaseColor.toVector3D() * diffuseFactor;
-	mSpecular = mBaseColor.toVector3D() * specularFactor;
-	mAmbient = mBaseColor.toVector3D().normalized() * ambientFactor;
+	sample.diffuse = sample.baseColor.toVector3D() * diffuseFactor;
+	sample.specular = sample.baseColor.toVector3D() * specularFactor;
+	sample.ambient = sample.baseColor.toVector3D().normalized() * ambientFactor;
+	return sample;
 }
 
 
@@ -397,9 +497,21 @@ void Sky::drawSelf()
 	glDisable( GL_CULL_FACE );
 	glDepthRange( 1.0, 1.0 );
 
-	drawStarCube();
-	drawSky();
-	drawCloudPlane();
+	if( mCacheMap )
+	{
+		if( !mCacheUpdated )
+		{
+			refreshCache();
+			mCacheUpdated = true;
+		}
+		drawCache();
+	}
+	else
+	{
+		drawStarCube();
+		drawSky();
+		drawCloudPlane();
+	}
 
 	glPopMatrix();
 	glPopAttrib();
@@ -430,7 +542,7 @@ void Sky::draw2Self()
 
 void Sky::drawSunFlare()
 {
-	if( world()->landscape()->drawingReflection() || world()->landscape()->drawingRefraction() )
+	if( world()->landscape()->drawingReflection() )
 		return;
 
 	QVector3D sunPoint( mSunDirection * scene()->eye()->farPlane() );
@@ -469,6 +581,74 @@ void Sky::drawSunFlare()
 }
 
 
+void Sky::refreshCache()
+{
+	// view directions and up vectors of the cube map faces +X, -X, +Y, -Y, +Z, -Z
+	static const QVector3D faceDir[6] = {
+		QVector3D( 1, 0, 0 ), QVector3D( -1, 0, 0 ), QVector3D( 0, 1, 0 ),
+		QVector3D( 0, -1, 0 ), QVector3D( 0, 0, 1 ), QVector3D( 0, 0, -1 ) };
+	static const QVector3D faceUp[6] = {
+		QVector3D( 0, -1, 0 ), QVector3D( 0, -1, 0 ), QVector3D( 0, 0, 1 ),
+		QVector3D( 0, 0, -1 ), QVector3D( 0, -1, 0 ), QVector3D( 0, -1, 0 ) };
+
+	// the stalest face is refreshed every frame, faces lagging too far behind (time-lapse) right away
+	bool refresh[6];
+	for( int i = 0; i < 6; ++i )
+	{
+		float lag = fabsf( mTimeOfDay - mCacheFaceTime[i] );
+		refresh[i] = mCacheFaceTime[i] < 0.0f || qMin( lag, 1.0f-lag ) > sCacheTolerance;
+	}
+	refresh[mCacheNextFace] = true;
+	mCacheNextFace = ( mCacheNextFace + 1 ) % 6;
+
+	GLint frameBuffer;
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &frameBuffer );
+	glBindFramebuffer( GL_FRAMEBUFFER, mCacheFrameBuffer );
+	glPushAttrib( GL_VIEWPORT_BIT | GL_ENABLE_BIT );
+	glViewport( 0, 0, sCacheSize, sCacheSize );
+	glDisable( GL_DEPTH_TEST );
+	glMatrixMode( GL_PROJECTION );
+	glPushMatrix();
+	glLoadIdentity();
+	glFrustum( -0.1, 0.1, -0.1, 0.1, 0.1, 100.0 );
+	glMatrixMode( GL_MODELVIEW );
+	glPushMatrix();
+
+	for( int i = 0; i < 6; ++i )
+	{
+		if( !refresh[i] )
+			continue;
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, mCacheMap, 0 );
+		glClear( GL_COLOR_BUFFER_BIT );
+		QMatrix4x4 faceMat;
+		faceMat.lookAt( QVector3D( 0, 0, 0 ), faceDir[i], faceUp[i] );
+		glLoadMatrix( faceMat );
+		drawStarCube();
+		drawSky();
+		drawCloudPlane();
+		mCacheFaceTime[i] = mTimeOfDay;
+	}
+
+	glPopMatrix();
+	glMatrixMode( GL_PROJECTION );
+	glPopMatrix();
+	glMatrixMode( GL_MODELVIEW );
+	glPopAttrib();
+	glBindFramebuffer( GL_FRAMEBUFFER, frameBuffer );
+}
+
+
+void Sky::drawCache()
+{
+	glBindTexture( GL_TEXTURE_CUBE_MAP, mCacheMap );
+	mStarCubeShader->bind();
+	mStarCubeShader->program()->setUniformValue( mStarCubeShader_cubeMap, 0 );
+	drawCube( false );
+	mStarCubeShader->release();
+	glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
+}
+
+
 void Sky::drawStarCube()
 {
 	glPushMatrix();
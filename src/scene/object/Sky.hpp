@@ -85,7 +85,41 @@ public:
 	/// The sky's rotation axis.
 	const QVector3D & axis() const { return mAxis; }
 
+	/// Cube map the sky is baked into - usable as environment map, 0 if caching is disabled.
+	GLuint cacheMap() const { return mCacheMap; }
+
+	/// 1D texture holding the sky light over the whole day.
+	/**
+	 * The texture is lightTableSize()*4 texels wide and filtered by GL_NEAREST.
+	 * It holds four consecutive segments of lightTableSize() texels: base color, ambient, diffuse and specular.
+	 * Texel i of a segment is the light at the time of day i/lightTableSize().
+	 */
+	GLuint lightTableMap() const { return mLightTableMap; }
+	static int lightTableSize() { return sLightTableSize; }
+
+	/// Edge length of the cube map the sky is baked into - 0 draws the sky directly in every view.
+	static int cacheSize() { return sCacheSize; }
+	static void setCacheSize( int size ) { sCacheSize = qMax( 0, size ); }
+	/// Faces lagging behind the time of day by more than this are refreshed at once, others one per frame.
+	static float cacheTolerance() { return sCacheTolerance; }
+	static void setCacheTolerance( float tolerance ) { sCacheTolerance = tolerance; }
+
 private:
+	static int sCacheSize;
+	static float sCacheTolerance;
+
+	/// Sky light at one time of the day.
+	struct LightSample
+	{
+		QVector4D baseColor;
+		QVector4D ambient;
+		QVector4D diffuse;
+		QVector4D specular;
+	};
+	static const int sLightTableSize = 256;
+	QVector<LightSample> mLightTable;	///< Sky light over the whole day, sampled at regular intervals
+	GLuint mLightTableMap;
+
 	static const GLfloat sCubeVertices[];
 	static const GLushort sCubeIndices[];
 	static QGLBuffer sCubeIndexBuffer;
@@ -124,7 +158,12 @@ private:
 	int mDomeShader_sunSpotPower;
 	int mDomeShader_diffuseMap;
 	GLuint mDomeMap;
-	QImage mDomeImage;
+
+	GLuint mCacheMap;
+	GLuint mCacheFrameBuffer;
+	float mCacheFaceTime[6];	///< Time of day each face was baked at, -1 if it was not baked yet
+	int mCacheNextFace;
+	bool mCacheUpdated;
 
 	OcclusionTest mOcclusionTest;
 	Material * mSunFlareMaterial;
@@ -143,6 +182,10 @@ private:
 	float mAmbientFactorNight;
 	float mAmbientFactorMax;
 
+	LightSample sampleLight( const QImage & domeImage, float timeOfDay ) const;
+	QVector3D sunDirectionAt( float timeOfDay ) const;
+	void refreshCache();
+	void drawCache();
 	void drawStarCube();
 	void drawSky();
 	void drawCloudPlane();
@@ -29,6 +29,7 @@
 #include <resource/Material.hpp>
 #include <resource/StaticModel.hpp>
 #include <resource/AudioSample.hpp>
+#include <geometry/ColliderGrid.hpp>
 #include <utility/Sphere.hpp>
 #include <utility/Capsule.hpp>
 
@@ -85,6 +86,16 @@ void Teapot::drawSelf()
 }
 
 
+void Teapot::drawShadowCasterSelf( ShadowMap & shadowMap )
+{
+	Q_UNUSED( shadowMap );
+	glPushMatrix();
+	glScalef( mSize, mSize, mSize );
+	mModel->draw( true );
+	glPopMatrix();
+}
+
+
 QVector<const AObject*> Teapot::collideSphere( const AObject * exclude, const float & radius, QVector3D & center, QVector3D * normal ) const
 {
 	QVector<const AObject*> collides = AObject::collideSphere( exclude, radius, center, normal );
@@ -109,3 +120,10 @@ QVector<const AObject*> Teapot::collideSphere( const AObject * exclude, const fl
 
 	return collides;
 }
+
+
+void Teapot::addColliders( ColliderGrid & grid ) const
+{
+	AObject::addColliders( grid );
+	grid.addCapsule( position(), position()+QVector3D(0,2,0), boundingSphereRadius()/2.0f );
+}
@@ -44,8 +44,10 @@ public:
 
 	virtual void updateSelf( const double & delta );
 	virtual void drawSelf();
+	virtual void drawShadowCasterSelf( ShadowMap & shadowMap );
 
 	virtual QVector<const AObject*> collideSphere( const AObject * exclude, const float & radius, QVector3D & center, QVector3D * normal = NULL ) const;
+	virtual void addColliders( ColliderGrid & grid ) const;
 
 private:
 	Material * mMaterial;
@@ -25,6 +25,7 @@
 #include "World.hpp"
 
 #include <scene/TextureRenderer.hpp>
+#include <scene/LightGrid.hpp>
 #include <scene/Scene.hpp>
 #include <resource/Material.hpp>
 #include <resource/StaticModel.hpp>
@@ -75,6 +76,16 @@ Torch::~Torch()
 }
 
 
+bool Torch::addLights( LightGrid & grid )
+{
+	if( !parent() )
+		return true;
+	// the same attenuation as the fixed function light, faded out where it hardly lights anything
+	grid.addPointLight( pointToWorld(mFlarePosition), 64.0f, color(), QVector3D( 0.0f, 0.05f, 0.0f ) );
+	return true;
+}
+
+
 void Torch::updateLightSource( GLenum light )
 {
 	glLight( light, GL_POSITION, QVector4D(	pointToWorld(mFlarePosition), 1	) );
@@ -116,9 +127,16 @@ void Torch::drawSelf()
 }
 
 
+void Torch::drawShadowCasterSelf( ShadowMap & shadowMap )
+{
+	Q_UNUSED( shadowMap );
+	mModel->draw( true );
+}
+
+
 void Torch::draw2Self()
 {
-	if( world()->landscape()->drawingReflection() || world()->landscape()->drawingRefraction() )
+	if( world()->landscape()->drawingReflection() )
 		return;
 
 	const unsigned char samplingPoints = 16;
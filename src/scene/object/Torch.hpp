@@ -50,9 +50,11 @@ public:
 
 	virtual void updateSelf( const double & delta );
 	virtual void drawSelf();
+	virtual void drawShadowCasterSelf( ShadowMap & shadowMap );
 	virtual void draw2Self();
 
 	virtual void updateLightSource( GLenum light );
+	virtual bool addLights( LightGrid & grid );
 
 	const QVector4D & color() const { return mColor; }
 
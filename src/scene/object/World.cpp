@@ -24,9 +24,14 @@
 #include "World.hpp"
 
 #include <scene/Scene.hpp>
+#include <scene/LightGrid.hpp>
+#include <scene/ShadowMap.hpp>
 #include <utility/RandomNumber.hpp>
 #include <geometry/ParticleSystem.hpp>
 #include <effect/SplatterSystem.hpp>
+#include <effect/ParticleEffectManager.hpp>
+#include <effect/EffectBudget.hpp>
+#include <geometry/ColliderGrid.hpp>
 #include "Landscape.hpp"
 #include "Teapot.hpp"
 #include "Sky.hpp"
@@ -110,10 +115,21 @@ World::World( Scene * scene, QString name ) :
 		mLandscape->terrain(),
 		"SplatterBig",
 		"Splatter",
-		"splatter"
+		"splatter",
+		EffectBudget::maxDecals()
 	);
 	mSplatterInteractor = new SplatterInteractor( *this );
-	mSplatterSystem->particleSystem()->setInteractionCallback( mSplatterInteractor );
+	mSplatterSystem->setInteractionCallback( mSplatterInteractor );
+	if( mSplatterSystem->gpuParticleSystem() )
+		mSplatterSystem->gpuParticleSystem()->setWater( mLandscape->waterHeight(), 1.0f/1.1f );	// see SplatterInteractor
+	mLandscape->setSplatterMap( mSplatterSystem->accumulationMap() );
+
+	// creatures move and are not part of the grid - everything added so far stays where it is
+	const Terrain * terrain = mLandscape->terrain();
+	mColliderGrid = new ColliderGrid( QRectF( terrain->offset().x(), terrain->offset().z(), terrain->size().x(), terrain->size().z() ), 32.0f );
+	addColliders( *mColliderGrid );
+	mColliderGrid->build();
+	ParticleEffectManager::setColliderGrid( mColliderGrid );
 }
 
 
@@ -121,6 +137,8 @@ World::~World()
 {
 	mLightSources.clear();
 	scene()->removeKeyListener( this );
+	ParticleEffectManager::setColliderGrid( NULL );
+	delete mColliderGrid;
 	delete mSplatterSystem;
 	delete mSplatterInteractor;
 }
@@ -173,6 +191,9 @@ void World::keyReleaseEvent( QKeyEvent * event )
 
 void World::updateSelf( const double & delta )
 {
+	// before any object emits effects this frame
+	EffectBudget::beginFrame( scene()->eye() );
+
 	mTimeOfDay += 0.002f * delta;
 
 	if( mTimeLapse )
@@ -199,25 +220,74 @@ void World::updateSelf( const double & delta )
 		mSplatterSystem->setSplatBelow( true );
 	else
 		mSplatterSystem->setSplatBelow( false );
+	// particles only leave splatters on high quality, which needs the interaction callback on the CPU
+	mSplatterSystem->setSprayOnGPU( SplatterQuality::maximum() != SplatterQuality::HIGH );
 	mSplatterSystem->update( delta );
 }
 
 
 void World::updateSelfPost( const double & delta )
 {
+	// after all objects emitted their particles
+	ParticleEffectManager::update( delta );
+}
+
 
+/// Returns the number of fixed function lights - queried once
+static int fixedFunctionLights()
+{
+	static GLint maxLights = 0;
+	if( !maxLights )
+		glGetIntegerv( GL_MAX_LIGHTS, &maxLights );
+	return maxLights;
 }
 
 
 void World::drawSelf()
 {
+	// point lights of the main pass are evaluated per fragment, all others use the fixed function lights
+	LightGrid * grid = scene()->renderPass() == MAIN_PASS ? scene()->lightGrid() : NULL;
+	if( grid )
+		grid->clear();
+
+	// light sources beyond the fixed function's limit are dropped - shaders only read the first MAX_LIGHTS anyway
+	const int maxLights = fixedFunctionLights();
 	int light = 0;
 	QList< ALightSource * >::iterator i;
 	for( i = mLightSources.begin(); i != mLightSources.end(); ++i )
 	{
+		if( grid && (*i)->addLights( *grid ) )
+			continue;
+		if( light >= maxLights )
+			continue;
 		(*i)->updateLightSource( GL_LIGHT0+light );
 		light++;
 	}
+	// shaders read all lights they know of, so unused ones must not add anything
+	for( ; light < maxLights; ++light )
+	{
+		glLight( GL_LIGHT0+light, GL_AMBIENT, QVector4D( 0, 0, 0, 1 ) );
+		glLight( GL_LIGHT0+light, GL_DIFFUSE, QVector4D( 0, 0, 0, 1 ) );
+		glLight( GL_LIGHT0+light, GL_SPECULAR, QVector4D( 0, 0, 0, 1 ) );
+		glLight( GL_LIGHT0+light, GL_CONSTANT_ATTENUATION, 1.0f );
+		glDisable( GL_LIGHT0+light );
+	}
+
+	if( grid )
+	{
+		GLint viewport[4];
+		glGetIntegerv( GL_VIEWPORT, viewport );
+		grid->build( scene()->eye()->projectionMatrix(), scene()->eye()->viewMatrix(), QRect( viewport[0], viewport[1], viewport[2], viewport[3] ) );
+		LightGrid::setCurrent( grid );
+	}
+
+	// the sun's shadows are only looked up in the main pass
+	ShadowMap * shadowMap = scene()->renderPass() == MAIN_PASS ? scene()->shadowMap() : NULL;
+	if( shadowMap )
+	{
+		shadowMap->setViewInverse( scene()->eye()->viewMatrixInverse() );
+		ShadowMap::setCurrent( shadowMap );
+	}
 
 	glFog( GL_FOG_COLOR, mSky->baseColor() );
 	glFog( GL_FOG_START, scene()->eye()->farPlane()*0.9f );
@@ -227,30 +297,45 @@ void World::drawSelf()
 
 void World::drawSelfPost()
 {
-	mSplatterSystem->draw( modelViewMatrix() );
+	if( scene()->renderPass() != MAIN_PASS )
+		return;	// particles and splatters are not reflected
+	// decals read the depth buffer, so they are projected before particles cover the terrain
+	mSplatterSystem->draw();
+	ParticleEffectManager::draw( 1, modelViewMatrix() );
 }
 
 
-void World::SplatterInteractor::particleInteraction( const double & delta, ParticleSystem::Particle & particle )
+void World::draw2SelfPost()
 {
-	bool belowWater = false;
-	bool belowGround = false;
+	if( scene()->renderPass() != MAIN_PASS )
+		return;
+	ParticleEffectManager::draw( 2, modelViewMatrix() );
+}
 
-	if( particle.position().y() - mWorld.landscape()->waterHeight() < -mWorld.splatterSystem()->particleSystem()->size()/2.0f )
-		belowWater = true;
-	if( mWorld.landscape()->terrain()->getHeightAboveGround( particle.position() ) < -mWorld.splatterSystem()->particleSystem()->size()/2.0f )
-		belowGround = true;
 
-	if( belowWater )
-	{
-		particle.rVelocity() -= (mWorld.splatterSystem()->particleSystem()->gravity()/1.1) * delta;
-	}
+void World::SplatterInteractor::particleInteraction( const double & delta, ParticleSystem::Span & particles )
+{
+	const float halfSize = mWorld.splatterSystem()->particleSystem()->size()/2.0f;
+	const float waterHeight = mWorld.landscape()->waterHeight();
+	const QVector3D buoyancy = (mWorld.splatterSystem()->particleSystem()->gravity()/1.1) * delta;
+	const bool splat = SplatterQuality::maximum() == SplatterQuality::HIGH;
 
-	if( belowGround )
+	for( int i = 0; i < particles.size(); ++i )
 	{
-		particle.setLife( 0.0f );
-		if( !belowWater && SplatterQuality::maximum() == SplatterQuality::HIGH )
-			mWorld.splatterSystem()->splat( particle.position(), mWorld.splatterSystem()->particleSystem()->size() * RandomNumber::minMax( 0.5f, 2.0f ) );
+		bool belowWater = particles.positionY[i] - waterHeight < -halfSize;
+
+		if( belowWater )
+		{
+			particles.setVelocity( i, particles.velocity( i ) - buoyancy );
+		}
+
+		QVector3D position = particles.position( i );
+		if( mWorld.landscape()->terrain()->getHeightAboveGround( position ) < -halfSize )
+		{
+			particles.kill( i );
+			if( !belowWater && splat )
+				mWorld.splatterSystem()->splat( position, mWorld.splatterSystem()->particleSystem()->size() * RandomNumber::minMax( 0.5f, 2.0f ) );
+		}
 	}
 }
 
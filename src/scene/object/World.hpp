@@ -45,6 +45,7 @@ class Shader;
 class TextureRenderer;
 class Material;
 class SplatterSystem;
+class ColliderGrid;
 
 
 /// Splatter quality settings
@@ -85,6 +86,7 @@ public:
 	virtual void updateSelfPost( const double & delta );
 	virtual void drawSelf();
 	virtual void drawSelfPost();
+	virtual void draw2SelfPost();
 
 	virtual void keyPressEvent( QKeyEvent * event );
 	virtual void keyReleaseEvent( QKeyEvent * event );
@@ -93,6 +95,8 @@ public:
 	void removeLightSource( ALightSource * lightSource );
 
 	SplatterSystem * splatterSystem() { return mSplatterSystem; }
+	/// Static colliders for particle collision, built after the world is set up
+	ColliderGrid * colliderGrid() { return mColliderGrid; }
 
 	QSharedPointer<Landscape> landscape() { return mLandscape; }
 	QSharedPointer<Sky> sky() { return mSky; }
@@ -109,7 +113,7 @@ private:
 	public:
 		SplatterInteractor( World & world ) : mWorld(world) {}
 		virtual ~SplatterInteractor() {}
-		virtual void particleInteraction( const double & delta, ParticleSystem::Particle & particle );
+		virtual void particleInteraction( const double & delta, ParticleSystem::Span & particles );
 	private:
 		World & mWorld;
 	};
@@ -128,6 +132,7 @@ private:
 	QVector3D mTarget;
 	QVector3D mTargetNormal;
 	SplatterSystem * mSplatterSystem;
+	ColliderGrid * mColliderGrid;
 	QList< ALightSource * > mLightSources;
 	float mLevelTime;
 	float mLevelDuration;
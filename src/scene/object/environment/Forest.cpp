@@ -26,10 +26,14 @@
 #include <scene/object/World.hpp>
 #include <scene/object/Landscape.hpp>
 #include <resource/StaticModel.hpp>
+#include <scene/ShadowMap.hpp>
+#include <geometry/ColliderGrid.hpp>
 #include <utility/RandomNumber.hpp>
 #include <utility/Capsule.hpp>
 #include <utility/Sphere.hpp>
 
+#include <algorithm>
+
 
 Forest::Forest( Landscape * landscape, const QString & filename, const QPoint & mapPosition, int mapRadius, int number, int priority ) :
 	AVegetation( landscape->world(), priority ),
@@ -89,6 +93,30 @@ void Forest::drawSelf()
 }
 
 
+void Forest::drawShadowCasterSelf( ShadowMap & shadowMap )
+{
+	if( mPriority < 99-quality() )
+		return;
+
+	// the cascade's vegetation budget bounds the cost of dense forests - it is spent on the trees nearest to the eye
+	mCasterCandidates.clear();
+	for( int i = 0; i < mInstances.size(); ++i )
+	{
+		float treeScale = mInstances[i].column(0).length();
+		QVector3D treeCenter = mInstances[i].column(3).toVector3D() + mInstances[i].mapVector( QVector3D(0,25,0) );
+		if( shadowMap.isSphereInCascade( treeCenter, treeScale * 40.0f ) )
+			mCasterCandidates.append( qMakePair( ( treeCenter - shadowMap.eyePosition() ).lengthSquared(), i ) );
+	}
+	int granted = shadowMap.grantVegetationCasters( mCasterCandidates.size() );
+	std::partial_sort( mCasterCandidates.begin(), mCasterCandidates.begin() + granted, mCasterCandidates.end() );
+	mCasters.clear();
+	for( int k = 0; k < granted; ++k )
+		mCasters.append( mInstances[mCasterCandidates[k].second] );
+	if( !mCasters.isEmpty() )
+		mModel->draw( shadowMap.viewMatrix(), mCasters, true );
+}
+
+
 QVector<const AObject*> Forest::collideSphere( const AObject * exclude, const float & radius, QVector3D & center, QVector3D * normal ) const
 {
 	QVector<const AObject*> collides = AObject::collideSphere( exclude, radius, center, normal );
@@ -114,3 +142,17 @@ QVector<const AObject*> Forest::collideSphere( const AObject * exclude, const fl
 
 	return collides;
 }
+
+
+void Forest::addColliders( ColliderGrid & grid ) const
+{
+	AObject::addColliders( grid );
+	for( QVector<QMatrix4x4>::const_iterator i = mInstances.constBegin(); i != mInstances.constEnd(); ++i )
+	{
+		float treeScale = (*i).column(0).length();
+		grid.addCapsule(
+			(*i).column(3).toVector3D() + (*i).mapVector( QVector3D(0,-10,0) ),
+			(*i).column(3).toVector3D() + (*i).mapVector( QVector3D(0,60,0) ),
+			treeScale );
+	}
+}
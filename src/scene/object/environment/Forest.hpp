@@ -29,6 +29,7 @@
 
 #include <QPointF>
 #include <QVector>
+#include <QPair>
 #include <QMatrix4x4>
 
 
@@ -43,12 +44,16 @@ public:
 
 	virtual void updateSelf( const double & delta );
 	virtual void drawSelf();
+	virtual void drawShadowCasterSelf( ShadowMap & shadowMap );
 
 	virtual QVector<const AObject*> collideSphere( const AObject * exclude, const float & radius, QVector3D & center, QVector3D * normal ) const;
+	virtual void addColliders( ColliderGrid & grid ) const;
 
 private:
 	Landscape * mLandscape;
 	QVector<QMatrix4x4> mInstances;
+	QVector<QMatrix4x4> mCasters;	///< Instances drawn into the current shadow cascade
+	QVector< QPair<float,int> > mCasterCandidates;	///< Squared eye distance and index of the instances within the current shadow cascade
 	StaticModel * mModel;
 };
 
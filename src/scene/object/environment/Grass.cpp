@@ -39,6 +39,7 @@ Grass::Grass( Landscape * landscape, const QString & filename, const QPoint & ma
 	mModel = new StaticModel( world()->scene()->glWidget(), filename );
 	setPosition( QVector3D( position.x(), 0, position.y() ) );
 	setBoundingSphere( qMax( radi.width(),radi.height() ) );
+	setRenderMask( MAIN_PASS );	// too small to be noticed in water reflections
 
 	for( int i=0; i<number; i++ )
 	{
@@ -26,7 +26,7 @@
 #include "../World.hpp"
 
 
-#include <geometry/ParticleSystem.hpp>
+#include <effect/ParticleEffectManager.hpp>
 #include <resource/AudioSample.hpp>
 #include <resource/Material.hpp>
 #include <scene/Scene.hpp>
@@ -56,21 +56,13 @@ Laser::Laser( World * world ) :
 	mReloadSound = new AudioSample( "laser_reload" );
 	mReloadSound->setLooping( false );
 
-	mImpactParticleMaterial = new Material( scene()->glWidget(), "GlowParticle" );
-	mImpactParticles = new ParticleSystem( 64 );
-	mImpactParticles->setSize( 0.25f );
-	mImpactParticles->setGravity( QVector3D( 0.0f, -20.0f, 0.0f ) );
-	mImpactParticles->setDrag( 0.75f );
-	mImpactParticles->setMinLife( 1.0f );
-	mImpactParticles->setMaxLife( 2.0f );
+	mImpactEffect = ParticleEffectManager::effect( scene()->glWidget(), "LaserImpact" );
 }
 
 
 Laser::~Laser()
 {
 	gluDeleteQuadric( mQuadric );
-	delete mImpactParticleMaterial;
-	delete mImpactParticles;
 	delete mMaterial;
 	delete mFireSound;
 	delete mReloadSound;
@@ -109,7 +101,6 @@ void Laser::setTarget( const QVector3D * target )
 
 void Laser::updateSelf( const double & delta )
 {
-	mImpactParticles->update( delta );
 	if( mDrawn )
 	{
 		setRotation( QQuaternion::slerp( rotation(), getRotationToTarget( mTarget, 0.3f ), 20.0 * delta ) );
@@ -126,7 +117,7 @@ void Laser::updateSelf( const double & delta )
 				mTrailEnd = mTrailStart + mTrailDirection*mTrailLength;
 
 				if( target )
-					mImpactParticles->emitSpherical( mTrailEnd, 64, 5.0, 10.0, QVector3D(0,10,0) );
+					mImpactEffect->emitSpherical( mTrailEnd, 64, 5.0, 10.0, QVector3D(0,10,0) );
 				ACreature * victim = dynamic_cast<ACreature*>(target);
 				if( victim )
 					victim->receiveDamage( mDamage, &mTrailEnd, &mTrailDirection );
@@ -178,13 +169,6 @@ void Laser::draw2Self()
 	glEnable( GL_BLEND );
 	glBlendFunc( GL_SRC_ALPHA, GL_ONE );
 
-	// particles on impact
-	glEnable( GL_TEXTURE_2D );
-	glColor4f( 0.2f, 0.4f, 1.0f, 1.0f );
-	mImpactParticleMaterial->bind();
-	mImpactParticles->draw( world()->modelViewMatrix() );
-	mImpactParticleMaterial->release();
-
 	// trail
 	glColor4f( 0.2f, 0.4f, 1.0f, mTrailAlpha );
 	glDisable( GL_TEXTURE_2D );
@@ -28,7 +28,7 @@
 #include "AWeapon.hpp"
 
 
-class ParticleSystem;
+class ParticleEffect;
 class Material;
 class AudioSample;
 
@@ -72,8 +72,7 @@ private:
 	Material * mMaterial;
 	AudioSample * mFireSound;
 	AudioSample * mReloadSound;
-	Material * mImpactParticleMaterial;
-	ParticleSystem * mImpactParticles;
+	QSharedPointer<ParticleEffect> mImpactEffect;
 };
 
 
@@ -26,6 +26,8 @@
 #include <geometry/Vertex.hpp>
 
 
+QList< OcclusionTest * > OcclusionTest::sQueued;
+int OcclusionTest::sFrame = 0;
 QGLBuffer OcclusionTest::sRandomVertexInSphereBuffer;
 QGLBuffer OcclusionTest::sRandomVertexOnSphereBuffer;
 
@@ -56,104 +58,139 @@ OcclusionTest::OcclusionTest()
 		sRandomVertexOnSphereBuffer.allocate( randomPointsInSphere, sizeof(randomPointsInSphere) );
 		sRandomVertexOnSphereBuffer.release();
 	}
-	glGenQueries( 1, &mQuery );
+	glGenQueries( ringSize, mQueries );
+	for( int i = 0; i < ringSize; ++i )
+		mQueryFrames[i] = -1;
+	mNextQuery = 0;
+	mResult = 0;
+	mResultFrame = -1;
+	mQueued = false;
 }
 
 
 OcclusionTest::~OcclusionTest()
 {
-	glDeleteQueries( 1, &mQuery );
+	sQueued.removeOne( this );
+	glDeleteQueries( ringSize, mQueries );
 }
 
 
-bool OcclusionTest::pointVisible( const QVector3D & point )
+void OcclusionTest::poll()
 {
-	GLuint sampleCount = 0;
-	GLuint samplesPerFragment;
-	glGetIntegerv( GL_SAMPLES_ARB, (GLint*)&samplesPerFragment );
-	if( samplesPerFragment == 0 )
-		samplesPerFragment = 1;
+	// oldest first, so the newest available result is kept
+	for( int i = 0; i < ringSize; ++i )
+	{
+		int q = ( mNextQuery + i ) % ringSize;
+		if( mQueryFrames[q] < 0 )
+			continue;
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv( mQueries[q], GL_QUERY_RESULT_AVAILABLE, &available );
+		if( !available )
+			continue;
+		GLuint sampleCount = 0;
+		glGetQueryObjectuiv( mQueries[q], GL_QUERY_RESULT, &sampleCount );
+		mResult = sampleCount / mQuerySamples[q];
+		mResultFrame = mQueryFrames[q];
+		mQueryFrames[q] = -1;
+	}
+}
 
-	if( glIsQuery( mQuery ) )	// fetch the result of last frame
-		glGetQueryObjectuiv( mQuery, GL_QUERY_RESULT, &sampleCount );
 
-	glPushAttrib( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT );
-	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );	// don't draw anything
-	glDepthMask( GL_FALSE );	// don't write the depth of our testing points to the depth buffer
-	glEnable( GL_DEPTH_TEST );	// essential for occlusion query
-	glDisable( GL_MULTISAMPLE );	// multisampling would cause the query to report too many passed samples
+GLuint OcclusionTest::queue( Shape shape, const QVector3D & point, int numPoints )
+{
+	poll();
+	mShape = shape;
+	mPoint = point;
+	mNumPoints = numPoints;
+	GLfloat modelView[16];
+	glGetFloatv( GL_MODELVIEW_MATRIX, modelView );
+	mModelView = QMatrix4x4( modelView ).transposed();
+	if( !mQueued )
+	{
+		mQueued = true;
+		sQueued.append( this );
+	}
+	return mResult;
+}
 
-	glBeginQuery( GL_SAMPLES_PASSED, mQuery );
-	glBegin( GL_POINTS );
-	glVertex( point );
-	glEnd();
-	glEndQuery( GL_SAMPLES_PASSED );
 
-	glPopAttrib();
+void OcclusionTest::submit( GLuint samplesPerFragment )
+{
+	mQueued = false;
+	if( mQueryFrames[mNextQuery] >= 0 )
+		return;	// all queries are still pending
+
+	glLoadMatrix( mModelView );
+	glBeginQuery( GL_SAMPLES_PASSED, mQueries[mNextQuery] );
+	switch( mShape )
+	{
+	case POINT:
+		glBegin( GL_POINTS );
+		glVertex( mPoint );
+		glEnd();
+		break;
+	case IN_SPHERE:
+	case ON_SPHERE:
+		{
+			QGLBuffer & buffer = mShape == IN_SPHERE ? sRandomVertexInSphereBuffer : sRandomVertexOnSphereBuffer;
+			buffer.bind();
+			VertexP3f::glEnableClientState();
+			VertexP3f::glPointerVBO();
+			glDrawArrays( GL_POINTS, 0, mNumPoints );
+			VertexP3f::glDisableClientState();
+			buffer.release();
+		}
+		break;
+	}
+	glEndQuery( GL_SAMPLES_PASSED );
 
-	return sampleCount/samplesPerFragment;
+	mQueryFrames[mNextQuery] = sFrame;
+	mQuerySamples[mNextQuery] = samplesPerFragment;
+	mNextQuery = ( mNextQuery + 1 ) % ringSize;
 }
 
 
-unsigned char OcclusionTest::randomPointsInUnitSphereVisible( const unsigned char & numPoints )
+void OcclusionTest::submitAll()
 {
-	GLuint sampleCount = 0;
+	if( sQueued.isEmpty() )
+		return;
+
 	GLuint samplesPerFragment;
 	glGetIntegerv( GL_SAMPLES_ARB, (GLint*)&samplesPerFragment );
 	if( samplesPerFragment == 0 )
 		samplesPerFragment = 1;
 
-	if( glIsQuery( mQuery ) )	// fetch the result of last frame
-		glGetQueryObjectuiv( mQuery, GL_QUERY_RESULT, &sampleCount );
-
 	glPushAttrib( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT );
 	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );	// don't draw anything
 	glDepthMask( GL_FALSE );	// don't write the depth of our testing points to the depth buffer
 	glEnable( GL_DEPTH_TEST );	// essential for occlusion query
+	glDepthFunc( GL_LESS );
 	glDisable( GL_MULTISAMPLE );	// multisampling would cause the query to report too many passed samples
+	glMatrixMode( GL_MODELVIEW );
+	glPushMatrix();
 
-	glBeginQuery( GL_SAMPLES_PASSED, mQuery );
-	sRandomVertexInSphereBuffer.bind();
-	VertexP3f::glEnableClientState();
-	VertexP3f::glPointerVBO();
-	glDrawArrays( GL_POINTS, 0, numPoints );
-	VertexP3f::glDisableClientState();
-	sRandomVertexInSphereBuffer.release();
-	glEndQuery( GL_SAMPLES_PASSED );
+	for( int i = 0; i < sQueued.size(); ++i )
+		sQueued[i]->submit( samplesPerFragment );
+	sQueued.clear();
 
+	glPopMatrix();
 	glPopAttrib();
-
-	return sampleCount/samplesPerFragment;
 }
 
 
-unsigned char OcclusionTest::randomPointsOnUnitSphereVisible( const unsigned char & numPoints )
+bool OcclusionTest::pointVisible( const QVector3D & point )
 {
-	GLuint sampleCount = 0;
-	GLuint samplesPerFragment;
-	glGetIntegerv( GL_SAMPLES_ARB, (GLint*)&samplesPerFragment );
-	if( samplesPerFragment == 0 )
-		samplesPerFragment = 1;
-
-	if( glIsQuery( mQuery ) )	// fetch the result of last frame
-		glGetQueryObjectuiv( mQuery, GL_QUERY_RESULT, &sampleCount );
+	return queue( POINT, point, 1 );
+}
 
-	glPushAttrib( GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT );
-	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );	// don't draw anything
-	glDepthMask( GL_FALSE );	// don't write the depth of our testing points to the depth buffer
-	glEnable( GL_DEPTH_TEST );	// essential for occlusion query
-	glDisable( GL_MULTISAMPLE );	// multisampling would cause the query to report too many passed samples
 
-	glBeginQuery( GL_SAMPLES_PASSED, mQuery );
-	sRandomVertexOnSphereBuffer.bind();
-	VertexP3f::glEnableClientState();
-	VertexP3f::glPointerVBO();
-	glDrawArrays( GL_POINTS, 0, numPoints );
-	VertexP3f::glDisableClientState();
-	sRandomVertexOnSphereBuffer.release();
-	glEndQuery( GL_SAMPLES_PASSED );
+unsigned char OcclusionTest::randomPointsInUnitSphereVisible( const unsigned char & numPoints )
+{
+	return queue( IN_SPHERE, QVector3D(), numPoints );
+}
 
-	glPopAttrib();
 
-	return sampleCount/samplesPerFragment;
+unsigned char OcclusionTest::randomPointsOnUnitSphereVisible( const unsigned char & numPoints )
+{
+	return queue( ON_SPHERE, QVector3D(), numPoints );
 }
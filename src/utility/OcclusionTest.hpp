@@ -27,10 +27,18 @@
 #include "glWrappers.hpp"
 
 #include <QVector4D>
+#include <QMatrix4x4>
 #include <QGLBuffer>
+#include <QList>
 
 
 /// Occlusion testing using hardware accelerated occlusion queries
+/**
+ * Tests are only queued when requested and submitted together by submitAll() once the scene's depth is complete.
+ * Each test owns a ring of queries which are polled for GL_QUERY_RESULT_AVAILABLE, so fetching results never waits for the GPU.
+ * The test methods return the samples of the latest available result, which is resultAge() frames old.
+ * If all queries of the ring are still pending, a test is skipped until one of them is available.
+ */
 class OcclusionTest
 {
 public:
@@ -41,8 +49,42 @@ public:
 	unsigned char randomPointsInUnitSphereVisible( const unsigned char & numPoints );
 	unsigned char randomPointsOnUnitSphereVisible( const unsigned char & numPoints );
 
+	/// Frames since the test of the latest available result was submitted - -1 if there is no result yet
+	int resultAge() const { return mResultFrame < 0 ? -1 : sFrame - mResultFrame; }
+
+	/// Submits the queued tests of all occlusion tests in one batch - expects the projection they were queued with
+	static void submitAll();
+	/// Advances the frame results are tagged with - call once per frame
+	static void nextFrame() { ++sFrame; }
+
 private:
-	GLuint mQuery;
+	enum Shape
+	{
+		POINT,
+		IN_SPHERE,
+		ON_SPHERE
+	};
+	static const int ringSize = 4;
+
+	GLuint mQueries[ringSize];
+	int mQueryFrames[ringSize];	///< Frame each query was submitted in, -1 if it is free
+	GLuint mQuerySamples[ringSize];	///< Samples per fragment of the frame buffer each query ran on
+	int mNextQuery;
+	GLuint mResult;
+	int mResultFrame;
+
+	bool mQueued;
+	Shape mShape;
+	QVector3D mPoint;
+	int mNumPoints;
+	QMatrix4x4 mModelView;
+
+	void poll();
+	GLuint queue( Shape shape, const QVector3D & point, int numPoints );
+	void submit( GLuint samplesPerFragment );
+
+	static QList< OcclusionTest * > sQueued;
+	static int sFrame;
 	static QGLBuffer sRandomVertexInSphereBuffer;
 	static QGLBuffer sRandomVertexOnSphereBuffer;
 };